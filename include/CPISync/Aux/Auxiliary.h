@@ -18,6 +18,7 @@
 #include <stdexcept>
 #include <map>
 #include <vector>
+#include <deque>
 #include <iterator>
 #include <list>
 #include <set>
@@ -27,6 +28,7 @@
 #include <sys/wait.h>
 #include <climits>
 #include <cstring>
+#include <cstdint>
 #include <memory>
 #include <CPISync/Aux/ConstantsAndTypes.h>
 #include <CPISync/Aux/Logger.h>
@@ -439,40 +441,87 @@ multiset<T> multisetSubset(const multiset<T> first, const int size) {
 }
 
 /**
- A generic p-ary tree of type T
+ * A generic p-ary tree of type T, stored flat.  Nodes are identified by their index, the root being node 0, and the
+ * children of a node are added together, in consecutive indices, so that the tree is described by one index per node
+ * (that of its first child).  Node payloads are constructed in place in chunked storage, so that growing the tree
+ * allocates a chunk of nodes at a time rather than each node separately, and destroying it frees whole chunks.
  */
 template <typename T>
 class paryTree {
 public:
+    static const long NONE = -1; /** The index of a node that does not exist. */
 
     /**
-     * Construct a p-ary tree of a fixed arity
-     * @param datum The actual datum to add - will be deallocated by the destructor
+     * Construct an empty p-ary tree of a fixed arity.
      * @param pary The number of children per node.
      */
-    paryTree(T *theDatum, long pary) : arity(pary) {
-        datum = theDatum;
-        child = new paryTree<T> *[arity];
-        for (int ii = 0; ii < arity; ii++) child[ii] = NULL;
+    explicit paryTree(long pary) : arity(pary) {}
+
+    /** @return true iff the tree has no nodes (not even a root). */
+    bool empty() const { return datum.empty(); }
+
+    /** @return The number of nodes in the tree. */
+    long size() const { return (long) datum.size(); }
+
+    /**
+     * Adds the root of an empty tree, constructed from args.
+     * @return The index of the root, 0.
+     */
+    template <class... Args>
+    long addRoot(const Args&... args) {
+        datum.emplace_back(args...);
+        firstChild.push_back(NONE);
+        return 0;
     }
 
-    /** Destructor */
-    ~paryTree() {
-        delete[] child; /** An array of children of the current node. */
-        delete datum; /** The payload of the current node. */
+    /**
+     * Adds all the children of a node that has none, each constructed from args.
+     * @return The index of the first child; the others follow it.
+     */
+    template <class... Args>
+    long addChildren(long node, const Args&... args) {
+        firstChild[node] = size();
+        for (long ii = 0; ii < arity; ii++) {
+            datum.emplace_back(args...);
+            firstChild.push_back(NONE);
+        }
+        return firstChild[node];
     }
 
+    /** @return true iff the given node has children. */
+    bool hasChildren(long node) const { return firstChild[node] != NONE; }
+
+    /** @return The index of the ii-th child of node, or NONE if node has no children. */
+    long child(long node, long ii) const { return hasChildren(node) ? firstChild[node] + ii : NONE; }
+
     /** Accessor */
-    T *getDatum() {
-        return datum;
+    T &getDatum(long node) { return datum[node]; }
+
+    /**
+     * Removes every node but the first num ones (which must include the parents of any node kept).
+     */
+    void truncate(long num) {
+        while (size() > num) {
+            datum.pop_back();
+            firstChild.pop_back();
+        }
+        for (long &first : firstChild)
+            if (first >= num)
+                first = NONE;
     }
 
-    paryTree<T> **child; /** Full access to all the children of the node. */
+    /** Removes every node. */
+    void clear() { truncate(0); }
+
 private:
     long arity;
-    T *datum;
+    std::deque<T> datum; /** The payload of each node. */
+    vector<long> firstChild; /** The index of the first child of each node, or NONE for a leaf. */
 };
 
+template <typename T>
+const long paryTree<T>::NONE;
+
 /// BASE64 ENCODE/DECODE
 const int min_base64 = 62; // first character of base-64 text
 const unsigned int signed_shift = 128; // shift to get from unsigned to signed
@@ -555,6 +604,21 @@ inline string base64_encode(const string& bytes) {
     return foo;
 }
 
+/**
+ * A 64-bit FNV-1a hash of a byte buffer.  It is fast but not cryptographic; it is meant for detecting
+ * accidental changes to local files, not for adversarial settings.
+ * @param data The bytes to hash.
+ * @param len The number of bytes to hash.
+ */
+inline uint64_t fnv1a64(const char* data, size_t len) {
+    uint64_t hash = 14695981039346656037ULL; // FNV offset basis
+    for (size_t ii = 0; ii < len; ii++) {
+        hash ^= (unsigned char) data[ii];
+        hash *= 1099511628211ULL; // FNV prime
+    }
+    return hash;
+}
+
 /**
  * @return The minimum of two NTL ZZ objects
  */
@@ -0,0 +1,811 @@
+/* This code is part of the CPISync project developed at Boston University.  Please see the README for use and references. */
+
+/*
+ * File:   CPIField.h
+ * Finite field backends for the CPISync family of synchronization methods, together with the field
+ * algorithms (rational function interpolation and root finding) written once over either backend.
+ *
+ * The big-field backend uses NTL's multi-precision ZZ_p and works for any modulus.  The word-sized backend
+ * uses NTL's single-precision zz_p, which keeps every field element in one machine word and avoids
+ * heap-backed bignum arithmetic altogether; it can only be used when the modulus fits in NTL_SP_NBITS bits.
+ */
+
+#ifndef CPI_FIELD_H
+#define CPI_FIELD_H
+
+#include <vector>
+#include <NTL/ZZ_p.h>
+#include <NTL/vec_ZZ_p.h>
+#include <NTL/mat_ZZ_p.h>
+#include <NTL/ZZ_pX.h>
+#include <NTL/ZZ_pXFactoring.h>
+#include <NTL/lzz_p.h>
+#include <NTL/vec_lzz_p.h>
+#include <NTL/mat_lzz_p.h>
+#include <NTL/lzz_pX.h>
+#include <NTL/lzz_pXFactoring.h>
+#include <CPISync/Aux/Logger.h>
+
+// namespaces
+using namespace NTL;
+
+/**
+ * Multi-precision field backend (NTL ZZ_p).  The modulus is whatever ZZ_p::init last installed.
+ */
+struct BigField {
+    typedef ZZ_p Elem;
+    typedef vec_ZZ_p Vec;
+    typedef mat_ZZ_p Mat;
+    typedef ZZ_pX Poly;
+    typedef ZZ_pXModulus PolyModulus;
+    typedef vec_ZZ_pX VecPoly;
+    typedef vec_pair_ZZ_pX_long VecFactors;
+    typedef ZZ_pContext Context;
+};
+
+/**
+ * Single-precision field backend (NTL zz_p).  The modulus is whatever zz_p::init (or a zz_pContext restore) last installed.
+ */
+struct WordField {
+    typedef zz_p Elem;
+    typedef vec_zz_p Vec;
+    typedef mat_zz_p Mat;
+    typedef zz_pX Poly;
+    typedef zz_pXModulus PolyModulus;
+    typedef vec_zz_pX VecPoly;
+    typedef vec_pair_zz_pX_long VecFactors;
+    typedef zz_pContext Context;
+};
+
+/**
+ * @return true iff a field with the given (prime) modulus can be handled by the WordField backend.
+ */
+inline bool fitsWordField(const ZZ& modulus) {
+    return NumBits(modulus) <= NTL_SP_NBITS;
+}
+
+/**
+ * Converts a vector between the two field backends.
+ * @require The destination field's modulus must be installed, and must be the same as the source's.
+ */
+inline void convField(vec_zz_p& out, const vec_ZZ_p& in) {
+    out.SetLength(in.length());
+    for (long ii = 0; ii < in.length(); ii++)
+        conv(out[ii], rep(in[ii]));
+}
+
+inline void convField(vec_ZZ_p& out, const vec_zz_p& in) {
+    out.SetLength(in.length());
+    for (long ii = 0; ii < in.length(); ii++)
+        conv(out[ii], rep(in[ii]));
+}
+
+/**
+ * Saves the calling thread's moduli for both field backends, and reinstalls them when destroyed (or on restore).
+ * A thread that waits on a ThreadPool loop helps with queued tasks of other loops, which install their own moduli,
+ * so the caller of a parallel loop must put its own back afterwards.
+ */
+class FieldContextGuard {
+public:
+    FieldContextGuard() {
+        bigContext.save();
+        wordContext.save();
+    }
+
+    ~FieldContextGuard() {
+        restore();
+    }
+
+    // Installs the saved moduli on the current thread
+    void restore() const {
+        bigContext.restore();
+        wordContext.restore();
+    }
+
+    FieldContextGuard(const FieldContextGuard&) = delete;
+    FieldContextGuard& operator=(const FieldContextGuard&) = delete;
+
+private:
+    ZZ_pContext bigContext; /** The saved ZZ_p modulus. */
+    zz_pContext wordContext; /** The saved zz_p modulus. */
+};
+
+/**
+ * Interpolates a rational function with given evaluations at the given sample locations, by solving
+ * the linear system in Y. Minsky, A. Trachtenberg, and R. Zippel,
+ *   Set Reconciliation with Nearly Optimal Communication Complexity,
+ *   IEEE Trans. Inf. Theory 49:9, pp. 2213-2218 (see page 7, for example).
+ *
+ * @param sampleLoc Sample locations; the ii-th evaluation is taken at sampleLoc[ii].  Must be at least as long as evals.
+ * @param evals Evaluations of the rational function at the first evals.length() sample locations.
+ * @param mA, mB Sizes of the two sets being reconciled (their difference bounds the degree difference of P and Q).
+ * @param P_vec, Q_vec Coefficients (low order first) of the monic numerator and denominator of the result.
+ * @return true iff some rational function meeting the evaluations was interpolated.
+ * @see CPISync::ratFuncInterp
+ */
+template <class F>
+bool cpiRatFuncInterp(const typename F::Vec& sampleLoc, const typename F::Vec& evals, long mA, long mB,
+                      typename F::Vec& P_vec, typename F::Vec& Q_vec) {
+    // local variables
+    long ii, jj;
+    long mbar = evals.length(), mAbar, mBbar, rank;
+    long delta = mA - mB;
+
+    typename F::Vec coefficient_vec;
+
+    // 0. Compute bounds on one-sided set differences
+    mAbar = (mbar + delta) / 2; /** (Upper bound on the degree of the numerator polynomial)+1 */
+    mBbar = (mbar - delta) / 2; /** (Upper bound on the degree of the denominator polynomial)+1 */
+
+    // ... sanity checks
+    if ((mAbar < 0) || (mBbar < 0)) {
+        Logger::gLog(Logger::METHOD, "0. function interpolation failed, more sample points needed.\n");
+        return false;
+    }
+
+    // 1. Construct and solve a linear equations that produces the interpolation
+    // van_matrix is, in terms of the article referenced above:
+    //    k_i ^{d1-1} ... 1 | - f_i k_i^{d2-1} ... -f_i || f_i k_i^d2 - k_i^d1
+    //    A || B, where Ax = B yields x = p_{d1-1} ... p_0 | q_{d2-1} ... q0
+    //    The solution x is stored in coefficient_vec below.
+
+    typename F::Mat van_matrix; // a concatenation of Vandermonde matrices
+    van_matrix.SetDims(mbar, mAbar + mBbar + 1);
+    typename F::Vec powers; // powers[kk] = sampleLoc[ii]^kk, by successive products rather than one power() per entry
+    powers.SetLength(max(mAbar, mBbar) + 1);
+    for (ii = 0; ii < mbar; ii++) {
+        powers[0] = 1;
+        for (long kk = 1; kk < powers.length(); kk++)
+            powers[kk] = powers[kk - 1] * sampleLoc[ii];
+
+        for (jj = 0; jj < mAbar; jj++)
+            van_matrix[ii][jj] = powers[mAbar - jj - 1];
+        for (jj = 0; jj < mBbar; jj++)
+            van_matrix[ii][jj + mAbar] = -evals[ii] * powers[mBbar - jj - 1];
+        van_matrix[ii][mAbar + mBbar] = evals[ii] * powers[mBbar] - powers[mAbar];
+    }
+
+    typename F::Mat copyv_matrix(van_matrix); // unadulterated copy of van_matrix
+    rank = gauss(van_matrix, mAbar + mBbar); // the last column just goes along for the ride
+
+    // compare # of independent variables (rank) to total permitted degree of the interpolated function
+    if (rank > mAbar + mBbar) { // case 1.  rank > tot. degree => error
+        Logger::gLog(Logger::METHOD, "1. function interpolation failed, more sample points needed.\n");
+        return false;
+    } else if (rank < mAbar + mBbar) {
+        // case 2. rank is smaller than tot. degree => recreate the matrix with the correct size
+        // ... we do this by taking mAbar - mDiff columns from among the first mAbar
+        // ...                  and mBbar - mDiff columns from index mAbar to mAbar-mBar -1
+        // ...                  and the last column of the matrix
+        long mDiff = mAbar + mBbar - rank; // difference between rank and upper bounds
+        // ... adjust upper bounds mAbar and mBbar accordingly
+        mAbar -= mDiff;
+        mBbar -= mDiff;
+        if ((mAbar < 0) || (mBbar < 0)) {
+            Logger::gLog(Logger::METHOD, "2. function interpolation failed, more sample points needed.\n");
+            return false;
+        }
+
+        van_matrix.SetDims(mAbar + mBbar, mAbar + mBbar + 1);
+
+        // recreate based on the original matrix computations, with the powers of the last column by successive
+        // products, as above
+        powers.SetLength(max(mAbar, mBbar) + 1);
+        for (ii = 0; ii < mAbar + mBbar; ii++) {
+            powers[0] = 1;
+            for (long kk = 1; kk < powers.length(); kk++)
+                powers[kk] = powers[kk - 1] * sampleLoc[ii];
+
+            for (jj = 0; jj < mAbar; jj++)
+                van_matrix[ii][jj] = copyv_matrix[ii][jj + mDiff];
+            for (jj = 0; jj < mBbar; jj++)
+                van_matrix[ii][jj + mAbar] = copyv_matrix[ii][jj + mAbar + mDiff + mDiff];
+            van_matrix[ii][mAbar + mBbar] = evals[ii] * powers[mBbar] - powers[mAbar];
+        }
+
+        // row-reduce the resulting matrix
+        rank = gauss(van_matrix, mAbar + mBbar); // the last column just goes along for the ride
+    }
+
+    // store the solution to the linear system in coefficient_vec
+    coefficient_vec.SetLength(rank);
+    for (ii = rank - 1; ii >= 0; ii--) {
+        coefficient_vec[ii] = van_matrix[ii][mAbar + mBbar] / van_matrix[ii][ii];
+        for (jj = 0; jj < ii; jj++) // subtract out the coefficient from the previous entries
+            van_matrix[jj][mAbar + mBbar] -= coefficient_vec[ii] * van_matrix[jj][ii];
+    }
+
+    // 2. Store the result of the interpolation in P_vec and Q_vec
+    P_vec.SetLength(mAbar + 1); // adding 1 is for p0 and q0
+    Q_vec.SetLength(mBbar + 1);
+
+    // the first mAbar coefficients (in reverse order) are P_vec
+    P_vec[mAbar] = 1;
+    for (ii = 0; ii < mAbar; ii++)
+        P_vec[ii] = coefficient_vec[mAbar - ii - 1];
+
+    // the next mBbar coefficients (in reverse order) are Q_vec
+    Q_vec[mBbar] = 1;
+    for (ii = 0; ii < rank - mAbar; ii++)
+        Q_vec[ii] = coefficient_vec[rank - ii - 1];
+
+    // 3. Free up memory and return
+    coefficient_vec.kill();
+    van_matrix.kill();
+    copyv_matrix.kill();
+
+    return true;
+}
+
+/**
+ * A subproduct tree over a list of points a_0 ... a_{n-1}.  Level 0 holds the linear polynomials (x - a_i); each
+ * subsequent level holds the products of adjacent pairs of the previous level (an odd polynomial out is carried up
+ * as is), so that the single polynomial on the top level is prod_i (x - a_i).
+ */
+template <class F>
+using CPITree = std::vector<std::vector<typename F::Poly>>;
+
+/**
+ * Builds the subproduct tree of the first n points.
+ * @require n >= 1 and points.length() >= n
+ */
+template <class F>
+void cpiBuildTree(CPITree<F>& tree, const typename F::Vec& points, long n) {
+    tree.assign(1, std::vector<typename F::Poly>(n));
+    for (long ii = 0; ii < n; ii++) {
+        SetCoeff(tree[0][ii], 1);
+        SetCoeff(tree[0][ii], 0, -points[ii]);
+    }
+
+    while (tree.back().size() > 1) {
+        const std::vector<typename F::Poly>& below = tree.back();
+        std::vector<typename F::Poly> level((below.size() + 1) / 2);
+        for (size_t ii = 0; ii + 1 < below.size(); ii += 2)
+            mul(level[ii / 2], below[ii], below[ii + 1]);
+        if (below.size() % 2 == 1)
+            level.back() = below.back();
+        tree.push_back(level);
+    }
+}
+
+/**
+ * Evaluates f at all the points of a subproduct tree by reducing it down the tree.
+ * @param values Set to the evaluations, in the order of the points used to build the tree.
+ */
+template <class F>
+void cpiMultiEval(typename F::Vec& values, const typename F::Poly& f, const CPITree<F>& tree) {
+    std::vector<typename F::Poly> rems(1);
+    rem(rems[0], f, tree.back()[0]);
+
+    for (long lev = (long) tree.size() - 2; lev >= 0; lev--) {
+        std::vector<typename F::Poly> next(tree[lev].size());
+        for (size_t ii = 0; ii < next.size(); ii++)
+            rem(next[ii], rems[ii / 2], tree[lev][ii]);
+        rems.swap(next);
+    }
+
+    values.SetLength(rems.size());
+    for (size_t ii = 0; ii < rems.size(); ii++)
+        values[ii] = ConstTerm(rems[ii]);
+}
+
+/**
+ * Computes the unique polynomial f of degree < n with f(a_i) = values[i] at the n points of a subproduct tree
+ * (fast Lagrange interpolation).
+ */
+template <class F>
+void cpiInterpolate(typename F::Poly& f, const typename F::Vec& values, const CPITree<F>& tree) {
+    // Lagrange weights values[i] / M'(a_i), where M is the product at the top of the tree
+    typename F::Vec weights;
+    cpiMultiEval<F>(weights, diff(tree.back()[0]), tree);
+
+    std::vector<typename F::Poly> comb(weights.length());
+    for (long ii = 0; ii < weights.length(); ii++)
+        conv(comb[ii], values[ii] / weights[ii]);
+
+    // ... combine up the tree: (left * M_right) + (right * M_left)
+    for (size_t lev = 0; lev + 1 < tree.size(); lev++) {
+        std::vector<typename F::Poly> next(tree[lev + 1].size());
+        for (size_t ii = 0; ii + 1 < comb.size(); ii += 2)
+            next[ii / 2] = comb[ii] * tree[lev][ii + 1] + comb[ii + 1] * tree[lev][ii];
+        if (comb.size() % 2 == 1)
+            next.back() = comb.back();
+        comb.swap(next);
+    }
+    f = comb[0];
+}
+
+/**
+ * Multiplies each evals[i] by prod_j (sampleLoc[i] - roots[j]), i.e. adds the given roots to the set whose
+ * characteristic polynomial is evaluated in evals.  The roots are taken in blocks of sampleLoc.length(); each block's
+ * product polynomial is built with a subproduct tree and evaluated at all sample locations at once, so the cost is
+ * quasi-linear, rather than quadratic, in the number of sample locations per block.
+ * @param sampleTree The subproduct tree of the sample locations (see cpiBuildTree).
+ * @require evals.length() is the number of sample locations in sampleTree
+ */
+template <class F>
+void cpiMulRoots(typename F::Vec& evals, const CPITree<F>& sampleTree, const typename F::Vec& roots) {
+    auto numSamples = (long) sampleTree[0].size();
+    if (roots.length() == 0)
+        return;
+
+    CPITree<F> rootTree;
+    typename F::Vec block, values;
+    for (long start = 0; start < roots.length(); start += numSamples) {
+        long len = min(numSamples, roots.length() - start);
+        block.SetLength(len);
+        for (long ii = 0; ii < len; ii++)
+            block[ii] = roots[start + ii];
+
+        // the top of the tree is prod_j (x - block[j])
+        cpiBuildTree<F>(rootTree, block, len);
+        cpiMultiEval<F>(values, rootTree.back()[0], sampleTree);
+        for (long ii = 0; ii < numSamples; ii++)
+            evals[ii] *= values[ii];
+    }
+}
+
+/**
+ * Replaces every entry of vals by its inverse, using a single field inversion for the whole vector
+ * (Montgomery's batch inversion: prefix products, one inversion, then a backward sweep).
+ * @require Every entry of vals must be non-zero.
+ */
+template <class F>
+void cpiBatchInv(typename F::Vec& vals) {
+    long len = vals.length();
+    if (len == 0)
+        return;
+
+    typename F::Vec prefix; // prefix[ii] = vals[0] * ... * vals[ii]
+    prefix.SetLength(len);
+    prefix[0] = vals[0];
+    for (long ii = 1; ii < len; ii++)
+        prefix[ii] = prefix[ii - 1] * vals[ii];
+
+    typename F::Elem running = inv(prefix[len - 1]); // the inverse of vals[0] * ... * vals[ii], for ii going down
+    for (long ii = len - 1; ii > 0; ii--) {
+        typename F::Elem current = vals[ii];
+        vals[ii] = running * prefix[ii - 1];
+        running *= current;
+    }
+    vals[0] = running;
+}
+
+/**
+ * Divides each evals[i] by prod_j (sampleLoc[i] - roots[j]), i.e. removes the given roots from the set whose
+ * characteristic polynomial is evaluated in evals.  The removed factors are multiplied together as in cpiMulRoots,
+ * and then divided out with one batch inversion over all sample locations.
+ * @param sampleTree The subproduct tree of the sample locations (see cpiBuildTree).
+ * @require evals.length() is the number of sample locations in sampleTree, and no root may equal a sample location.
+ */
+template <class F>
+void cpiDivRoots(typename F::Vec& evals, const CPITree<F>& sampleTree, const typename F::Vec& roots) {
+    if (roots.length() == 0)
+        return;
+
+    typename F::Vec factors;
+    factors.SetLength(evals.length());
+    for (long ii = 0; ii < factors.length(); ii++)
+        set(factors[ii]);
+    cpiMulRoots<F>(factors, sampleTree, roots);
+    cpiBatchInv<F>(factors);
+    for (long ii = 0; ii < evals.length(); ii++)
+        evals[ii] *= factors[ii];
+}
+
+/**
+ * Recovers the monic rational function P/Q, with deg P - deg Q = mA - mB >= 0, from a polynomial interp that agrees
+ * with its evaluations modulo M = prod_i (x - a_i), the product over the mbar = deg M sample locations a_i.  These are
+ * steps 2-4 of cpiRatFuncInterpFast.
+ * @require mA >= mB
+ */
+template <class F>
+bool cpiRatFuncFromInterp(const typename F::Poly& interp, const typename F::Poly& M, long mA, long mB,
+                          typename F::Vec& P_vec, typename F::Vec& Q_vec) {
+    long mbar = deg(M);
+    long delta = mA - mB;
+
+    // 0. Compute bounds on one-sided set differences, exactly as in cpiRatFuncInterp
+    long mBbar = (mbar - delta) / 2;
+    if (mBbar < 0) {
+        Logger::gLog(Logger::METHOD, "0. function interpolation failed, more sample points needed.\n");
+        return false;
+    }
+    if (mbar == 0) { // no evaluations; only the trivial rational function 1/1 is consistent
+        typename F::Vec none;
+        return cpiRatFuncInterp<F>(none, none, mA, mB, P_vec, Q_vec);
+    }
+
+    // 1. Fshift = F - x^delta mod M
+    typename F::Poly Fshift(interp), xDelta;
+    SetCoeff(xDelta, delta);
+    Fshift -= xDelta % M;
+
+    // 2. Q is the minimal polynomial of the sequence s_1 ... s_{2 mBbar}, where (F - x^delta)/M = sum_k s_k x^{-k}.
+    // ... with y = 1/x, (F - x^delta)/M = y * rev(F - x^delta)(y) / rev(M)(y), and rev(M) has constant term 1
+    typename F::Poly Q_poly;
+    if (mBbar == 0)
+        set(Q_poly);
+    else {
+        typename F::Poly revF, revM, series;
+        reverse(revF, Fshift, mbar - 1);
+        reverse(revM, M, mbar);
+        MulTrunc(series, revF, InvTrunc(revM, 2 * mBbar), 2 * mBbar);
+
+        typename F::Vec seq;
+        seq.SetLength(2 * mBbar);
+        for (long ii = 0; ii < 2 * mBbar; ii++)
+            seq[ii] = coeff(series, ii);
+        MinPolySeq(Q_poly, seq, mBbar);
+    }
+
+    // 3. P = x^delta Q + R, where R = Q (F - x^delta) mod M
+    typename F::Poly R_poly, P_poly;
+    MulMod(R_poly, Q_poly % M, Fshift, M);
+    if (deg(R_poly) >= delta + deg(Q_poly)) { // P would not be monic of the degree dictated by the set sizes
+        Logger::gLog(Logger::METHOD, "1. function interpolation failed, more sample points needed.\n");
+        return false;
+    }
+    LeftShift(P_poly, Q_poly, delta);
+    P_poly += R_poly;
+
+    // 4. Store the result of the interpolation in P_vec and Q_vec
+    P_vec.SetLength(deg(P_poly) + 1);
+    for (long ii = 0; ii <= deg(P_poly); ii++)
+        P_vec[ii] = coeff(P_poly, ii);
+    Q_vec.SetLength(deg(Q_poly) + 1);
+    for (long ii = 0; ii <= deg(Q_poly); ii++)
+        Q_vec[ii] = coeff(Q_poly, ii);
+
+    return true;
+}
+
+/**
+ * Interpolates the same rational function as cpiRatFuncInterp, and with the same outputs, but in quasi-linear rather
+ * than cubic time:
+ *   1.  Interpolate the evaluations by a polynomial F modulo M = prod_i (x - sampleLoc[i]), using a subproduct tree.
+ *   2.  Since P and Q are monic with deg P - deg Q = delta >= 0, R = P - x^delta Q has degree below deg P and
+ *       satisfies R = Q (F - x^delta) mod M.  Q is therefore the minimal polynomial of the linearly recurrent sequence
+ *       of coefficients of (F - x^delta)/M at infinity, which is recovered with NTL's (half-GCD based) MinPolySeq.
+ *   3.  P = x^delta Q + (Q (F - x^delta) mod M).
+ * If delta < 0, the same is done with the roles of P and Q (and the evaluations inverted) swapped.
+ *
+ * Folding the monic leading terms into step 2 keeps the reconstruction uniquely determined even when the degree
+ * bounds exactly fill the available evaluations, so no case needs to fall back to Gaussian elimination.
+ *
+ * @param sampleTree If given, the subproduct tree of the first evals.length() sample locations; otherwise it is built here.
+ */
+template <class F>
+bool cpiRatFuncInterpFast(const typename F::Vec& sampleLoc, const typename F::Vec& evals, long mA, long mB,
+                          typename F::Vec& P_vec, typename F::Vec& Q_vec, const CPITree<F> *sampleTree = nullptr) {
+    long mbar = evals.length();
+
+    if (mA < mB) { // reconstruct Q/P from the inverted evaluations instead
+        typename F::Vec invEvals(evals);
+        cpiBatchInv<F>(invEvals);
+        return cpiRatFuncInterpFast<F>(sampleLoc, invEvals, mB, mA, Q_vec, P_vec, sampleTree);
+    }
+
+    // 1. F interpolates the evaluations modulo M
+    typename F::Poly interp, M;
+    set(M);
+    if (mbar > 0) {
+        CPITree<F> localTree;
+        if (sampleTree == nullptr) {
+            cpiBuildTree<F>(localTree, sampleLoc, mbar);
+            sampleTree = &localTree;
+        }
+        cpiInterpolate<F>(interp, evals, *sampleTree);
+        M = sampleTree->back()[0];
+    }
+
+    // 2.-4.
+    return cpiRatFuncFromInterp<F>(interp, M, mA, mB, P_vec, Q_vec);
+}
+
+/**
+ * The interpolation state of a rational function reconstruction that is retried with ever more evaluations, as in
+ * the doubling rounds of probabilistic CPISync.  Setting count to 0 clears the state.
+ */
+template <class F>
+struct CPIInterpState {
+    long count = 0; /** The number of leading sample locations folded into interp. */
+    bool inverted = false; /** True iff interp interpolates the inverses of the evaluations (i.e. mA < mB). */
+    typename F::Poly interp; /** Interpolates the evaluations at the first count sample locations. */
+    typename F::Poly modulus; /** The product of (x - sampleLoc[i]) over the first count sample locations. */
+};
+
+/**
+ * Folds the evaluations evals[state.count] ... evals[evals.length() - 1] into state, in Newton form:  if G interpolates
+ * (evals[i] - interp(a_i)) / modulus(a_i) over just the new sample locations a_i, then interp + modulus * G
+ * interpolates all of them.  This costs one multipoint evaluation and one interpolation over the new points only.
+ * @require evals.length() >= state.count, and the first state.count evaluations are those already folded in.
+ */
+template <class F>
+void cpiExtendInterp(CPIInterpState<F>& state, const typename F::Vec& sampleLoc, const typename F::Vec& evals) {
+    long first = state.count, num = evals.length() - first;
+    if (first == 0) {
+        clear(state.interp);
+        set(state.modulus);
+    }
+    if (num <= 0)
+        return;
+
+    typename F::Vec points, interpVals, modVals, corrections;
+    points.SetLength(num);
+    for (long ii = 0; ii < num; ii++)
+        points[ii] = sampleLoc[first + ii];
+    CPITree<F> tree;
+    cpiBuildTree<F>(tree, points, num);
+
+    cpiMultiEval<F>(interpVals, state.interp, tree);
+    cpiMultiEval<F>(modVals, state.modulus, tree);
+    cpiBatchInv<F>(modVals);
+    corrections.SetLength(num);
+    for (long ii = 0; ii < num; ii++)
+        corrections[ii] = (evals[first + ii] - interpVals[ii]) * modVals[ii];
+
+    typename F::Poly correction;
+    cpiInterpolate<F>(correction, corrections, tree);
+    state.interp += state.modulus * correction;
+    state.modulus *= tree.back()[0];
+    state.count = evals.length();
+}
+
+/**
+ * Interpolates as cpiRatFuncInterpFast, but reuses the interpolation of earlier calls with the same state, so that
+ * only the evaluations beyond state.count are processed.  Over a sequence of calls with doubling numbers of
+ * evaluations, the total cost is thus that of a single interpolation over all of them, plus one (quasi-linear)
+ * reconstruction per call.
+ * @param state Interpolation state; must be cleared whenever mA, mB or previously seen evaluations change.
+ * @param evals Evaluations, of which only those from index state.count on are read.
+ */
+template <class F>
+bool cpiRatFuncInterpIncr(CPIInterpState<F>& state, const typename F::Vec& sampleLoc, const typename F::Vec& evals,
+                          long mA, long mB, typename F::Vec& P_vec, typename F::Vec& Q_vec) {
+    bool inverted = mA < mB;
+    if (state.inverted != inverted || state.count > evals.length())
+        state.count = 0; // nothing can be reused
+    state.inverted = inverted;
+
+    if (inverted) { // reconstruct Q/P from the inverted evaluations instead
+        typename F::Vec fresh, invEvals;
+        fresh.SetLength(evals.length() - state.count);
+        for (long ii = 0; ii < fresh.length(); ii++)
+            fresh[ii] = evals[state.count + ii];
+        cpiBatchInv<F>(fresh);
+        invEvals.SetLength(evals.length());
+        for (long ii = 0; ii < fresh.length(); ii++)
+            invEvals[state.count + ii] = fresh[ii];
+
+        cpiExtendInterp<F>(state, sampleLoc, invEvals);
+        return cpiRatFuncFromInterp<F>(state.interp, state.modulus, mB, mA, Q_vec, P_vec);
+    }
+
+    cpiExtendInterp<F>(state, sampleLoc, evals);
+    return cpiRatFuncFromInterp<F>(state.interp, state.modulus, mA, mB, P_vec, Q_vec);
+}
+
+/**
+ * Simultaneously finds the roots of the numerator and denominator of an interpolated rational function.
+ * @require P_vec and Q_vec must be monic (not checked) and square-free (checked)
+ * @return true if root-finding succeeded.
+ * @see CPISync::find_roots
+ */
+template <class F>
+bool cpiFindRoots(const typename F::Vec& P_vec, const typename F::Vec& Q_vec,
+                  typename F::Vec& numerator, typename F::Vec& denominator) {
+    // 0. initialization
+    typename F::Poly P_poly, Q_poly, gcd_poly;
+
+    // ... convert to polynomials
+    conv(P_poly, P_vec);
+    conv(Q_poly, Q_vec);
+
+    // ... bring to a fraction in lowest terms
+    gcd_poly = GCD(P_poly, Q_poly);
+    if (deg(gcd_poly) > 0) {
+        P_poly = P_poly / gcd_poly;
+        Q_poly = Q_poly / gcd_poly;
+    }
+    gcd_poly.kill(); // free up its memory
+
+    // 1. Check that the polynomials are square free - is gcd(poly, derivative(poly))==1?
+    if (!IsOne(GCD(P_poly, diff(P_poly))) ||
+            !IsOne(GCD(Q_poly, diff(Q_poly)))) {
+        Logger::gLog(Logger::METHOD, "Polynomial is not square free!\n");
+        return false;
+    }
+
+    // 2. Factor the two polynomials
+    // SFBerlekamp - "Berlekamp" factoring approach [Shoup, J. Symbolic Comp. 20:363-397, 1995].
+    typename F::VecPoly nn, dd;
+    SFBerlekamp(nn, P_poly);
+    for (long ii = 0; ii < nn.length(); ii++)
+        if (deg(nn[ii]) > 1) { // ended with a non-linear factor
+            Logger::gLog(Logger::METHOD, "Cannot reduce P_poly to linear factors..\n");
+            return false;
+        }
+
+    SFBerlekamp(dd, Q_poly);
+    for (long ii = 0; ii < dd.length(); ii++)
+        if (deg(dd[ii]) > 1) { // ended with a non-linear factor
+            Logger::gLog(Logger::METHOD, "Cannot reduce Q_poly to linear factors.\n");
+            return false;
+        }
+
+    // 3. Put the results into the numerator and denominator vectors and return
+    numerator.SetLength(deg(P_poly));
+    denominator.SetLength(deg(Q_poly));
+
+    for (long ii = 0; ii < nn.length(); ii++)
+        numerator[ii] = -ConstTerm(nn[ii]);
+    for (long ii = 0; ii < dd.length(); ii++)
+        denominator[ii] = -ConstTerm(dd[ii]);
+
+    // free up memory
+    P_poly.kill();
+    Q_poly.kill();
+
+    nn.kill();
+    dd.kill();
+
+    return true;
+}
+
+/**
+ * Finds the roots of a monic polynomial f among a list of candidate points, by multipoint evaluation of f over blocks
+ * of candidates.  Each block holds at least deg(f) candidates, so the total cost is quasi-linear in the number of
+ * candidates rather than in the size of the field.
+ * @param roots Set to the candidates at which f vanishes.
+ * @return true iff f has deg(f) distinct roots among the candidates, i.e. it is the product of (x - root)
+ *    over the returned roots.
+ * @require The candidates must be distinct.
+ */
+template <class F>
+bool cpiRootsAmong(typename F::Vec& roots, const typename F::Poly& f, const typename F::Vec& candidates) {
+    const long MIN_BLOCK = 256; // below this, the subproduct tree is not worth its overhead over Horner evaluation
+    roots.SetLength(0);
+    if (deg(f) <= 0)
+        return IsOne(f);
+
+    long blockSize = max(deg(f), MIN_BLOCK);
+    typename F::Vec block, values;
+    CPITree<F> tree;
+    for (long start = 0; start < candidates.length() && roots.length() < deg(f); start += blockSize) {
+        long len = min(blockSize, candidates.length() - start);
+        block.SetLength(len);
+        for (long ii = 0; ii < len; ii++)
+            block[ii] = candidates[start + ii];
+
+        cpiBuildTree<F>(tree, block, len);
+        cpiMultiEval<F>(values, f, tree);
+        for (long ii = 0; ii < len; ii++)
+            if (IsZero(values[ii]))
+                append(roots, block[ii]);
+    }
+
+    return roots.length() == deg(f);
+}
+
+/**
+ * Finds the roots of the numerator and denominator of an interpolated rational function, as cpiFindRoots does, but
+ * without general factoring:
+ *   * the roots of the denominator are elements of the local set, so they are found by multipoint evaluation of the
+ *     denominator at the local hashes (see cpiRootsAmong);
+ *   * the numerator is checked to be square-free and to split into linear factors (x^|F| = x modulo the numerator),
+ *     after which its roots are found by NTL's equal-degree splitting FindRoots.
+ * @param localHashes The (distinct) hashes of the local set, over the field F.
+ * @return true if root-finding succeeded.  Reasons for failure include a numerator that is not square-free or does not
+ *    split, and a denominator that is not the product of distinct local hashes.
+ * @see CPISync::find_roots
+ */
+template <class F>
+bool cpiFindRootsEvaluate(const typename F::Vec& P_vec, const typename F::Vec& Q_vec, const typename F::Vec& localHashes,
+                          typename F::Vec& numerator, typename F::Vec& denominator) {
+    // 0. initialization
+    typename F::Poly P_poly, Q_poly, gcd_poly;
+
+    // ... convert to polynomials
+    conv(P_poly, P_vec);
+    conv(Q_poly, Q_vec);
+
+    // ... bring to a fraction in lowest terms
+    gcd_poly = GCD(P_poly, Q_poly);
+    if (deg(gcd_poly) > 0) {
+        P_poly = P_poly / gcd_poly;
+        Q_poly = Q_poly / gcd_poly;
+    }
+    gcd_poly.kill(); // free up its memory
+
+    // 1. The denominator must be a product of distinct local hashes
+    if (!cpiRootsAmong<F>(denominator, Q_poly, localHashes)) {
+        Logger::gLog(Logger::METHOD, "Q_poly is not a product of local hashes.\n");
+        return false;
+    }
+
+    // 2. The numerator must be square free and split into linear factors over the field
+    numerator.SetLength(0);
+    if (deg(P_poly) > 0) {
+        if (!IsOne(GCD(P_poly, diff(P_poly)))) {
+            Logger::gLog(Logger::METHOD, "Polynomial is not square free!\n");
+            return false;
+        }
+
+        typename F::PolyModulus P_mod(P_poly);
+        typename F::Poly xPower, xPoly;
+        PowerXMod(xPower, F::Elem::modulus(), P_mod);
+        SetX(xPoly);
+        if (xPower != xPoly % P_poly) {
+            Logger::gLog(Logger::METHOD, "Cannot reduce P_poly to linear factors..\n");
+            return false;
+        }
+
+        FindRoots(numerator, P_poly);
+    }
+
+    return true;
+}
+
+/**
+ * Finds the roots of a monic polynomial, each with its multiplicity, from its square-free decomposition: each
+ * square-free factor is checked to split into linear factors (x^|F| = x modulo the factor), after which its roots are
+ * found by NTL's equal-degree splitting FindRoots.
+ * @param roots Set to the roots of f, each repeated as many times as it divides f.
+ * @return true iff f splits into linear factors over the field.
+ * @require deg(f) is smaller than the characteristic of the field.
+ */
+template <class F>
+bool cpiRootsWithMultiplicity(typename F::Vec& roots, const typename F::Poly& f) {
+    roots.SetLength(0);
+    if (deg(f) <= 0)
+        return true;
+
+    typename F::VecFactors factors;
+    SquareFreeDecomp(factors, f);
+    typename F::Poly xPower, xPoly;
+    typename F::Vec factorRoots;
+    SetX(xPoly);
+    for (long ii = 0; ii < factors.length(); ii++) {
+        const typename F::Poly& factor = factors[ii].a;
+        typename F::PolyModulus factorMod(factor);
+        PowerXMod(xPower, F::Elem::modulus(), factorMod);
+        if (xPower != xPoly % factor) {
+            Logger::gLog(Logger::METHOD, "Cannot reduce polynomial to linear factors.\n");
+            return false;
+        }
+
+        FindRoots(factorRoots, factor);
+        for (long jj = 0; jj < factorRoots.length(); jj++)
+            for (long copy = 0; copy < factors[ii].b; copy++)
+                append(roots, factorRoots[jj]);
+    }
+    return true;
+}
+
+/**
+ * Finds the roots of the numerator and denominator of an interpolated rational function, as cpiFindRoots does, but
+ * with multiplicities, for the characteristic polynomials of multisets in which copies of an element share a root
+ * (see CPISync::setMultiset).  Reducing the fraction to lowest terms cancels the copies that both multisets hold, so
+ * each root is returned as many times as one multiset holds it more often than the other.
+ * @return true if root-finding succeeded.
+ * @see CPISync::find_roots
+ */
+template <class F>
+bool cpiFindRootsMultiset(const typename F::Vec& P_vec, const typename F::Vec& Q_vec,
+                          typename F::Vec& numerator, typename F::Vec& denominator) {
+    typename F::Poly P_poly, Q_poly, gcd_poly;
+    conv(P_poly, P_vec);
+    conv(Q_poly, Q_vec);
+
+    // ... bring to a fraction in lowest terms
+    gcd_poly = GCD(P_poly, Q_poly);
+    if (deg(gcd_poly) > 0) {
+        P_poly = P_poly / gcd_poly;
+        Q_poly = Q_poly / gcd_poly;
+    }
+
+    return cpiRootsWithMultiplicity<F>(numerator, P_poly) && cpiRootsWithMultiplicity<F>(denominator, Q_poly);
+}
+
+#endif /* CPI_FIELD_H */
@@ -0,0 +1,81 @@
+/* This code is part of the CPISync project developed at Boston University.  Please see the README for use and references. */
+
+/*
+ * File:   CPIKernels.h
+ * Montgomery arithmetic on arrays of residues modulo a word-sized odd prime, for the per-sample-location loops of
+ * CPISync over a word-sized field (see CPIField.h).  Residues are held in longs, as in the entries of NTL's vec_zz_p.
+ *
+ * Each loop has a portable scalar implementation and, on x86-64, AVX2, AVX-512F and AVX-512 IFMA implementations,
+ * one of which is chosen at construction from the modulus size and the instruction sets reported by CPUID:
+ *   - AVX-512F / AVX2: 8 / 4 lanes of 32-bit Montgomery multiplication (R = 2^32), for moduli below 2^31;
+ *   - AVX-512 IFMA: 8 lanes of 52-bit Montgomery multiplication (R = 2^52), for larger moduli below 2^50;
+ *   - scalar: 64-bit Montgomery multiplication (R = 2^64) with 128-bit products, for any modulus below 2^63.
+ * Results are exact, and so independent of the implementation chosen.
+ */
+
+#ifndef CPI_KERNELS_H
+#define CPI_KERNELS_H
+
+#include <cstdint>
+
+class CPIMontgomery {
+public:
+    /** Implementations, by the instruction sets they need (each of which includes the previous ones). */
+    enum class Isa {Scalar, AVX2, AVX512F, AVX512IFMA};
+
+    /**
+     * Prepares Montgomery arithmetic modulo p.
+     * @param limit The most demanding implementation that may be chosen (e.g. Isa::Scalar forces the scalar one).
+     * @require p is an odd prime below 2^62.
+     */
+    explicit CPIMontgomery(long p, Isa limit = Isa::AVX512IFMA);
+
+    /**
+     * @return The implementation in use.
+     */
+    Isa isa() const { return myIsa; }
+
+    /**
+     * @return A printable name for an implementation.
+     */
+    static const char *isaName(Isa isa);
+
+    /**
+     * @return The Montgomery form a R mod p of the residue a, where R depends on the implementation in use.
+     */
+    long toMont(long a) const;
+
+    /**
+     * vals[i] = vals[i] * (factors[i] - sub) / R mod p, for i < n.  With factors and sub in Montgomery form, this
+     * multiplies the (ordinary) residues vals[i] by the residues that factors[i] - sub represent.
+     */
+    void mulSub(long *vals, const long *factors, long sub, long n) const;
+
+    /**
+     * vals[i] = 1 / vals[i], for i < n, with inputs and outputs in Montgomery form, using a single inversion modulo
+     * p (Montgomery's simultaneous inversion).
+     * @require No vals[i] is zero.
+     */
+    void batchInv(long *vals, long n) const;
+
+    /**
+     * @return prod_{i < n} (c - roots[i]) mod p, for ordinary residues c and roots[i].
+     */
+    long prodSub(long c, const long *roots, long n) const;
+
+private:
+    /** @return a b / R mod p, for a, b < p. */
+    uint64_t _mul(uint64_t a, uint64_t b) const;
+
+    /** @return a b mod p, for a, b < p (plain 128-bit reduction). */
+    uint64_t _mulPlain(uint64_t a, uint64_t b) const;
+
+    Isa myIsa; /** The implementation in use. */
+    uint64_t mod; /** The modulus p. */
+    int rBits; /** R = 2^rBits. */
+    uint64_t rMask; /** R - 1. */
+    uint64_t pNegInv; /** -1/p mod R. */
+    uint64_t r1; /** R mod p. */
+};
+
+#endif /* CPI_KERNELS_H */
@@ -0,0 +1,123 @@
+/* This code is part of the CPISync project developed at Boston University.  Please see the README for use and references. */
+
+/*
+ * File:   CPIPlan.h
+ * Sample locations, and the data derived from them, shared by all CPISync objects with the same parameters.
+ *
+ * The sample locations of a CPISync object depend only on its element bit-length, mbar and redundancy, so every
+ * CPISync_ExistingConnection node of an InterCPISync tree (for example) samples at exactly the same points.  A plan
+ * holds these points once per process, together with the subproduct trees over them that bulk loading and deletion
+ * need, and (over the word-sized field) the vectorized kernels with the points in their Montgomery form; it is
+ * immutable after construction except for these, which are built on first use under a lock and never change
+ * afterwards.
+ */
+
+#ifndef CPI_PLAN_H
+#define CPI_PLAN_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+#include <vector>
+#include <CPISync/Aux/CPIField.h>
+#include <CPISync/Aux/CPIKernels.h>
+
+template <class F>
+class CPIPlan {
+public:
+    /**
+     * Creates the num sample locations dataMax + 1 ... dataMax + num.
+     * @require The modulus of field F must be installed.
+     */
+    CPIPlan(const ZZ& dataMax, long num) {
+        sampleVec.SetLength(num);
+        for (long ii = 0; ii < num; ii++)
+            conv(sampleVec[ii], dataMax + ii + 1); // i.e. from the region outside where valid data might lie
+    }
+
+    /**
+     * @return The sample locations.
+     */
+    const typename F::Vec& samples() const { return sampleVec; }
+
+    /**
+     * @return The subproduct tree (see cpiBuildTree) of the first count sample locations.
+     * @require The modulus of field F must be installed, and 1 <= count <= samples().length().
+     */
+    std::shared_ptr<const CPITree<F>> tree(long count) const {
+        std::lock_guard<std::mutex> lock(treeMutex);
+        std::shared_ptr<const CPITree<F>>& cached = trees[count];
+        if (!cached) {
+            auto built = std::make_shared<CPITree<F>>();
+            cpiBuildTree<F>(*built, sampleVec, count);
+            cached = built;
+        }
+        return cached;
+    }
+
+    /**
+     * @return Vectorized arithmetic modulo the field's modulus (see CPIMontgomery), built on first use together
+     * with samplesMont.
+     * @require F must be WordField, and its modulus must be installed.
+     */
+    std::shared_ptr<const CPIMontgomery> montgomery() const {
+        std::lock_guard<std::mutex> lock(treeMutex);
+        if (!mont) {
+            auto built = std::make_shared<const CPIMontgomery>(F::Elem::modulus());
+            sampleMontVec.resize(sampleVec.length());
+            for (long ii = 0; ii < sampleVec.length(); ii++)
+                sampleMontVec[ii] = built->toMont(rep(sampleVec[ii]));
+            mont = built;
+        }
+        return mont;
+    }
+
+    /**
+     * @return The sample locations in the Montgomery form of montgomery().
+     * @require montgomery() must have been called.
+     */
+    const std::vector<long>& samplesMont() const { return sampleMontVec; }
+
+private:
+    typename F::Vec sampleVec; /** The sample locations. */
+    mutable std::mutex treeMutex; /** Guards trees, and mont and sampleMontVec. */
+    mutable std::map<long, std::shared_ptr<const CPITree<F>>> trees; /** Subproduct trees, by number of sample locations. */
+    mutable std::shared_ptr<const CPIMontgomery> mont; /** Vectorized arithmetic, for WordField only (see montgomery). */
+    mutable std::vector<long> sampleMontVec; /** The sample locations in mont's Montgomery form. */
+};
+
+/**
+ * Looks up the process-wide plan for CPISync objects with the given parameters, creating it if no live object
+ * currently uses it.  Plans are only kept alive by the objects that use them, and the cache forgets the others
+ * whenever it creates a plan.
+ * @param bitNum The (effective) number of bits per element; determines the first sample location, 2^bitNum + 1.
+ * @param maxDiff, redundant The number of sample locations is maxDiff + redundant.
+ * @require The modulus of field F must be the one derived from these parameters, and must be installed.
+ * @note Thread-safe.
+ */
+template <class F>
+std::shared_ptr<const CPIPlan<F>> cpiPlan(long bitNum, long maxDiff, int redundant) {
+    static std::mutex cacheMutex;
+    static std::map<std::tuple<long, long, int>, std::weak_ptr<const CPIPlan<F>>> cache;
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    std::weak_ptr<const CPIPlan<F>>& entry = cache[std::make_tuple(bitNum, maxDiff, redundant)];
+    std::shared_ptr<const CPIPlan<F>> plan = entry.lock();
+    if (!plan) {
+        plan = std::make_shared<const CPIPlan<F>>(power(ZZ(2), bitNum), maxDiff + redundant);
+        entry = plan;
+
+        // drop the entries of plans that no object uses any more, so that the cache does not grow with every
+        // combination of parameters ever used
+        for (auto itr = cache.begin(); itr != cache.end(); ) {
+            if (itr->second.expired())
+                itr = cache.erase(itr);
+            else
+                ++itr;
+        }
+    }
+    return plan;
+}
+
+#endif /* CPI_PLAN_H */
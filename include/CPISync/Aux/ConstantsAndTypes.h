@@ -55,6 +55,24 @@ enum class SYNC_TYPE : byte {
   IBLTSync_Multiset
 };
 
+// ... ... rational function interpolation engine used by the CPISync family
+enum class INTERP_TYPE : byte {
+  Gauss, /** Solves the Vandermonde linear system by Gaussian elimination (cubic in the number of differences). */
+  Fast   /** Subproduct-tree interpolation plus half-GCD reconstruction (quasi-linear in the number of differences). */
+};
+
+// ... ... root finding approach used by the CPISync family
+enum class ROOT_TYPE : byte {
+  Factor,  /** Factors the numerator and denominator with Berlekamp's algorithm. */
+  Evaluate /** Evaluates the denominator at the local hashes and splits the numerator by equal-degree factoring. */
+};
+
+// ... ... hash of set elements used by the CPISync family (see ElementHash.h)
+enum class HASH_TYPE : byte {
+  Modulo, /** Reduces the element's integer encoding modulo 2^bits (one bignum division per element). */
+  Keyed   /** A keyed multiply-fold hash over the element's bytes, 64 bits at a time, truncated to bits. */
+};
+
 // ... Error constants
 static const int SYNC_SUCCESS = 0; /** Exit status when synchronization succeeds. */
 static const int SYNC_FAILURE = -1; /** Exit status when synchronization fails. */
@@ -0,0 +1,59 @@
+/* This code is part of the CPISync project developed at Boston University.  Please see the README for use and references. */
+
+/*
+ * File:   ElementHash.h
+ * The hash by which the CPISync family reduces set elements to b-bit integers.
+ *
+ * HASH_TYPE::Modulo reduces an element's integer encoding modulo 2^b, which, for long elements, means a bignum
+ * division per element.  HASH_TYPE::Keyed instead runs a keyed multiply-fold hash (in the style of wyhash) over the
+ * element's bytes, eight at a time; each 64 bits of the result come from a pass with their own key, and the result is
+ * truncated to b bits.  Neither is cryptographic: the key only needs to be shared by the synchronizing parties.
+ */
+
+#ifndef ELEMENT_HASH_H
+#define ELEMENT_HASH_H
+
+#include <cstdint>
+#include <NTL/ZZ.h>
+#include <CPISync/Aux/ConstantsAndTypes.h>
+#include <CPISync/Data/DataObject.h>
+
+class ElementHash {
+public:
+    /**
+     * @param type The hash function.
+     * @param bits The number of bits of each hash.
+     * @param key The key of HASH_TYPE::Keyed (ignored by HASH_TYPE::Modulo).
+     */
+    explicit ElementHash(HASH_TYPE type = HASH_TYPE::Modulo, long bits = 64, uint64_t key = DFT_KEY);
+
+    /**
+     * @return The hash of datum, between 0 and 2^bits - 1.
+     */
+    ZZ operator()(const DataObject& datum) const;
+
+    /**
+     * @return The hash function in use.
+     */
+    HASH_TYPE type() const { return myType; }
+
+    /**
+     * @return The key in use.
+     */
+    uint64_t key() const { return myKey; }
+
+    /**
+     * @return The keyed 64-bit multiply-fold hash of len bytes.
+     */
+    static uint64_t hash64(const unsigned char *data, size_t len, uint64_t seed);
+
+    static const uint64_t DFT_KEY; /** The key used unless another is given. */
+
+private:
+    HASH_TYPE myType; /** The hash function in use. */
+    long myBits; /** The number of bits of each hash. */
+    ZZ dataMax; /** 2^myBits. */
+    uint64_t myKey; /** The key of HASH_TYPE::Keyed. */
+};
+
+#endif /* ELEMENT_HASH_H */
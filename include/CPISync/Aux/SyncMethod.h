@@ -6,12 +6,14 @@
 #include <algorithm>
 #include <vector>
 #include <memory>
+#include <unordered_map>
 #include <chrono>
 #include <CPISync/Communicants/Communicant.h>
 
 // namespaces
 using std::vector;
 using std::list;
+using std::unordered_multimap;
 
 /**
  * SyncMethod.h -- abstract class for sync methods
@@ -70,18 +72,48 @@ public:
      * hash, so it is advisable not to change the datum dereference hereafter.
      * @return true iff the addition was successful
      */
-    virtual bool addElem(shared_ptr<DataObject> datum) { elements.push_back(datum); return true; };
+    virtual bool addElem(shared_ptr<DataObject> datum) {
+        elementPos.emplace(datum.get(), elements.size());
+        elements.push_back(datum);
+        return true;
+    };
+
+    /**
+     * Add a batch of elements to the data structure that will be performing the synchronization.
+     * By default, this simply adds the elements one at a time; sync methods that can amortize the work
+     * of many additions should override it.
+     * @param data The elements to add.
+     * @return true iff every addition was successful
+     */
+    virtual bool addElems(const list<shared_ptr<DataObject>>& data) {
+        bool result = true;
+        for (const auto& datum : data)
+            if (!addElem(datum))
+                result = false;
+        return result;
+    }
 
     /**
      * Delete an element from the data structure that will be performing the synchronization.
      * @param datum The element to delete.
      * @return true iff the removal was successful
      */
-    virtual bool delElem(shared_ptr<DataObject> datum) { 
-        long int before = elements.size();
-        elements.erase(std::remove(elements.begin(), elements.end(), datum), elements.end());
-        return before > elements.size(); // true iff there were more elements before removal than after
-    };
+    virtual bool delElem(shared_ptr<DataObject> datum);
+
+    /**
+     * Delete a batch of elements from the data structure that will be performing the synchronization.
+     * By default, this simply deletes the elements one at a time; sync methods that can amortize the work
+     * of many deletions should override it.
+     * @param data The elements to delete.
+     * @return true iff every removal was successful
+     */
+    virtual bool delElems(const list<shared_ptr<DataObject>>& data) {
+        bool result = true;
+        for (const auto& datum : data)
+            if (!delElem(datum))
+                result = false;
+        return result;
+    }
 
     // INFORMATIONAL
     /**
@@ -273,6 +305,8 @@ protected:
     
 private:
     vector<shared_ptr<DataObject>> elements; /** Pointers to the elements stored in the data structure. */
+    unordered_multimap<const DataObject*, size_t> elementPos; /** The position(s) in elements of each stored element,
+                                                                * so that deletion need not search elements. */
 };
 
 
@@ -0,0 +1,79 @@
+/* This code is part of the CPISync project developed at Boston University.  Please see the README for use and references. */
+
+/*
+ * File:   ThreadPool.h
+ * A fixed-size pool of worker threads for splitting loops over independent indices (e.g. sample locations) across
+ * cores.  Each index is processed exactly once by a single thread, so results do not depend on the scheduling.
+ *
+ * Worker threads do not inherit thread-local state of the caller, notably NTL's current ZZ_p/zz_p moduli (with
+ * NTL_THREADS); loop bodies that use them must restore the appropriate contexts themselves (see CPISync::_parallelFor).
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    /**
+     * Constructs a pool that runs loops on numThreads threads: the calling thread and numThreads - 1 workers.
+     * @param numThreads The number of threads; 0 means one per hardware thread.
+     */
+    explicit ThreadPool(unsigned numThreads);
+
+    /**
+     * Stops and joins the workers.
+     */
+    ~ThreadPool();
+
+    // no copying
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @return The number of threads that loops are split across.
+     */
+    unsigned size() const { return (unsigned) workers.size() + 1; }
+
+    /**
+     * Runs body(begin, end) on disjoint, contiguous ranges covering 0 ... num-1, in parallel, and waits for all of
+     * them.  The calling thread takes part, and takes on any ranges that no worker picks up, so parallelFor may be
+     * called from within a loop body, and still completes in a forked child (which has no workers).
+     * @param minChunk Ranges are at least this long (except when num is smaller), to amortize the dispatch overhead.
+     * @throws The first exception thrown by any invocation of body, after all ranges have finished.
+     */
+    void parallelFor(long num, const std::function<void(long begin, long end)>& body, long minChunk = 1);
+
+    /**
+     * Runs body(index) for each index in 0 ... num-1, in parallel, and waits for all of them.  Unlike parallelFor,
+     * indices are handed out one at a time to whichever thread is free next, so that a few costly indices do not hold
+     * up a whole range of cheap ones.  Otherwise as parallelFor.
+     */
+    void parallelForEach(long num, const std::function<void(long index)>& body);
+
+private:
+    /**
+     * Worker thread loop:  runs queued tasks until the pool is stopped.
+     */
+    void _work();
+
+    /**
+     * Runs one queued task, if there is one.
+     * @return true iff a task was run.
+     */
+    bool _runOne();
+
+    std::vector<std::thread> workers; /** Worker threads. */
+    std::deque<std::function<void()>> tasks; /** Queued tasks. */
+    std::mutex mtx; /** Guards tasks and stopping. */
+    std::condition_variable ready; /** Signalled when a task is queued or the pool stops. */
+    bool stopping; /** True once the pool is being destroyed. */
+};
+
+#endif /* THREADPOOL_H */
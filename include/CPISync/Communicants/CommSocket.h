@@ -51,6 +51,7 @@ public:
     /**
      * Send data over the socket.  This is the primitive send method for the class.
      * %R: Must have called either commListen or commConnect already.
+     * @throws SyncFailureException if the data could not be sent, e.g. because the connection was lost.
      * @see Communicant.h for more explanations, please.
      */
     void commSend(const char *toSend, size_t numBytes) override;
@@ -60,6 +61,8 @@ public:
      * This is the primitive receive method that all other methods call.
      * %R: Must have called either commListen or commConnect already.
      * @return The string of characters received.
+     * @throws SyncFailureException if fewer than numBytes characters could be received, e.g. because the connection
+     *    was lost.
      * @see Communicant.h for more explanations, please.
      */
     string commRecv(unsigned long numBytes) override;
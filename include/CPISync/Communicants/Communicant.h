@@ -16,12 +16,16 @@
 #include <CPISync/Data/DataPriorityObject.h>
 #include <CPISync/Syncs/IBLT.h>
 #include <CPISync/Syncs/IBLTMultiset.h>
+#include <CPISync/Syncs/IBLTFixed.h>
 #include <CPISync/Syncs/Cuckoo.h>
 
 // namespace imports
 using namespace NTL;
 using std::list;
 
+// The version of the format in which IBLTs are sent (see Communicant::commSend(const IBLT&, bool))
+const byte IBLT_WIRE_VERSION = 1;
+
 /**
  * A communicant is either a local or remote entity to whom one connects
  * or from whom one listens for connections
@@ -78,7 +82,7 @@ public:
      * @param oneWay If true, only the IBLT parameters are sent to the other communicant,
      *  but no response is awaited.
      * @require an active connection via commConnect
-     * @return true iff common parameters were verified (i.e. other size and eltSize == our size and eltSize) or oneWay is true
+     * @return true iff common parameters were verified (i.e. other size, eltSize and IBLT_HASH_VERSION == ours) or oneWay is true
      */
     bool establishIBLTSend(size_t size, size_t eltSize, bool oneWay = false);
 
@@ -88,7 +92,7 @@ public:
     * @param eltSize The size of values of the IBLTs to be communicated
     * @param oneWay If true, verification of common parameters is sent to the other communicant.
     * @require an active connection via commConnect
-    * @return true iff common parameters were verified (i.e. other size and eltSize == our size and eltSize)
+    * @return true iff common parameters were verified (i.e. other size, eltSize and IBLT_HASH_VERSION == ours)
     */
     bool establishIBLTRecv(size_t size, size_t eltSize, bool oneWay = false);
 
@@ -236,7 +240,11 @@ public:
     void commSend(const vec_ZZ_p &vec);
 
     /**
-     * Sends an IBLT.
+     * Sends an IBLT, as one buffer (after its length) in the columnar format of version IBLT_WIRE_VERSION:
+     *  - the version (1 byte), and the width in bytes of the key sums (a varint);
+     *  - a bitmap of the non-empty cells (1 bit per cell, from the least significant bit of the first byte on);
+     *  - for the non-empty cells only, one column after the other: their counts (zig-zag varints), their hash-checks
+     *    (8 bytes), their key sums (key width bytes) and their value sums (eltSize bytes), all little-endian.
      * @param iblt The IBLT to send.
      * @param sync Should be true iff EstablishModSend/Recv called and/or the receiver knows the IBLT's size and eltSize
      */
@@ -249,6 +257,15 @@ public:
      */
     void commSend(const IBLTMultiset &iblt, bool sync = false);
 
+    /**
+     * Sends an IBLTFixed, in the same format as the IBLT with the same cells (so that it is received by commRecv_IBLT
+     * or commRecv_IBLTFixed),
+     * straight from its columns.
+     * @param iblt The IBLTFixed to send.
+     * @param sync Should be true iff EstablishModSend/Recv called and/or the receiver knows the IBLT's size and eltSize
+     */
+    void commSend(const IBLTFixed &iblt, bool sync = false);
+
     /**
      * Sends Cuckoo filter.
      * @param The Cuckoo filter to send.
@@ -331,9 +348,19 @@ public:
      * @param size The size of the IBLT to be received.  Must be >0 or NOT_SET.
      * @param eltSize The size of values of the IBLTs to be received.  Must be >0 or NOT_SET.
      * If parameters aren't set, the IBLT will be received successfully iff commSend(IBLT, false) was used to send the IBLT
+     * @throws SyncFailureException if the IBLT was sent in another format version, or is malformed
      */
     IBLT commRecv_IBLT(Nullable<size_t> size=NOT_SET<size_t>(), Nullable<size_t> eltSize=NOT_SET<size_t>());
 
+    /**
+     * Receives an IBLT, in the format of commRecv_IBLT, straight into the columns of an IBLTFixed.
+     * @param size The size of the IBLT to be received.  Must be >0 or NOT_SET.
+     * @param eltSize The size of keys and values of the IBLT to be received.  Must be >0 or NOT_SET.
+     * @throws SyncFailureException if the IBLT was sent in another format version, or is malformed (including if its
+     * key sums are wider than eltSize)
+     */
+    IBLTFixed commRecv_IBLTFixed(Nullable<size_t> size=NOT_SET<size_t>(), Nullable<size_t> eltSize=NOT_SET<size_t>());
+
     /**
      * Receives an IBLTMultiset.
      * @param size The size of the IBLT to be received.  Must be >0 or NOT_SET.
@@ -374,6 +401,12 @@ public:
      */
     unsigned long getRecvBytesTot();
 
+    /**
+     * @return The number of round trips made with this Communicant since the last reset (with {@link #hardResetCommCounters}),
+     * counted as the number of times that bytes were received after bytes were transmitted.
+     */
+    unsigned long getRoundTripsTot() const;
+
 
     /**
      * @return A name for this communicant.
@@ -426,6 +459,9 @@ protected:
     unsigned long recvBytes; /** The number of bytes that have been received since the last reset. */
     unsigned long recvBytesTot; /** The total number of bytes that have been received since the creation of this communicant. */
 
+    unsigned long roundTripsTot; /** The number of round trips since the last hard reset (see getRoundTripsTot). */
+    bool lastXmit; /** True iff the last bytes counted were transmitted, rather than received. */
+
     Nullable<size_t> MOD_SIZE = NOT_SET<size_t>();    /** The number of (8-bit) characters needed to represent the ZZ_p modulus.*/
 
     // CONSTANTS
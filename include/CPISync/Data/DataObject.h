@@ -92,6 +92,13 @@ public:
      */
     string to_string() const;
 
+    /**
+     * Copies the bytes of the ZZ encoding of this data object, least significant first, without building a string.
+     * (For a data object made from a string, these are the bytes of the string, as with to_string.)
+     * @param bytes Set to the bytes.
+     */
+    void to_bytes(std::vector<unsigned char>& bytes) const;
+
     /**
     * @return a multiset containing all the data object in the set
     **/
@@ -4,17 +4,31 @@
 #ifndef CPI_SYNC_H
 #define CPI_SYNC_H
 
+#include <functional>
+#include <unordered_map>
 #include <NTL/RR.h>
 #include <NTL/ZZ_pX.h>
 #include <NTL/vec_ZZ_p.h>
 #include <NTL/ZZ_pXFactoring.h>
 #include <CPISync/Aux/Auxiliary.h>
+#include <CPISync/Aux/CPIField.h>
+#include <CPISync/Aux/CPIKernels.h>
+#include <CPISync/Aux/CPIPlan.h>
+#include <CPISync/Aux/ElementHash.h>
 #include <CPISync/Aux/SyncMethod.h>
+#include <CPISync/Aux/ThreadPool.h>
 
 // namespaces
 
 using namespace NTL;
 
+// The version of the sync parameters exchanged by SendSyncParam/RecvSyncParam, sent right after the sync ID.
+// Peers with different versions cannot parse one another's parameters, so the sync fails at once.
+//  1 - no version byte; CPISync sends mbar, bits and epsilon
+//  2 - the version byte; CPISync then adds the multiset mode, the hash type and the hash key to version 1's
+//      parameters, and InterCPISync sends its own parameters likewise
+const byte CPISYNC_PARAM_VERSION = 2;
+
 /**
  * Implements a data structure for storing mathematical multi-sets of data
  *    in a manner that is consistent with fast synchronization.
@@ -23,7 +37,8 @@ using namespace NTL;
  *    m (b-bit) packets of communication.
  * 
  * Note that this data structure is really designed for sets, rather than multi-sets.
- * It can handle multi-sets, but there are more efficient ways of dealing with them.
+ * By default, it handles multi-sets by giving each copy of an element a hash of its own; the multiset mode
+ * (see setMultiset) handles them natively instead.
  * 
  *
  */
@@ -106,9 +121,45 @@ public:
       return result;
   }
 
+  /**
+   * Adds a batch of elements at once.  All elements are hashed first, and the characteristic polynomial
+   * evaluations are then updated block by block with product-tree evaluation, rather than element by element.
+   * @return true iff every element was added (elements that cannot be added are skipped, as with addElem).
+   */
+  bool addElems(const list<shared_ptr<DataObject>>& data) override;
+
   // update metadata when an element is being deleted (the element is supplied by index)
   bool delElem(shared_ptr<DataObject> newDatum) override;
 
+  /**
+   * Deletes a batch of elements at once.  The removed factors of the characteristic polynomial are multiplied together
+   * and divided out of each evaluation with a single batch inversion, rather than one division per element.
+   * @return true iff every element was found and deleted.
+   */
+  bool delElems(const list<shared_ptr<DataObject>>& data) override;
+
+  /**
+   * Saves a snapshot of this object's sketch - parameters, sample locations, characteristic polynomial evaluations and
+   * hash index - so that loadSnapshot can later restore it without rehashing and re-evaluating every element.
+   * @param snapFile The file to which the snapshot is written (it is overwritten).
+   * @param order Exactly the elements stored in this object, in the order in which they will be supplied to loadSnapshot.
+   * @param dataChecksum A checksum (e.g. fnv1a64) of the backing data from which the elements will be reloaded.
+   * @return true iff the snapshot was written.
+   */
+  bool saveSnapshot(const string& snapFile, const list<shared_ptr<DataObject>>& order, uint64_t dataChecksum);
+
+  /**
+   * Restores a snapshot written by saveSnapshot into this (empty) object.  The snapshot file is memory-mapped and
+   * validated (format, own checksum, parameters matching this object's, dataChecksum and number of elements) before
+   * anything is modified.
+   * @param snapFile The snapshot file.
+   * @param order The elements to store, in the order that was given to saveSnapshot.
+   * @param dataChecksum The checksum of the backing data from which order was read.
+   * @return true iff the snapshot was valid and restored; otherwise this object is left untouched and elements
+   *    should be added in the usual way.
+   */
+  bool loadSnapshot(const string& snapFile, const list<shared_ptr<DataObject>>& order, uint64_t dataChecksum);
+
   /**
    * @return A string with some internal information about this object.
    */
@@ -119,6 +170,92 @@ public:
    */
   string printElem();
 
+  /**
+   * Selects the engine used to interpolate the rational function during reconciliation.
+   * Only the reconciling (server) side interpolates, so the two parties need not agree on this.
+   */
+  void setInterpType(INTERP_TYPE type) { interpType = type; }
+
+  /**
+   * Selects how the roots of the interpolated rational function are found during reconciliation.
+   * As with the interpolation engine, only the reconciling (server) side is affected.
+   */
+  void setRootType(ROOT_TYPE type) { rootType = type; }
+
+  /**
+   * Splits work over sample locations (bulk updates of the evaluations and the redundancy checks of reconciliation)
+   * across the threads of pool; results do not depend on the number of threads.  Without a pool (the default),
+   * everything runs on the calling thread.
+   * @note Requires an NTL built with NTL_THREADS, so that each thread has its own field modulus; otherwise the pool
+   *    is ignored.
+   */
+  void setThreadPool(shared_ptr<ThreadPool> pool);
+
+  /**
+   * Selects the native multiset mode.  By default, each copy of an element is given a hash of its own, by probing
+   * successive secondary hashes for one that is not yet in use, so that adding k copies of an element costs O(k^2)
+   * look-ups.  In the multiset mode, every copy of an element shares its hash, which is stored once, with the number
+   * of copies; each copy is a repeated root of the characteristic polynomial, so that adding or removing a copy costs
+   * a constant number of look-ups, and reconciliation recovers how many more copies of an element one side holds from
+   * the multiplicities of the roots (with the roots found by square-free decomposition, whatever setRootType selects).
+   * Without hashes, duplicate elements are then also permitted.  Both parties must agree on this.
+   * @require No element has been added yet.
+   */
+  void setMultiset(bool multiset);
+
+  /**
+   * Selects the hash by which elements are reduced to bitNum bits when hashes are used (see ElementHash.h).  By default
+   * (HASH_TYPE::Modulo), an element's integer encoding is reduced modulo 2^bitNum, which costs a bignum division per
+   * element; HASH_TYPE::Keyed hashes the element's bytes instead, in a few multiplications per 8 bytes.  Without hashes,
+   * the encoding itself is synchronized (so that differences can be decoded), and this has no effect.  Both parties must
+   * agree on the hash and its key.
+   * @require No element has been added yet.
+   */
+  void setHashType(HASH_TYPE type, uint64_t key = ElementHash::DFT_KEY);
+
+  /*
+   * The following let a protocol that drives many CPISync objects over one connection (e.g. a level of InterCPISync's
+   * partition tree) batch their exchanges, instead of running SyncClient / SyncServer on each in turn.
+   */
+
+  /**
+   * @return The characteristic polynomial evaluations that SyncClient would send: the first currDiff + redundant_k.
+   */
+  vec_ZZ_p getSketch();
+
+  /**
+   * Sets the number of differences presumed by getSketch and reconcileSketch (at most, and by default, the m_bar given
+   * at construction), so that fewer evaluations are exchanged for a node that is expected to differ in few elements.
+   */
+  void setCurrDiff(long diff) { currDiff = std::min(diff, maxDiff); }
+
+  /**
+   * Reconciles this object with another one, given the other's size and getSketch, as SyncServer would, including
+   * the check against the redundant evaluations.
+   * @param delta_self Set to the hashes in this set but not the other.
+   * @param delta_other Set to the hashes in the other set but not this one.
+   * @return true iff reconciliation succeeded.
+   */
+  bool reconcileSketch(long otherSetSize, const vec_ZZ_p& otherSketch, vec_ZZ_p& delta_self, vec_ZZ_p& delta_other);
+
+  /**
+   * @return The element stored with the given hash (or, without hashes, the element that the hash encodes);
+   *    nullptr if hashes are used and none is stored with this one.
+   */
+  shared_ptr<DataObject> hashToElement(const ZZ_p& hash) const;
+
+  /**
+   * @return The time (in seconds) spent interpolating the rational function of a reconciliation, and finding the roots
+   *    of its numerator and denominator, over every reconciliation since construction or the last resetReconcileTimes.
+   */
+  double getInterpTime() const { return interpTime; }
+  double getRootTime() const { return rootTime; }
+
+  /**
+   * Resets the times returned by getInterpTime and getRootTime.
+   */
+  void resetReconcileTimes() { interpTime = rootTime = 0; }
+
   
 protected:
   // internal data
@@ -147,7 +284,20 @@ protected:
   int probEps; /** Negative log of the upper bound on the probability of error for the synchronization. */
   ZZ fieldSize; /** The size of the finite field used to represent set elements. */
 
-  vec_ZZ_p sampleLoc; /** Locations at which the set's characteristic polynomial is sampled. */
+  shared_ptr<const CPIPlan<BigField>> samplePlan; /** Locations at which the set's characteristic polynomial is sampled,
+                                                   *  shared with every CPISync of the same parameters (see CPIPlan.h). */
+  bool wordField; /** True iff fieldSize fits in a machine word.  In that case the characteristic polynomial evaluations
+                   *  are maintained, interpolated and factored over NTL's single-precision zz_p (see CPIField.h), and
+                   *  the ZZ_p structures are only used at the communication boundary. */
+  zz_pContext wordContext; /** The word-sized field modulo fieldSize; only meaningful if wordField is true. */
+  shared_ptr<const CPIPlan<WordField>> samplePlanWord; /** samplePlan over the word-sized field; only set if wordField is true. */
+  shared_ptr<const CPIMontgomery> montWord; /** Vectorized arithmetic modulo fieldSize, from samplePlanWord; only set if
+                                              *  wordField is true. */
+  INTERP_TYPE interpType; /** The rational function interpolation engine used by set_reconcile. */
+  ROOT_TYPE rootType; /** The root finding approach used by set_reconcile. */
+  CPIInterpState<BigField> interpState; /** Interpolation carried between the rounds of one synchronization (Fast engine only). */
+  CPIInterpState<WordField> interpStateWord; /** interpState over the word-sized field; only used if wordField is true. */
+  shared_ptr<ThreadPool> threadPool; /** Threads across which work over sample locations is split (or null, for none). */
   long currDiff; /** The number of differences currently being synchronization. (initially set by the constructor) - for iterative methods. */
   int redundant_k; /** the number of redundant samples of the characteristic polynomial to evaluate.
                          *  This relates to the probability of error for the synchronization. */
@@ -158,16 +308,32 @@ protected:
                                            *  All operations are done on the hashes, and this look-up table can be used to retrieve
                                            *  the actual element once the hashes have been synchronized.
                                            */
+  unordered_multimap< const DataObject*, ZZ > CPI_revHash; /** The reverse of CPI_hash: the hash (or hashes, if the same
+                                                          *  element was added more than once) of each stored element.
+                                                          *  It holds one entry per copy, in either mode. */
+  bool multisetQ; /** True iff the native multiset mode is used (see setMultiset). */
+  map< ZZ, unordered_multimap< const DataObject*, shared_ptr<DataObject> > > CPI_copies; /** In the multiset mode,
+                                     *  the copies stored with each hash of CPI_hash.  The element kept in CPI_hash is
+                                     *  one of them, and stands for all of them. */
+  ElementHash elementHash; /** Reduces elements to bitNum bits when hashQ is true (see setHashType). */
+  double interpTime{}; /** Seconds spent interpolating in set_reconcile (see getInterpTime). */
+  double rootTime{}; /** Seconds spent finding roots in set_reconcile (see getRootTime). */
 
   // helper functions
 
   /**
    * Initialize <num> sample points and some default values for CPISync
    * @param num The number of sample points to initialize.
-   * @modifies Initializes the sampleLoc and CPI_meta arrays with <num> initial values.
+   * @modifies Attaches the shared sample locations and initializes the CPI_evals arrays with <num> initial values.
    */
   void initData(long num);
 
+  /**
+   * Brings CPI_evals up to date with CPI_evalsWord when the word-sized field is in use (otherwise does nothing).
+   * Must be called before CPI_evals is read.
+   */
+  void refreshEvals();
+
   /**
    * Interpolates a rational function with a given set of evaluations at the sample locations.
    * The numerator of the rational function is placed in P_vec and the denominator in Q_vec.
@@ -187,6 +353,8 @@ protected:
    *    coefficient of x, ... Q_vec[i] the coefficient of x^i
    * @return true iff the rational function interpolation appears to have completed properly, meaning that some
    *    function was interpolated that meets the evaluations at the sample locations given by sampleLoc
+   * @note With the Fast engine, the interpolation of earlier calls within the same synchronization is reused, so that
+   *    only evaluations beyond those seen before are interpolated.
    */
   bool ratFuncInterp(const vec_ZZ_p& evals, long mA, long mB, vec_ZZ_p& P_vec, vec_ZZ_p& Q_vec);
 
@@ -221,7 +389,9 @@ protected:
   bool set_reconcile(long otherSetSize, const vec_ZZ_p& otherEvals, vec_ZZ_p &delta_self, vec_ZZ_p &delta_other);
 
   vec_ZZ_p CPI_evals; /** The ii-th entry of this vector is the evaluation of this data structure's characteristic
-                        * polynomial at the ii-th sample point. */
+                        * polynomial at the ii-th sample point.  If wordField is true, CPI_evalsWord is authoritative
+                        * and this vector is only brought up to date by refreshEvals. */
+  vec_zz_p CPI_evalsWord; /** CPI_evals over the word-sized field; only populated if wordField is true. */
   ZZ DATA_MAX; /** Set elements must be within the range 0..data_max-1.  Sample locations are taken between data_max and ZZ_p::modulus() */
 
     /**
@@ -277,6 +447,74 @@ private:
    */
   ZZ_p _makeData(const ZZ_p& num) const;
 
+  /**
+   * Computes a CPISync hash for datum that is not yet in use, and records it in CPI_hash and CPI_revHash.  In the
+   * multiset mode, the hash of datum is used even if it is in use, and its number of copies is incremented.
+   * @param hashNum Set to the hash used for datum.
+   * @return true iff the datum could be hashed, which fails if the hash space is full or, without hashes, if
+   *    an identical element is already stored.
+   */
+  bool _insertHash(const shared_ptr<DataObject>& datum, ZZ& hashNum);
+
+  /**
+   * @return The number of elements stored, counting every copy.
+   */
+  long _setSize() const { return (long) CPI_revHash.size(); }
+
+  /**
+   * @return The number of copies stored with a hash of CPI_hash (always 1 outside the multiset mode).
+   */
+  long _multiplicity(const ZZ& hashNum) const { return multisetQ ? (long) CPI_copies.at(hashNum).size() : 1; }
+
+  /**
+   * Removes every hash of datum from CPI_hash and CPI_revHash.  In the multiset mode, a hash is only removed from
+   * CPI_hash with the last of its copies; until then, CPI_hash is kept pointing at a copy that remains.
+   * @param hashNums The removed hashes are appended here.
+   */
+  void _eraseHashes(const shared_ptr<DataObject>& datum, vector<ZZ>& hashNums);
+
+  /**
+   * Multiplies (or divides) every characteristic polynomial evaluation by the factor (sampleLoc[ii] - root),
+   * i.e. adds (or removes) root from the set represented by the evaluations.
+   * @param root The hash being added or removed.
+   * @param add If true, the factor is multiplied in; otherwise it is divided out.
+   */
+  void _updateEvals(const ZZ& root, bool add);
+
+  /**
+   * set_reconcile followed by a check of the result against the redundant evaluations beyond the first currDiff.
+   * @return true iff both succeeded.
+   */
+  bool _checkedReconcile(long otherSetSize, const vec_ZZ_p& otherEvals, vec_ZZ_p& delta_self, vec_ZZ_p& delta_other);
+
+  /**
+   * Runs body(begin, end) over ranges covering 0 ... num-1, split across the threads of threadPool, if any.  Each
+   * range runs with the field moduli (ZZ_p, and zz_p if wordField) that are current in the calling thread.
+   * @param grain The minimum length of a range worth handing to another thread.
+   */
+  void _parallelFor(long num, const function<void(long, long)>& body, long grain);
+
+  /**
+   * The reconciliation of set_reconcile when both sets have something, over field F: interpolates the rational
+   * function whose first metalength evaluations are otherEvals / evals, and finds the roots of its numerator and
+   * denominator.
+   * @param sampleLoc, state The sample locations and interpolation state over field F.
+   * @return true iff the rational function was interpolated and its roots were all found.
+   * @require The modulus of field F must be installed.
+   */
+  template <class F>
+  bool _reconcileField(long otherSetSize, const vec_ZZ_p& otherEvals, long metalength, const typename F::Vec& evals,
+                       const typename F::Vec& sampleLoc, CPIInterpState<F>& state,
+                       typename F::Vec& numerator, typename F::Vec& denominator);
+
+  /**
+   * Multiplies the factors (sampleLoc[ii] - root), for all the given roots, into evals - or divides them out of
+   * evals if divide is set - splitting the roots across threads.
+   * @see cpiMulRoots, cpiDivRoots
+   */
+  template <class F>
+  void _mulRoots(typename F::Vec& evals, const CPITree<F>& sampleTree, const typename F::Vec& roots, bool divide);
+
   /**
    * Sends one set element, properly unhashed, to the other side
    * @param element The set element to send.  The element is stored internally as an integer;
@@ -62,9 +62,9 @@ public:
      *                      2.  add - a pointer to the add method of my GenSync object
      *                      3.  del - a pointer to the dell method of my GenSync object
      *                      4.  pGenSync - a pointer to this GenSync object
-     * @param data       The initial data with which to populate the data structure.  The data is added element by element
-     *                      so that synchronization method metadata can be properly maintained.  Initilizes to the empty list
-     *                      if not specified.
+     * @param data       The initial data with which to populate the data structure.  The data is added as one batch
+     *                      (see addElems) so that synchronization method metadata can be properly maintained.  Initilizes
+     *                      to the empty list if not specified.
      * 
      */
     GenSync(
@@ -89,7 +89,9 @@ public:
      *                      is significant.
      * @param fileName   The name of a file from which to read (line by line) initial elements of
      *                   this data structure.  As elements are added to this data structure, they
-     *                   are also stored in the file.
+     *                   are also stored in the file.  If saveSnapshot was called for this file and the file
+     *                   has not changed since, CPISync methods are restored from their snapshots rather than
+     *                   by re-adding every element.
      */
     GenSync(const vector<shared_ptr<Communicant>> &cVec, const vector<shared_ptr<SyncMethod>> &mVec, const string& fileName);
 
@@ -102,6 +104,14 @@ public:
      */
     void addElem(shared_ptr<DataObject> newDatum);
 
+    /**
+     * Adds a batch of new data into the existing GenSync data structure.  Equivalent to calling addElem on each datum,
+     * but lets each sync method amortize the work over the whole batch (see SyncMethod::addElems).
+     * @param newData The data to be added
+     * %M:  If a file is associated with this object, then updates are stored in that file.
+     */
+    void addElems(const list<shared_ptr<DataObject>>& newData);
+
     /**
      * Adds a new datum into the existing GenSync data structure
      * @param newDatum The datum to be added ... must be of a type compatible with
@@ -125,6 +135,15 @@ public:
      */
     bool delElem(shared_ptr<DataObject> delPtr);
 
+    /**
+     * Deletes a batch of elements from the GenSync data structure and internal syncMethods, letting each
+     * sync method amortize the work over the whole batch (see SyncMethod::delElems).  Nothing is deleted unless
+     * every element is present.
+     * @param delData The data to delete
+     * @return True if the deletes appear to have completed successfully, false otherwise
+     */
+    bool delElems(const list<shared_ptr<DataObject>>& delData);
+
     /**
      * Calls delElem on every element in the myData list
      * @return True if data appears to have been successfully cleared, false otherwise
@@ -178,6 +197,15 @@ public:
      *  The first agent gets index 0.
      */
 
+    /**
+     * Persists the data of a file-backed GenSync (one constructed from a file name), together with a snapshot of each
+     * CPISync-based method's sketch, so that a later GenSync constructed from the same file restarts without
+     * rebuilding those sketches.  The data file is first rewritten to hold exactly the current data (deletions are
+     * otherwise not reflected in it), and the snapshots are tied to a checksum of its new contents.
+     * @return true iff the data file and all snapshots were written.
+     */
+    bool saveSnapshot();
+
     /**
      * Registers another synchronization agent.
      * @param newAgent  The synchronization agent to add
@@ -276,6 +304,14 @@ public:
      */
     string printStats(int syncIndex) const;
 
+    /**
+     * @param syncIndex The index of the Sync to query (in the order that they were added)
+     * @return The stats of printStats as a JSON object: "protocol", "xmitBytes", "recvBytes", "commTime", "idleTime"
+     * and "compTime", and, for InteractiveCPISync, "roundTrips" and "depths", an array with the stats of each depth of
+     * its tree ("depth", "visited", "failed", "xmitBytes", "recvBytes", "interpTime" and "rootTime").
+     */
+    string getStatsJSON(int syncIndex) const;
+
     /**
      * @return the port on which the server is listening for communicant commIndex.
      * If no server is listening for this communicant, the port returned is -1
@@ -359,6 +395,16 @@ private:
 
     /** The file to which to output any additions to the data structure. */
     shared_ptr<ofstream> outFile;
+
+    /** The name of the data file backing this object, or empty if there is none. */
+    string dataFileName;
+
+    /**
+     * @return The name of the snapshot file of the syncIndex-th sync method for a given data file.
+     */
+    static string _snapshotName(const string& fileName, size_t syncIndex) {
+        return fileName + ".snapshot" + toStr(syncIndex);
+    }
 };
 
 
@@ -380,7 +426,15 @@ public:
     bits(DFT_BITS),
     numParts(DFT_PARTS),
     hashes(HASHES),
-    numExpElem(DFT_EXPELEMS){
+    numExpElem(DFT_EXPELEMS),
+    interpType(DFT_INTERP),
+    rootType(DFT_ROOT),
+    numThreads(DFT_THREADS),
+    compactTree(DFT_COMPACT_TREE),
+    batchedLevels(DFT_BATCHED_LEVELS),
+    adaptiveFanout(DFT_ADAPTIVE_FANOUT),
+    multiset(DFT_MULTISET),
+    hashType(DFT_HASH_TYPE){
         myComm = nullptr;
         myMeth = nullptr;
     }
@@ -520,6 +574,78 @@ public:
         return *this;
     }
 
+    /**
+     * Sets the rational function interpolation engine for the CPISync family of protocols
+     * (CPISync, ProbCPISync, OneWayCPISync and InteractiveCPISync); it is ignored by other protocols.
+     */
+    Builder& setInterpType(INTERP_TYPE theInterpType) {
+        this->interpType = theInterpType;
+        return *this;
+    }
+
+    /**
+     * Sets the root finding approach for the CPISync family of protocols; it is ignored by other protocols.
+     */
+    Builder& setRootType(ROOT_TYPE theRootType) {
+        this->rootType = theRootType;
+        return *this;
+    }
+
+    /**
+     * Sets the number of threads across which the CPISync family of protocols splits its work over sample locations,
+     * and across which IBLTSync (one- and two-way) and IBLTSync_Multiset build their IBLTs from bulk additions
+     * (0 means one per hardware thread); it is ignored by other protocols.  Results do not depend on this setting.
+     */
+    Builder& setThreads(unsigned theNumThreads) {
+        this->numThreads = theNumThreads;
+        return *this;
+    }
+
+    /**
+     * Selects the compact storage mode of InteractiveCPISync's tree (see InterCPISync::setCompactTree); it is ignored
+     * by other protocols.
+     */
+    Builder& setCompactTree(bool theCompactTree) {
+        this->compactTree = theCompactTree;
+        return *this;
+    }
+
+    /**
+     * Selects the level-batched protocol of InteractiveCPISync (see InterCPISync::setBatchedLevels); it is ignored by
+     * other protocols.
+     */
+    Builder& setBatchedLevels(bool theBatchedLevels) {
+        this->batchedLevels = theBatchedLevels;
+        return *this;
+    }
+
+    /**
+     * Selects the adaptive fan-out of InteractiveCPISync (see InterCPISync::setAdaptiveFanout); it is ignored by other
+     * protocols.
+     */
+    Builder& setAdaptiveFanout(bool theAdaptiveFanout) {
+        this->adaptiveFanout = theAdaptiveFanout;
+        return *this;
+    }
+
+    /**
+     * Selects the native multiset mode of CPISync, ProbCPISync and OneWayCPISync (see CPISync::setMultiset); it is
+     * ignored by other protocols.
+     */
+    Builder& setMultiset(bool theMultiset) {
+        this->multiset = theMultiset;
+        return *this;
+    }
+
+    /**
+     * Sets the hash by which the CPISync family of protocols reduces elements when hashes are used (see
+     * CPISync::setHashType), with its default key; it is ignored by other protocols.
+     */
+    Builder& setHashType(HASH_TYPE theHashType) {
+        this->hashType = theHashType;
+        return *this;
+    }
+
 
     /**
      * Destructor - clear up any possibly allocated internal variables
@@ -550,6 +676,14 @@ private:
     Nullable<size_t> bucketSize;
     Nullable<size_t> filterSize;
     Nullable<size_t> maxKicks;
+    INTERP_TYPE interpType; /** the rational function interpolation engine for CPISync-based protocols */
+    ROOT_TYPE rootType; /** the root finding approach for CPISync-based protocols */
+    unsigned numThreads; /** the number of threads for CPISync-based protocols */
+    bool compactTree; /** whether InteractiveCPISync stores its tree in the compact mode */
+    bool batchedLevels; /** whether InteractiveCPISync uses the level-batched protocol */
+    bool adaptiveFanout; /** whether InteractiveCPISync adapts the fan-out of each failed node */
+    bool multiset; /** whether the CPISync protocols store copies of an element natively, as a multiplicity */
+    HASH_TYPE hashType; /** the element hash for CPISync-based protocols */
 
 
     // ... bookkeeping variables
@@ -566,6 +700,14 @@ private:
     static const long DFT_BITS = 32;
     static const int DFT_PARTS = 2;
     static const size_t DFT_EXPELEMS = 50;
+    static const INTERP_TYPE DFT_INTERP = INTERP_TYPE::Gauss;
+    static const ROOT_TYPE DFT_ROOT = ROOT_TYPE::Factor;
+    static const unsigned DFT_THREADS = 1;
+    static const bool DFT_COMPACT_TREE = false;
+    static const bool DFT_BATCHED_LEVELS = false;
+    static const bool DFT_ADAPTIVE_FANOUT = false;
+    static const bool DFT_MULTISET = false;
+    static const HASH_TYPE DFT_HASH_TYPE = HASH_TYPE::Modulo;
     // ... initialized in .cpp file due to C++ quirks
     static const string DFT_HOST;
     static const string DFT_IO;
@@ -9,11 +9,14 @@
 #define CPISYNCLIB_IBLT_H
 
 #include <vector>
+#include <cstdint>
 #include <utility>
 #include <string>
 #include <NTL/ZZ.h>
 #include <sstream>
 #include <CPISync/Aux/Auxiliary.h>
+#include <CPISync/Aux/ConstantsAndTypes.h>
+#include <CPISync/Aux/ThreadPool.h>
 #include <CPISync/Data/DataObject.h>
 
 using std::vector;
@@ -32,6 +35,15 @@ const long N_HASHCHECK = 11;
 // Shorthand for the hash type
 typedef unsigned long int hash_t;
 
+// The version of the hash family with which keys are placed into cells and checked (see IBLT::_hashK).
+// IBLTs built with different versions cannot be subtracted, so establishIBLTSend/Recv exchange it.
+//  1 - std::hash of the decimal string of the key, applied recursively k times
+//  2 - seeded 64-bit hash of the raw bytes of the key, one seed per hash
+const byte IBLT_HASH_VERSION = 2;
+
+// The base seed of the hash family; the kk-th hash of a key is seeded with IBLT_HASH_SEED + kk
+const uint64_t IBLT_HASH_SEED = 0x2d358dccaa6c78a5ULL;
+
 /*
  * IBLT (Invertible Bloom Lookup Table) is a data-structure designed to add
  * probabilistic invertibility to the standard Bloom Filter data-structure.
@@ -45,6 +57,9 @@ public:
     // Communicant needs to access the internal representation of an IBLT to send and receive it
     friend class Communicant;
 
+    // IBLTFixed shares the hash family, and converts to and from the internal representation
+    friend class IBLTFixed;
+
     /**
      * Constructs an IBLT object with size relative to expectedNumEntries.
      * @param expectedNumEntries The expected amount of entries to be placed into the IBLT
@@ -71,12 +86,22 @@ public:
      * @param value The value to be removed
      */
     void erase(ZZ key, ZZ value);
+
+    /**
+     * Inserts many key-value pairs, with the same result as inserting them one at a time.
+     * With a pool, each thread inserts a range of the pairs into a private IBLT with the same cells as this one, and
+     * the private IBLTs are then added into this one (see operator+=), each thread adding a range of cells.
+     * @param pairs The key-value pairs to be added
+     * @param pool The threads to use, or null for none; ignored unless NTL was built with NTL_THREADS
+     * @require The keys must be distinct in the IBLT
+     */
+    void insert(const vector<pair<ZZ, ZZ>> &pairs, ThreadPool *pool = nullptr);
     
     /**
      * Produces the value s.t. (key, value) is in the IBLT.
      * This operation doesn't always succeed.
-     * This operation is destructive, as entries must be "peeled" away in order to find an element, i.e.
-     * entries with only one key-value pair are subtracted from the IBLT until (key, value) is found.
+     * Entries may have to be "peeled" away in order to find an element, i.e. entries with only one key-value pair are
+     * subtracted from the IBLT until (key, value) is found; they are put back before returning, so the IBLT is unchanged.
      * @param key The key corresponding to the value returned by this function
      * @param result The resulting value corresponding with the key, if found.
      * If not found, result will be set to 0. result is unchanged iff the operation returns false.
@@ -89,6 +114,8 @@ public:
      * With a low, constant probability, only partial lists will be produced
      * Listing is destructive, as the same peeling technique used in the get method is used.
      * Will remove all key-value pairs from the IBLT that are listed.
+     * Peeling starts from the pure entries and then only visits the entries changed by each removal, so it takes
+     * time linear in the number of entries plus the number of pairs listed.
      * @param positive All the elements that could be inserted.
      * @param negative All the elements that were removed without being inserted first.
      * @return true iff the operation has successfully recovered the entire list
@@ -130,6 +157,13 @@ public:
     IBLT operator-(const IBLT& other) const;
     IBLT& operator-=(const IBLT& other);
 
+    /**
+     * Adds two IBLTs: the result is the IBLT into which the pairs of both were inserted.
+     * @param other The IBLT that will be added to this IBLT
+     * @require IBLT must have the same number of entries and the values must be of the same size
+     */
+    IBLT& operator+=(const IBLT& other);
+
     /**
      * @return the number of cells in the IBLT. Not necessarily equal to the expected number of entries
      */
@@ -148,12 +182,18 @@ protected:
     // default constructor - no internal parameters are initialized
     IBLT();
 
-    // Helper function for insert and erase
-    void _insert(long plusOrMinus, ZZ key, ZZ value);
+    // Helper function for insert and erase; if cells is not null, it receives the N_HASH cells changed
+    void _insert(long plusOrMinus, ZZ key, ZZ value, size_t *cells = nullptr);
+
+    // Helper function for operator+= (plusOrMinus = 1) and operator-= (-1), over the cells begin ... end-1 only
+    void _combine(long plusOrMinus, const IBLT& other, size_t begin, size_t end);
 
-    // Returns the kk-th unique hash of the zz that produced initial.
+    // Returns the kk-th hash of item, computed over its raw bytes (and sign) with a seed of its own for each kk.
     static hash_t _hashK(const ZZ &item, long kk);
+    // Returns the kk-th hash of the hash_t initial.
     static hash_t _hash(const hash_t& initial, long kk);
+    // Returns the kk-th hash of the non-negative integer with the len little-endian bytes at bytes (no trailing zero).
+    static hash_t _hashBytes(const unsigned char *bytes, size_t len, long kk);
     static hash_t _setHash(multiset<shared_ptr<DataObject>> &tarSet);
 
     /* Insert an IBLT together with a value into a bigger IBLT
@@ -191,6 +231,17 @@ protected:
         bool empty() const;
     };
 
+    /**
+     * Peels the IBLT: removes the pair of a pure entry, for as long as there is one, following a worklist of the
+     * entries that were pure to start with or became pure with a removal.
+     * @param positive, negative Receive the pairs removed, as in listEntries.
+     * @param found If not null, peeling stops at the first pure entry with this key, which is not removed.
+     * @param undo If not null, receives each entry changed, as it was before the change, in the order of the changes.
+     * @return The index of the entry at which peeling stopped for found, or -1 if none.
+     */
+    long _peel(vector<pair<ZZ, ZZ>> &positive, vector<pair<ZZ, ZZ>> &negative, const ZZ *found,
+               vector<pair<size_t, HashTableEntry>> *undo);
+
     // vector of all entries
     vector<HashTableEntry> hashTable;
 
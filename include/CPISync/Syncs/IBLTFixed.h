@@ -0,0 +1,123 @@
+/* This code is part of the CPISync project developed at Boston University.  Please see the README for use and references. */
+
+/*
+ * IBLTFixed is an IBLT (see IBLT.h) whose keys and values are non-negative integers of at most eltSize bytes.
+ *
+ * Its cells are kept as a structure of arrays - counts, hash-checks, key sums and value sums, each in one contiguous
+ * vector, with the sums as little-endian blocks of eltSize bytes - so that inserting, subtracting and peeling never
+ * allocate, and XOR whole blocks of plain memory.  Keys are hashed exactly as by IBLT, so an IBLTFixed has the same
+ * cells as an IBLT of the same size with the same content, and the two convert to one another.
+ */
+
+#ifndef CPISYNCLIB_IBLTFIXED_H
+#define CPISYNCLIB_IBLTFIXED_H
+
+#include <CPISync/Syncs/IBLT.h>
+
+class IBLTFixed {
+public:
+    // Communicant needs to access the internal representation of an IBLTFixed to send it
+    friend class Communicant;
+
+    /**
+     * Constructs an IBLTFixed with as many cells as an IBLT constructed with the same parameters.
+     * @param expectedNumEntries The expected amount of entries to be placed into the IBLT
+     * @param _eltSize The size of the keys and values being added, in bytes
+     */
+    IBLTFixed(size_t expectedNumEntries, size_t _eltSize);
+
+    // default destructor
+    ~IBLTFixed();
+
+    /**
+     * Inserts a key-value pair to the IBLT.
+     * @require fits(key) and fits(value), and the key must be distinct in the IBLT
+     */
+    void insert(const ZZ &key, const ZZ &value);
+
+    /**
+     * Erases a key-value pair from the IBLT.
+     * @require fits(key) and fits(value)
+     */
+    void erase(const ZZ &key, const ZZ &value);
+
+    /**
+     * Inserts many key-value pairs, as IBLT::insert(pairs, pool) does.
+     * @require fits(key) and fits(value) for each pair, and the keys must be distinct in the IBLT
+     */
+    void insert(const vector<pair<ZZ, ZZ>> &pairs, ThreadPool *pool = nullptr);
+
+    /**
+     * Produces a list of all the key-value pairs in the IBLT, as IBLT::listEntries does.
+     * Listing is destructive: the pairs listed are removed from the IBLT.
+     * @param positive All the elements that could be inserted.
+     * @param negative All the elements that were removed without being inserted first.
+     * @return true iff the operation has successfully recovered the entire list
+     */
+    bool listEntries(vector<pair<ZZ, ZZ>>& positive, vector<pair<ZZ, ZZ>>& negative);
+
+    /**
+     * Subtracts two IBLTs, as IBLT::operator- and IBLT::operator-= do.
+     * @require IBLTs must have the same number of cells and the same eltSize
+     */
+    IBLTFixed operator-(const IBLTFixed& other) const;
+    IBLTFixed& operator-=(const IBLTFixed& other);
+
+    /**
+     * Adds two IBLTs, as IBLT::operator+= does.
+     * @require IBLTs must have the same number of cells and the same eltSize
+     */
+    IBLTFixed& operator+=(const IBLTFixed& other);
+
+    /**
+     * @return true iff item is non-negative and has at most eltSize bytes, i.e. it can be inserted
+     */
+    bool fits(const ZZ &item) const;
+
+    /**
+     * @return An IBLT with the same cells as this one.
+     */
+    IBLT toIBLT() const;
+
+    /**
+     * Replaces the content of this IBLT with the cells of iblt, taking on its number of cells.
+     * @return false (leaving this IBLT unchanged) iff some key sum or value sum of iblt does not fit
+     */
+    bool assign(const IBLT &iblt);
+
+    /**
+     * @return the number of cells in the IBLT. Not necessarily equal to the expected number of entries
+     */
+    size_t size() const;
+
+    /**
+     * @return the size of the keys and values stored in the IBLT, in bytes.
+     */
+    size_t eltSize() const;
+
+private:
+    // Helper function for insert and erase, over keys and values of eltSize bytes; if cells is not null, it
+    // receives the N_HASH cells changed
+    void _insert(long plusOrMinus, const unsigned char *key, const unsigned char *value, size_t *cells = nullptr);
+
+    // Helper function for operator+= (plusOrMinus = 1) and operator-= (-1), over the cells begin ... end-1 only
+    void _combine(long plusOrMinus, const IBLTFixed& other, size_t begin, size_t end);
+
+    // Writes item into the eltSize bytes at out, quitting if it does not fit
+    void _toBytes(const ZZ &item, unsigned char *out) const;
+
+    // Returns whether the cell contains just one insertion or deletion
+    bool _isPure(size_t cell) const;
+
+    // Returns whether the cell is empty
+    bool _empty(size_t cell) const;
+
+    size_t width; /** The size of keys and values, in bytes. */
+    vector<long> counts; /** The net insertions and deletions that mapped to each cell. */
+    vector<hash_t> keyChecks; /** The xor-sum of the hash-checks of the keys mapped to each cell. */
+    vector<unsigned char> keySums; /** The xor-sum of the keys mapped to each cell, width bytes per cell. */
+    vector<unsigned char> valueSums; /** The xor-sum of the values mapped to each cell, width bytes per cell. */
+    vector<unsigned char> scratch; /** Room for a key and a value, width bytes each, on their way in or out. */
+};
+
+#endif //CPISYNCLIB_IBLTFIXED_H
@@ -43,6 +43,14 @@ public:
      */
     void erase(ZZ key, ZZ value);
 
+    /**
+     * Inserts many key-value pairs, as IBLT::insert(pairs, pool) does; the private IBLTs are added in as the cells of
+     * an IBLTMultiset add up, i.e. with sums rather than xor-sums.
+     * @param pairs The key-value pairs to be added
+     * @param pool The threads to use, or null for none
+     */
+    void insert(const vector<pair<ZZ, ZZ>> &pairs, ThreadPool *pool = nullptr);
+
     /**
      * Produces the value s.t. (key, value) is in the IBLT.
      * This operation doesn't always succeed.
@@ -81,6 +89,13 @@ public:
     IBLTMultiset operator-(const IBLTMultiset& other) const;
     IBLTMultiset& operator-=(const IBLTMultiset& other);
 
+    /**
+     * Adds two IBLTs: the result is the IBLT into which the pairs of both were inserted.
+     * @param other The IBLT that will be added to this IBLT
+     * @require IBLT must have the same number of entries and the values must be of the same size
+     */
+    IBLTMultiset& operator+=(const IBLTMultiset& other);
+
     /**
      * @return the number of cells in the IBLT. Not necessarily equal to the expected number of entries
      */
@@ -102,6 +117,9 @@ private:
      */
     void _insertModular(long plusOrMinus, ZZ key, ZZ value);
 
+    // Helper function for operator+= (plusOrMinus = 1) and operator-= (-1), over the cells begin ... end-1 only
+    void _combine(long plusOrMinus, const IBLTMultiset& other, size_t begin, size_t end);
+
     class HashTableEntry
     {
     public:
@@ -16,14 +16,15 @@
 
 #include <CPISync/Aux/SyncMethod.h>
 #include <CPISync/Aux/Auxiliary.h>
-#include <CPISync/Syncs/IBLT.h>
+#include <CPISync/Syncs/IBLTFixed.h>
 
 class IBLTSync : public SyncMethod {
 public:
     /*
      * Constructor.
      * @param expected The expected number of elements being stored
-     * @param eltSize The size of elements being stored
+     * @param eltSize The size of elements being stored, in bytes; an element is only added if it fits (see
+     *    IBLTFixed::fits)
      */
     IBLTSync(size_t expected, size_t eltSize);
     ~IBLTSync() override;
@@ -34,16 +35,30 @@ public:
     bool addElem(shared_ptr<DataObject> datum) override;
     bool delElem(shared_ptr<DataObject> datum) override;
 
+    /**
+     * Adds a batch of elements, inserting them into the IBLT in parallel if a thread pool is set (see
+     * IBLTFixed::insert).  Nothing is added unless every element fits.
+     */
+    bool addElems(const list<shared_ptr<DataObject>>& data) override;
+
+    /**
+     * Sets the threads across which addElems builds the IBLT (or null, for none).
+     */
+    void setThreadPool(shared_ptr<ThreadPool> pool) { threadPool = std::move(pool); }
+
     string getName() override;
 protected:
     // one way flag
     bool oneWay;
 private:
-    // IBLT instance variable for storing data
-    IBLT myIBLT;
+    // IBLT instance variable for storing data, whose keys and values are the elements
+    IBLTFixed myIBLT;
 
     // Instance variable to sore the expected number of elements
     size_t expNumElems;
+
+    // The threads across which addElems builds the IBLT (or null, for none)
+    shared_ptr<ThreadPool> threadPool;
 };
 
 
@@ -19,6 +19,16 @@ public:
     bool addElem(shared_ptr<DataObject> datum) override;
     bool delElem(shared_ptr<DataObject> datum) override;
 
+    /**
+     * Adds a batch of elements, inserting them into the IBLT in parallel if a thread pool is set (see IBLTMultiset::insert).
+     */
+    bool addElems(const list<shared_ptr<DataObject>>& data) override;
+
+    /**
+     * Sets the threads across which addElems builds the IBLT (or null, for none).
+     */
+    void setThreadPool(shared_ptr<ThreadPool> pool) { threadPool = std::move(pool); }
+
     string getName() override;
 
 private:
@@ -31,6 +41,9 @@ private:
 
     // Instance variable to sore the expected number of elements
     size_t expNumElems;
+
+    // The threads across which addElems builds the IBLT (or null, for none)
+    shared_ptr<ThreadPool> threadPool;
 };
 
 #endif //CPISYNC_IBLTSYNC_MULTISET_H
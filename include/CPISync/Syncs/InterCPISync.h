@@ -5,12 +5,16 @@
 #define INCRE_CPI_H
 
 #include <list>
+#include <map>
+#include <vector>
 #include <CPISync/Aux/Auxiliary.h>
 #include <CPISync/Communicants/Communicant.h>
 #include <CPISync/Data/DataObject.h>
 #include <CPISync/Syncs/CPISync_ExistingConnection.h>
 
 using std::list;
+using std::map;
+using std::vector;
 
 /**
  * Implements a data structure for interactively synchronizing sets of
@@ -31,7 +35,6 @@ using std::list;
 
 typedef paryTree<CPISync_ExistingConnection> pTree;
 
-//TODO: Fix stat reporting for InterCPI (Curerntly only reports stats for the last node rather than the entire tree)
 class InterCPISync : public SyncMethod {
 public:
 
@@ -105,11 +108,109 @@ public:
                 + "\n   * pFactor = " + toStr(pFactor) + "\n   * Evaluation Points = " + toStr(redundant_k) + '\n';
     }
 
+    /**
+     * Selects the rational function interpolation engine used by every CPISync node of the tree.
+     * @see CPISync::setInterpType
+     */
+    void setInterpType(INTERP_TYPE type) { interpType = type; }
+
+    /**
+     * Selects the root finding approach used by every CPISync node of the tree.
+     * @see CPISync::setRootType
+     */
+    void setRootType(ROOT_TYPE type) { rootType = type; }
+
+    /**
+     * Selects the hash by which elements are placed in the tree, and hashed by every CPISync node, when hashes are
+     * used.  Both parties must agree on the hash and its key.
+     * @see CPISync::setHashType
+     * @require No element has been added yet.
+     */
+    void setHashType(HASH_TYPE type, uint64_t key = ElementHash::DFT_KEY);
+
+    /**
+     * Shares a thread pool among every CPISync node of the tree.  With batched levels, the server also reconciles the
+     * nodes of a level concurrently on it; results do not depend on the number of threads.
+     * @see CPISync::setThreadPool
+     */
+    void setThreadPool(shared_ptr<ThreadPool> pool) { threadPool = std::move(pool); }
+
+    /**
+     * Selects how the tree of CPISync nodes is stored.  In either mode, every element is indexed by its position in
+     * the tree, and a node divided by a synchronization fills its children from their slices of the index.
+     * By default, a CPISync node is kept for the root of the tree, and the child nodes created by a synchronization
+     * that recurses are kept until it is done.
+     * In the compact mode, the root is kept likewise, but a node below it is only built, from its slice of the index,
+     * when a synchronization actually reaches it, and is released as soon as the synchronization moves past it.  This
+     * trades rebuilding each child at each synchronization for memory that does not grow with the depth the
+     * synchronization reaches.  The two parties need not agree on this.
+     * @param compact If true, use the compact mode.
+     */
+    void setCompactTree(bool compact);
+
+    /**
+     * Selects the level-batched protocol.
+     * By default, a synchronization that divides visits the tree depth first, and every node it reaches costs round
+     * trips of its own.  With batched levels, the tree is visited breadth first: the client sends the sketches of all
+     * the nodes of a level in one message, and the server answers with the status of each node, followed by the
+     * differences of the nodes that were settled, in one reply.  A synchronization then costs one round trip per
+     * level of the tree, rather than per node.  Both parties must agree on this.
+     *
+     * Batched synchronizations are also resumable.  Each one runs in a session, and both parties keep a checkpoint of
+     * the session at the start of each level: the nodes of the level, and the differences found above it.  If the
+     * synchronization fails (e.g. because the connection was lost), the next one between the same two objects resumes
+     * from the first level that both parties started, with the differences already found, as long as neither set has
+     * changed in between.  The checkpoints of up to 16 interrupted sessions are kept.
+     */
+    void setBatchedLevels(bool batched) { batchedLevels = batched; }
+
+    /**
+     * Selects the adaptive fan-out, which implies batched levels.
+     * By default, every failed node is divided into pFactor children, each presumed to differ in up to m_bar elements.
+     * With the adaptive fan-out, the client sends, along with the sketch of each node, counts of its elements over 16
+     * equal sub-ranges of the node.  For each failed node, the server estimates the number of differences from both
+     * sides' counts, and picks a fan-out (a power of two, up to 16) at which each child is expected to differ in at
+     * most m_bar/2 elements, together with a bound on the differences of each child.  Both are sent with the node's
+     * status, and each child then exchanges only as many evaluations as its bound calls for.  Both parties must agree
+     * on this.
+     */
+    void setAdaptiveFanout(bool adaptive) { adaptiveFanout = adaptive; }
+
+    /**
+     * @return The level of the tree from which the last synchronization resumed an interrupted session, or -1 if it
+     *    started from the root.
+     */
+    long resumedLevel() const { return resumeLevel; }
+
+    /**
+     * The statistics of one depth of the tree, over the last synchronization.
+     */
+    struct DepthStats {
+        long visited; /** The nodes at this depth reached by the synchronization. */
+        long failed; /** Those of them that failed to reconcile, and were divided. */
+        unsigned long xmitBytes, recvBytes; /** The bytes transmitted and received for them. */
+        double interpTime, rootTime; /** The time spent interpolating, and finding roots, in reconciling them; only the
+                                      *  reconciling side (the server) spends any. */
+    };
+
+    /**
+     * @return The statistics of each depth of the tree, from the root down, over the last synchronization.  Every byte
+     *    exchanged after the sync parameters is charged to one depth, so that the bytes of all depths add up to those
+     *    of mySyncStats.
+     */
+    const vector<DepthStats>& getDepthStats() const { return depthStats; }
+
+    /**
+     * @return The number of round trips of the last synchronization, after the exchange of sync parameters.
+     */
+    long getRoundTrips() const { return roundTrips; }
+
 protected:
 
-    pTree *treeNode; /** A tree of CPISync'ed data.  Each tree node is responsible for a specific range of the
-                        * space of set data.
-                        */
+    pTree tree; /** A tree of CPISync'ed data.  Each tree node is responsible for a specific range of the
+                 * space of set data.  Only the root (node 0) is kept between synchronizations; the nodes below it
+                 * are created by a synchronization that divides, and removed when it is done.
+                 */
     long bitNum; /** Number of bits used to represent an element of the set that is being synchronized. */
     long maxDiff; /** Maximum number of differences to synchronize (for regular CPIsync) */
     int probEps; /** Negative log of the upper bound on the probability of error for the synchronization. */
@@ -121,6 +222,17 @@ protected:
                        * the new element into the appropriate path of the hash tree. */
     bool useExisting; /** Use Exiting connection for Communication */
     bool hashes; /**Sets whether or not hashing should be used (Must be true for multisets)*/
+    INTERP_TYPE interpType; /** The rational function interpolation engine used by each CPISync node. */
+    ROOT_TYPE rootType; /** The root finding approach used by each CPISync node. */
+    ElementHash elementHash; /** Places elements in the tree when hashes is true (see setHashType). */
+    shared_ptr<ThreadPool> threadPool; /** The thread pool used by each CPISync node (or null, for none). */
+    bool compactTree; /** True iff the tree is stored in the compact mode (see setCompactTree). */
+    vector<pair<ZZ, shared_ptr<DataObject>>> hashIndex; /** Every element, with its _hash.  The first hashIndexSorted
+                                                          *  entries are sorted by hash, and the rest were appended
+                                                          *  since, in no order. */
+    size_t hashIndexSorted; /** The number of leading entries of hashIndex that are sorted. */
+    bool batchedLevels; /** True iff the level-batched protocol is used (see setBatchedLevels). */
+    bool adaptiveFanout; /** True iff the adaptive fan-out is used (see setAdaptiveFanout). */
     /**
      * Encode and transmit synchronization parameters (e.g. synchronization scheme, probability of error ...)
      * to another communicant for the purposes of ensuring that both are using the same scheme.
@@ -136,17 +248,93 @@ protected:
      * @throws SyncFailureException if the parameters don't match between the synchronizing parties.
      */
     void RecvSyncParam(const shared_ptr<Communicant>& commSync, bool oneWay = false) override;
-    void createChildren(pTree * treeNode, pTree * tempTree, const ZZ& begRange, const ZZ& endRange);
+
+    /**
+     * A node of the tree: the range of hashes whose elements it holds, and the range passed on to its children.  As
+     * in createChildren, these only differ below nodes whose range is smaller than pFactor.
+     */
+    struct NodeRange {
+        ZZ sliceBeg, sliceEnd; /** The node holds the elements whose hash is in sliceBeg ... sliceEnd-1. */
+        ZZ begRange, endRange; /** The range of the node, from which the ranges of its children are computed. */
+        long depth; /** The depth of the node in the tree (0 for the root). */
+    };
+
+    /**
+     * Adds the children of a node of tree, and populates each, in bulk, with its slice of hashIndex.
+     * @param node The index of the node in tree, which must not have children.
+     * @param range The node's range; no children are added if it is empty.
+     */
+    void createChildren(long node, const NodeRange &range);
 private:
     // METHODS
 
     /**
-     * Deletes all memory associate with the given tree.
-     * @param treeNode A pointer to the root of a tree.
+     * Applies this object's settings (interpolation engine, root finding, thread pool) to a CPISync node.
+     */
+    void _configureNode(CPISync_ExistingConnection &node) const;
+
+    /**
+     * Adds the root of tree, which must be empty, configured with this object's parameters.
+     */
+    void _addRoot();
+
+    /**
+     * @return A new, empty CPISync node configured with this object's parameters.
+     */
+    CPISync_ExistingConnection *_makeNode() const;
+
+    /**
+     * Sorts hashIndex by hash, if it is not already sorted, by merging the entries appended since the last sort.
+     */
+    void _sortIndex();
+
+    /**
+     * @return Every element whose hash is in begHash ... endHash-1, from hashIndex.
+     */
+    list<shared_ptr<DataObject>> _sliceElems(const ZZ &begHash, const ZZ &endHash);
+
+    /**
+     * Builds a CPISync node, not kept in tree, from a slice of hashIndex.
+     * @return A new node holding every element whose hash is in begHash ... endHash-1, or null if there are none.
+     */
+    CPISync_ExistingConnection *_materializeNode(const ZZ &begHash, const ZZ &endHash);
+
+    /**
+     * @return The node of range in the compact mode: the root kept in tree, or else a node built into built by
+     *    _materializeNode; null if it holds no elements.
+     */
+    CPISync_ExistingConnection *_compactNode(const NodeRange &range, unique_ptr<CPISync_ExistingConnection> &built);
+
+    /**
+     * Adds the time statistics of a node's synchronization to this object's.
+     */
+    void _addNodeStats(CPISync *node);
+
+    /**
+     * @return The statistics of the given depth of the tree, added (with those of any depth above it) if need be.
      */
-    void _deleteTree(pTree *treeNode);
+    DepthStats &_depthStats(long depth);
 
-    /* Computes a hash of the given datum of size bit_num, used internally within IntreCPI.
+    /**
+     * Counts a node reached by the synchronization, and adds its reconciliation times (which are then reset).
+     * @param node The node's CPISync, or null if the node was settled without one being reconciled.
+     * @param failed True iff the node failed to reconcile.
+     */
+    void _countNode(long depth, CPISync *node, bool failed);
+
+    /**
+     * Charges the bytes exchanged through commSync since the last charge (or the start of the synchronization) to the
+     * given depth.
+     */
+    void _chargeBytes(const shared_ptr<Communicant> &commSync, long depth);
+
+    /**
+     * Records the byte and round trip totals of the synchronization, as counted by commSync since its start.
+     */
+    void _recordTotals(const shared_ptr<Communicant> &commSync);
+
+    /* Computes a hash of the given datum of size bit_num, used internally within IntreCPI: elementHash with hashes,
+     * or the datum's encoding reduced modulo DATA_MAX without.
      * @param datum The datum to hash
      * @return A hash of the datum.
      * @note The hash must be between 0 and 2^(bit_num) inclusive.
@@ -159,65 +347,168 @@ private:
     /**
      * Recursive version of the public method of the same name.  Parameters are the same except those listed.
      * @see Sync_Client(shared_ptr<Communicant> commSync, list<shared_ptr<DataObject>> &selfMinusOther, list<shared_ptr<DataObject>> &otherMinusSelf)
-     * @param treeNode The current node in the tree to synchronize
+     * @param node The index of the current node in tree to synchronize, or pTree::NONE if it does not exist
+     * @param range The current node's range
      * @modifies selfMinusOther - Adds to items discovered to be in my set but not the others'
      * @modifies otherMinusself - Adds to items discovered to be in the others' set but not in mine
      * @return true iff all constituent sync's succeeded
      */
     bool _SyncClient(const shared_ptr<Communicant> &commSync, list<shared_ptr<DataObject>> &selfMinusOther,
-					 list<shared_ptr<DataObject>> &otherMinusSelf, pTree *&treeNode);
-
-    bool _SyncClient(const shared_ptr<Communicant> &commSync, list<shared_ptr<DataObject>> &selfMinusOther,
-					 list<shared_ptr<DataObject>> &otherMinusSelf, pTree *treeNode, const ZZ &begRange,const ZZ &endRange);
+					 list<shared_ptr<DataObject>> &otherMinusSelf, long node, const NodeRange &range);
     /**
      * Recursive version of the public method of the same name.  Parameters are the same except those listed.
      * @see Sync_Server(shared_ptr<Communicant> commSync, list<shared_ptr<DataObject>> &selfMinusOther, list<shared_ptr<DataObject>> &otherMinusSelf)
-     * @param treeNode The current node in the tree to synchronize
+     * @param node The index of the current node in tree to synchronize, or pTree::NONE if it does not exist
+     * @param range The current node's range
      * @modifies selfMinusOther - Adds to items discovered to be in my set but not the others'
      * @modifies otherMinusself - Adds to items discovered to be in the others' set but not in mine
      *     * @return true iff all constituent sync's succeeded
      */
     bool _SyncServer(const shared_ptr<Communicant> &commSync, list<shared_ptr<DataObject>> &selfMinusOther,
-					 list<shared_ptr<DataObject>> &otherMinusSelf, pTree *&treeNode);
+					 list<shared_ptr<DataObject>> &otherMinusSelf, long node, const NodeRange &range);
 
-    bool _SyncServer(const shared_ptr<Communicant> &commSync, list<shared_ptr<DataObject>> &selfMinusOther,
-					 list<shared_ptr<DataObject>> &otherMinusSelf, pTree *treeNode,
-					 const ZZ &begRange,
-					 const ZZ &endRange);
+    /**
+     * @return The pFactor children of node, holding the same elements as createChildren would give them.
+     */
+    vector<NodeRange> _childRanges(const NodeRange &node) const;
+
+    /**
+     * Compact-mode versions of the recursive _SyncClient and _SyncServer: a node below the root is built from
+     * hashIndex on entry, and released before recursing into its children.  The protocol is the same as in the
+     * default mode.
+     */
+    bool _SyncClientCompact(const shared_ptr<Communicant> &commSync, list<shared_ptr<DataObject>> &selfMinusOther,
+							list<shared_ptr<DataObject>> &otherMinusSelf, const NodeRange &range);
+
+    bool _SyncServerCompact(const shared_ptr<Communicant> &commSync, list<shared_ptr<DataObject>> &selfMinusOther,
+							list<shared_ptr<DataObject>> &otherMinusSelf, const NodeRange &range);
+
+    /**
+     * A node of one level of the tree, in the level-batched protocol.
+     */
+    struct LevelNode {
+        NodeRange range; /** The node's ranges. */
+        long index; /** The index of the node in tree (only the root's in the compact mode), or pTree::NONE if it is
+                      *  not in tree. */
+        unique_ptr<CPISync_ExistingConnection> owned; /** The node, if it is not in tree (below the root in the compact
+                                                        *  mode, from a resumed level down, or below the root with the
+                                                        *  adaptive fan-out); null if it is empty. */
+        long diff; /** The bound on the node's differences. */
+        vector<long> childDiffs; /** With the adaptive fan-out, for a failed node, the bound on the differences of
+                                   *  each of its children. */
+    };
+    typedef vector<LevelNode> Level;
+
+    /**
+     * The state of a session at the start of one level of the tree: the level, and the differences found above it.
+     */
+    struct LevelCheckpoint {
+        long number = -1; /** The depth of the level, or -1 if there is none. */
+        vector<NodeRange> ranges; /** The ranges of the nodes of the level. */
+        vector<long> diffs; /** The bound on the differences of each node of the level. */
+        list<shared_ptr<DataObject>> selfMinusOther, otherMinusSelf; /** The differences found above the level. */
+    };
 
-    
     /**
-     * Recursive helper function to addElem
-     * @param newDatum The datum to add
-     * @param treeNode The tree in which to add the element.  The method recursively
-     * adds the element to the appropriate children of the node until a node with < m_bar elements is found.
-     * @param parent The parent node of this node.
-     * @param begRange The beginning item of the current node's range
-     * @param endRange The end item of the current node's range
-     * @return true iff the addition is successful
+     * The checkpoint of a session.  The last two levels started are kept, since a party may have started one more
+     * level than the other when the connection was lost.
      */
-    bool _addElem(shared_ptr<DataObject>newDatum, pTree *&treeNode, pTree *parent, const ZZ &begRange, const ZZ &endRange);
+    struct Checkpoint {
+        unsigned long modifications; /** The number of additions and deletions of elements when the session began. */
+        long stamp; /** When the session began, relative to the other sessions. */
+        LevelCheckpoint latest, previous;
+    };
+
+    /**
+     * @return The CPISync node of a level node, or null if it holds no elements.
+     */
+    CPISync *_levelSync(const LevelNode &node);
+
+    /**
+     * @return The first level of the tree, holding only the root.
+     */
+    Level _rootLevel();
+
+    /**
+     * Starts the session of a batched synchronization: a new checkpoint if resumeLevel is -1, or else the first
+     * level of the tree, and the differences found above it, from the session's checkpoint.
+     * @modifies selfMinusOther, otherMinusSelf - Adds the differences found above the first level.
+     * @return The first level of the tree, at depth max(resumeLevel, 0).
+     */
+    Level _beginSession(list<shared_ptr<DataObject>> &selfMinusOther, list<shared_ptr<DataObject>> &otherMinusSelf);
+
+    /**
+     * Records the start of a level in the session's checkpoint.
+     * @param selfStart, otherStart The number of entries of selfMinusOther and otherMinusSelf before the synchronization.
+     */
+    void _checkpoint(long number, const Level &level, const list<shared_ptr<DataObject>> &selfMinusOther,
+                     const list<shared_ptr<DataObject>> &otherMinusSelf, size_t selfStart, size_t otherStart);
+
+    /**
+     * @return true iff the elements are those of the session of checkpoint when it began.
+     */
+    bool _unchanged(const Checkpoint &checkpoint) const;
+
+    /**
+     * @param status The status of each node of level, as sent by the server.
+     * @return The next level of the tree: the pFactor children of each node of level whose status is SYNC_FAIL_FLAG.
+     */
+    Level _nextLevel(Level &level, const string &status);
+
+    /**
+     * Runs body(index) for each index in 0 ... num-1, spread dynamically across the threads of threadPool, if any,
+     * each running with the calling thread's ZZ_p modulus.
+     */
+    void _forEachNode(long num, const function<void(long)> &body);
+
+    /**
+     * @return The number of elements of hashIndex in each of the equal sub-ranges of range used by the adaptive fan-out.
+     * @require hashIndex is sorted.
+     */
+    vector<long> _binCounts(const NodeRange &range) const;
+
+    /**
+     * Plans the children of a failed node with the adaptive fan-out, from both sides' _binCounts of the node.
+     * @return The bound on the differences of each child; their number is the node's fan-out (0 if the node's range
+     *    is too narrow to divide).
+     */
+    vector<long> _planChildren(const NodeRange &range, const vector<long> &selfBins, const vector<long> &otherBins) const;
+
+    /**
+     * @return range split into num children of (nearly) equal ranges, each holding exactly the elements in its range.
+     */
+    vector<NodeRange> _splitRange(const NodeRange &range, long num) const;
+
+    /**
+     * Level-batched versions of the recursive _SyncClient and _SyncServer, for either mode of storing the tree.
+     * @see setBatchedLevels
+     */
+    bool _SyncClientBatched(const shared_ptr<Communicant> &commSync, list<shared_ptr<DataObject>> &selfMinusOther,
+							list<shared_ptr<DataObject>> &otherMinusSelf);
+
+    bool _SyncServerBatched(const shared_ptr<Communicant> &commSync, list<shared_ptr<DataObject>> &selfMinusOther,
+							list<shared_ptr<DataObject>> &otherMinusSelf);
+
 
     /**
 	 * Recursive helper function to delElem
 	 * @param newDatum The datum to remove
-	 * @param treeNode The tree in which to search for the element.  The method recursively
+	 * @param node The index of the node of tree in which to search for the element.  The method recursively
 	 * deletes the element from the appropriate children of the node until a node with < m_bar elements is found.
 	 * @param begRange The beginning item of the current node's hash range
 	 * @param endRange The end item of the current node's hash range
 	 * @return true iff the deletion appears to be successful
 	 */
-	bool _delElem(shared_ptr<DataObject> newDatum, pTree * &treeNode, const ZZ &begRange, const ZZ &endRange);
-
-
-		/**
-		 * Helper for addElem that creates a new pTree node and populates it with the appropriate elements of
-		 * the parent in the supplied range.
-		 */
-    bool _createTreeNode(pTree *&treeNode, pTree *parent, const ZZ &begRange, const ZZ &endRange);
+	bool _delElem(shared_ptr<DataObject> newDatum, long node, const ZZ &begRange, const ZZ &endRange);
     // ... FIELDS
-    
-    
-   
+    map<long, Checkpoint> checkpoints; /** The checkpoint of each interrupted session, by session ID. */
+    long checkpointClock; /** The stamp of the next session to begin. */
+    unsigned long modifications; /** The number of additions and deletions of elements so far. */
+    long session; /** The ID of the current (or last) session. */
+    long clientSession; /** The ID of the last session started as a client, or 0 if it succeeded. */
+    long resumeLevel; /** The level from which the current (or last) synchronization resumed, or -1 if none. */
+    vector<DepthStats> depthStats; /** The statistics of each depth of the tree over the last synchronization. */
+    unsigned long chargedXmit, chargedRecv; /** The bytes already charged to depthStats in this synchronization. */
+    long roundTrips; /** The number of round trips of the last synchronization. */
 };
 #endif
@@ -0,0 +1,271 @@
+/* This code is part of the CPISync project developed at Boston University.  Please see the README for use and references. */
+
+#include <vector>
+#include <CPISync/Aux/CPIKernels.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define CPI_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+    typedef unsigned __int128 u128;
+
+    const uint64_t MAX_MOD_IFMA = 1ULL << 50; // 52-bit lanes, with room for the lazy Montgomery result (< 2p)
+    const uint64_t MAX_MOD_32 = 1ULL << 31; // 32-bit lanes; a b + m p must not overflow 64 bits
+
+    /**
+     * @return 1/a mod p, by the extended Euclidean algorithm.
+     */
+    uint64_t invMod(uint64_t a, uint64_t p) {
+        int64_t r0 = (int64_t) p, r1 = (int64_t) a, s0 = 0, s1 = 1;
+        while (r1 != 0) {
+            int64_t q = r0 / r1, tmp;
+            tmp = r0 - q * r1; r0 = r1; r1 = tmp;
+            tmp = s0 - q * s1; s0 = s1; s1 = tmp;
+        }
+        return (uint64_t) (s0 < 0 ? s0 + (int64_t) p : s0);
+    }
+
+#ifdef CPI_KERNELS_X86
+    // ... 4 lanes of 32-bit Montgomery multiplication (R = 2^32) on 64-bit lanes holding residues below 2^31
+    __attribute__((target("avx2")))
+    inline __m256i montMulAVX2(__m256i a, __m256i b, __m256i p, __m256i pNegInv) {
+        __m256i t = _mm256_mul_epu32(a, b);
+        __m256i m = _mm256_mul_epu32(t, pNegInv); // only the low 32 bits of m matter
+        __m256i u = _mm256_srli_epi64(_mm256_add_epi64(t, _mm256_mul_epu32(m, p)), 32); // u < 2p
+        return _mm256_blendv_epi8(_mm256_sub_epi64(u, p), u, _mm256_cmpgt_epi64(p, u));
+    }
+
+    // ... a - b mod p
+    __attribute__((target("avx2")))
+    inline __m256i subModAVX2(__m256i a, __m256i b, __m256i p) {
+        __m256i d = _mm256_sub_epi64(a, b);
+        return _mm256_add_epi64(d, _mm256_and_si256(p, _mm256_cmpgt_epi64(_mm256_setzero_si256(), d)));
+    }
+
+    __attribute__((target("avx2")))
+    long mulSubAVX2(long *vals, const long *factors, long sub, long n, uint64_t p, uint64_t pNegInv) {
+        const __m256i vp = _mm256_set1_epi64x((long long) p), vInv = _mm256_set1_epi64x((long long) pNegInv);
+        const __m256i vSub = _mm256_set1_epi64x(sub);
+        long ii = 0;
+        for (; ii + 4 <= n; ii += 4) {
+            __m256i v = _mm256_loadu_si256((const __m256i *) (vals + ii));
+            __m256i f = subModAVX2(_mm256_loadu_si256((const __m256i *) (factors + ii)), vSub, vp);
+            _mm256_storeu_si256((__m256i *) (vals + ii), montMulAVX2(v, f, vp, vInv));
+        }
+        return ii; // the caller finishes the tail
+    }
+
+    __attribute__((target("avx2")))
+    long prodSubAVX2(uint64_t lanes[4], long c, const long *roots, long n, uint64_t p, uint64_t pNegInv) {
+        const __m256i vp = _mm256_set1_epi64x((long long) p), vInv = _mm256_set1_epi64x((long long) pNegInv);
+        const __m256i vc = _mm256_set1_epi64x(c);
+        __m256i acc = _mm256_set1_epi64x(1);
+        long ii = 0;
+        for (; ii + 4 <= n; ii += 4)
+            acc = montMulAVX2(acc, subModAVX2(vc, _mm256_loadu_si256((const __m256i *) (roots + ii)), vp), vp, vInv);
+        _mm256_storeu_si256((__m256i *) lanes, acc);
+        return ii;
+    }
+
+    // ... 8 lanes of 32-bit Montgomery multiplication (R = 2^32), as above
+    __attribute__((target("avx512f")))
+    inline __m512i montMulAVX512F(__m512i a, __m512i b, __m512i p, __m512i pNegInv) {
+        __m512i t = _mm512_mul_epu32(a, b);
+        __m512i m = _mm512_mul_epu32(t, pNegInv);
+        __m512i u = _mm512_srli_epi64(_mm512_add_epi64(t, _mm512_mul_epu32(m, p)), 32);
+        return _mm512_mask_sub_epi64(u, _mm512_cmpge_epu64_mask(u, p), u, p);
+    }
+
+    // ... a - b mod p, for residues a, b < p
+    __attribute__((target("avx512f")))
+    inline __m512i subModAVX512(__m512i a, __m512i b, __m512i p) {
+        __m512i d = _mm512_sub_epi64(a, b);
+        return _mm512_mask_add_epi64(d, _mm512_cmplt_epu64_mask(a, b), d, p);
+    }
+
+    __attribute__((target("avx512f")))
+    long mulSubAVX512F(long *vals, const long *factors, long sub, long n, uint64_t p, uint64_t pNegInv) {
+        const __m512i vp = _mm512_set1_epi64((long long) p), vInv = _mm512_set1_epi64((long long) pNegInv);
+        const __m512i vSub = _mm512_set1_epi64(sub);
+        long ii = 0;
+        for (; ii + 8 <= n; ii += 8) {
+            __m512i v = _mm512_loadu_si512(vals + ii);
+            __m512i f = subModAVX512(_mm512_loadu_si512(factors + ii), vSub, vp);
+            _mm512_storeu_si512(vals + ii, montMulAVX512F(v, f, vp, vInv));
+        }
+        return ii;
+    }
+
+    __attribute__((target("avx512f")))
+    long prodSubAVX512F(uint64_t lanes[8], long c, const long *roots, long n, uint64_t p, uint64_t pNegInv) {
+        const __m512i vp = _mm512_set1_epi64((long long) p), vInv = _mm512_set1_epi64((long long) pNegInv);
+        const __m512i vc = _mm512_set1_epi64(c);
+        __m512i acc = _mm512_set1_epi64(1);
+        long ii = 0;
+        for (; ii + 8 <= n; ii += 8)
+            acc = montMulAVX512F(acc, subModAVX512(vc, _mm512_loadu_si512(roots + ii), vp), vp, vInv);
+        _mm512_storeu_si512(lanes, acc);
+        return ii;
+    }
+
+    // ... 8 lanes of 52-bit Montgomery multiplication (R = 2^52) on residues below 2^50
+    __attribute__((target("avx512f,avx512ifma")))
+    inline __m512i montMulIFMA(__m512i a, __m512i b, __m512i p, __m512i pNegInv) {
+        const __m512i zero = _mm512_setzero_si512();
+        __m512i lo = _mm512_madd52lo_epu64(zero, a, b);
+        __m512i hi = _mm512_madd52hi_epu64(zero, a, b);
+        __m512i m = _mm512_madd52lo_epu64(zero, lo, pNegInv);
+        // (a b + m p) / 2^52 = hi + (m p >> 52) + carry, since lo + (m p mod 2^52) is 2^52 unless lo = 0
+        __m512i u = _mm512_madd52hi_epu64(hi, m, p);
+        u = _mm512_mask_add_epi64(u, _mm512_test_epi64_mask(lo, lo), u, _mm512_set1_epi64(1)); // u < 2p
+        return _mm512_mask_sub_epi64(u, _mm512_cmpge_epu64_mask(u, p), u, p);
+    }
+
+    __attribute__((target("avx512f,avx512ifma")))
+    long mulSubIFMA(long *vals, const long *factors, long sub, long n, uint64_t p, uint64_t pNegInv) {
+        const __m512i vp = _mm512_set1_epi64((long long) p), vInv = _mm512_set1_epi64((long long) pNegInv);
+        const __m512i vSub = _mm512_set1_epi64(sub);
+        long ii = 0;
+        for (; ii + 8 <= n; ii += 8) {
+            __m512i v = _mm512_loadu_si512(vals + ii);
+            __m512i f = subModAVX512(_mm512_loadu_si512(factors + ii), vSub, vp);
+            _mm512_storeu_si512(vals + ii, montMulIFMA(v, f, vp, vInv));
+        }
+        return ii;
+    }
+
+    __attribute__((target("avx512f,avx512ifma")))
+    long prodSubIFMA(uint64_t lanes[8], long c, const long *roots, long n, uint64_t p, uint64_t pNegInv) {
+        const __m512i vp = _mm512_set1_epi64((long long) p), vInv = _mm512_set1_epi64((long long) pNegInv);
+        const __m512i vc = _mm512_set1_epi64(c);
+        __m512i acc = _mm512_set1_epi64(1);
+        long ii = 0;
+        for (; ii + 8 <= n; ii += 8)
+            acc = montMulIFMA(acc, subModAVX512(vc, _mm512_loadu_si512(roots + ii), vp), vp, vInv);
+        _mm512_storeu_si512(lanes, acc);
+        return ii;
+    }
+#endif
+}
+
+CPIMontgomery::CPIMontgomery(long p, Isa limit) : myIsa(Isa::Scalar), mod((uint64_t) p), rBits(64) {
+#ifdef CPI_KERNELS_X86
+    __builtin_cpu_init();
+    // 32-bit lanes need one multiplication fewer than 52-bit ones, so they are preferred whenever the modulus fits
+    if (limit >= Isa::AVX512F && mod < MAX_MOD_32 && __builtin_cpu_supports("avx512f")) {
+        myIsa = Isa::AVX512F;
+        rBits = 32;
+    } else if (limit >= Isa::AVX512IFMA && mod < MAX_MOD_IFMA &&
+               __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512ifma")) {
+        myIsa = Isa::AVX512IFMA;
+        rBits = 52;
+    } else if (limit >= Isa::AVX2 && mod < MAX_MOD_32 && __builtin_cpu_supports("avx2")) {
+        myIsa = Isa::AVX2;
+        rBits = 32;
+    }
+#endif
+    rMask = (rBits == 64) ? ~0ULL : (1ULL << rBits) - 1;
+
+    // 1/p mod 2^64 by Newton iteration; p is its own inverse mod 8, and each step doubles the number of correct bits
+    uint64_t inv = mod;
+    for (int ii = 0; ii < 5; ii++)
+        inv *= 2 - mod * inv;
+    pNegInv = (0 - inv) & rMask;
+    r1 = (uint64_t) (((u128) 1 << rBits) % mod);
+}
+
+const char *CPIMontgomery::isaName(Isa isa) {
+    switch (isa) {
+        case Isa::AVX2: return "AVX2";
+        case Isa::AVX512F: return "AVX-512F";
+        case Isa::AVX512IFMA: return "AVX-512 IFMA";
+        default: return "scalar";
+    }
+}
+
+uint64_t CPIMontgomery::_mul(uint64_t a, uint64_t b) const {
+    u128 t = (u128) a * b;
+    uint64_t m = ((uint64_t) t * pNegInv) & rMask;
+    auto u = (uint64_t) ((t + (u128) m * mod) >> rBits); // no overflow: mod < 2^63
+    return u >= mod ? u - mod : u;
+}
+
+uint64_t CPIMontgomery::_mulPlain(uint64_t a, uint64_t b) const {
+    return (uint64_t) ((u128) a * b % mod);
+}
+
+long CPIMontgomery::toMont(long a) const {
+    return (long) (((u128) (uint64_t) a << rBits) % mod);
+}
+
+void CPIMontgomery::mulSub(long *vals, const long *factors, long sub, long n) const {
+    long ii = 0;
+#ifdef CPI_KERNELS_X86
+    switch (myIsa) {
+        case Isa::AVX2: ii = mulSubAVX2(vals, factors, sub, n, mod, pNegInv); break;
+        case Isa::AVX512F: ii = mulSubAVX512F(vals, factors, sub, n, mod, pNegInv); break;
+        case Isa::AVX512IFMA: ii = mulSubIFMA(vals, factors, sub, n, mod, pNegInv); break;
+        default: break;
+    }
+#endif
+    for (; ii < n; ii++) {
+        long factor = factors[ii] - sub;
+        if (factor < 0)
+            factor += (long) mod;
+        vals[ii] = (long) _mul((uint64_t) vals[ii], (uint64_t) factor);
+    }
+}
+
+void CPIMontgomery::batchInv(long *vals, long n) const {
+    if (n <= 0)
+        return;
+
+    // prefix[i] = vals[0] ... vals[i], all in Montgomery form
+    std::vector<uint64_t> prefix((size_t) n);
+    prefix[0] = (uint64_t) vals[0];
+    for (long ii = 1; ii < n; ii++)
+        prefix[ii] = _mul(prefix[ii - 1], (uint64_t) vals[ii]);
+
+    // the Montgomery form of 1/X, for X R = prefix[n-1], is (X R)^-1 R^2
+    uint64_t inv = _mulPlain(invMod(prefix[n - 1], mod), _mulPlain(r1, r1));
+    for (long ii = n - 1; ii > 0; ii--) {
+        uint64_t val = (uint64_t) vals[ii];
+        vals[ii] = (long) _mul(inv, prefix[ii - 1]);
+        inv = _mul(inv, val);
+    }
+    vals[0] = (long) inv;
+}
+
+long CPIMontgomery::prodSub(long c, const long *roots, long n) const {
+    // Multiplying ordinary residues in Montgomery fashion loses a factor R per product; these are restored at the end.
+    uint64_t lanes[8];
+    long numLanes = 0, ii = 0;
+#ifdef CPI_KERNELS_X86
+    switch (myIsa) {
+        case Isa::AVX2: ii = prodSubAVX2(lanes, c, roots, n, mod, pNegInv); numLanes = 4; break;
+        case Isa::AVX512F: ii = prodSubAVX512F(lanes, c, roots, n, mod, pNegInv); numLanes = 8; break;
+        case Isa::AVX512IFMA: ii = prodSubIFMA(lanes, c, roots, n, mod, pNegInv); numLanes = 8; break;
+        default: break;
+    }
+#endif
+    uint64_t acc = 1;
+    for (long lane = 0; lane < numLanes; lane++)
+        acc = _mulPlain(acc, lanes[lane]);
+    for (; ii < n; ii++) {
+        long factor = c - roots[ii];
+        if (factor < 0)
+            factor += (long) mod;
+        acc = _mul(acc, (uint64_t) factor);
+    }
+
+    // ... multiply by R^n
+    uint64_t rPow = 1, base = r1;
+    for (auto exp = (uint64_t) n; exp > 0; exp >>= 1) {
+        if (exp & 1)
+            rPow = _mulPlain(rPow, base);
+        base = _mulPlain(base, base);
+    }
+    return (long) _mulPlain(acc, rPow);
+}
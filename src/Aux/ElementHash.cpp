@@ -0,0 +1,68 @@
+/* This code is part of the CPISync project developed at Boston University.  Please see the README for use and references. */
+
+#include <vector>
+#include <CPISync/Aux/ElementHash.h>
+
+namespace {
+    typedef unsigned __int128 u128;
+
+    // odd 64-bit constants with well-mixed bits (those of wyhash)
+    const uint64_t MIX0 = 0xa0761d6478bd642fULL, MIX1 = 0xe7037ed1a0b428dbULL, MIX2 = 0x8ebc6af09c88c6e3ULL;
+
+    /**
+     * @return The 128-bit product of a and b, folded to 64 bits.
+     */
+    inline uint64_t mulFold(uint64_t a, uint64_t b) {
+        u128 product = (u128) a * b;
+        return (uint64_t) product ^ (uint64_t) (product >> 64);
+    }
+
+    /**
+     * @return The len <= 8 bytes at data, as a little-endian integer (whatever the byte order of the host).
+     */
+    inline uint64_t load(const unsigned char *data, size_t len) {
+        uint64_t word = 0;
+        for (size_t ii = 0; ii < len; ii++)
+            word |= (uint64_t) data[ii] << (8 * ii);
+        return word;
+    }
+}
+
+const uint64_t ElementHash::DFT_KEY = 0x9e3779b97f4a7c15ULL;
+
+ElementHash::ElementHash(HASH_TYPE type, long bits, uint64_t key) : myType(type), myBits(bits), myKey(key) {
+    dataMax = power(ZZ_TWO, bits);
+}
+
+uint64_t ElementHash::hash64(const unsigned char *data, size_t len, uint64_t seed) {
+    seed ^= mulFold(seed ^ MIX0, MIX1);
+    size_t left = len;
+    for (; left > 16; left -= 16, data += 16)
+        seed = mulFold(load(data, 8) ^ MIX1, load(data + 8, 8) ^ seed);
+
+    // the last (up to) 16 bytes, and the length, which tells apart inputs that differ only in trailing zeros
+    uint64_t first = load(data, left < 8 ? left : 8), second = left > 8 ? load(data + 8, left - 8) : 0;
+    return mulFold(MIX1 ^ len, mulFold(first ^ MIX1, second ^ seed ^ MIX2));
+}
+
+ZZ ElementHash::operator()(const DataObject& datum) const {
+    if (myType == HASH_TYPE::Modulo)
+        return datum.to_ZZ() % dataMax;
+
+    std::vector<unsigned char> bytes;
+    datum.to_bytes(bytes);
+
+    // one pass, with its own key, per 64 bits of the result
+    long lanes = (myBits + 63) / 64;
+    std::vector<unsigned char> out(8 * lanes);
+    for (long lane = 0; lane < lanes; lane++) {
+        uint64_t word = hash64(bytes.data(), bytes.size(), myKey + (uint64_t) lane * MIX2);
+        for (int ii = 0; ii < 8; ii++)
+            out[8 * lane + ii] = (unsigned char) (word >> (8 * ii));
+    }
+
+    ZZ result;
+    ZZFromBytes(result, out.data(), (long) out.size());
+    trunc(result, result, myBits);
+    return result;
+}
@@ -10,6 +10,35 @@ SyncMethod::SyncMethod() {
 
 SyncMethod::~SyncMethod() = default;
 
+bool SyncMethod::delElem(shared_ptr<DataObject> datum) {
+    auto range = elementPos.equal_range(datum.get());
+    if (range.first == range.second)
+        return false; // not stored
+
+    vector<size_t> positions;
+    for (auto itr = range.first; itr != range.second; ++itr)
+        positions.push_back(itr->second);
+    elementPos.erase(range.first, range.second);
+
+    // fill each vacated position with the last element, working from the back so that
+    // no position still to be vacated is moved
+    std::sort(positions.rbegin(), positions.rend());
+    for (size_t pos : positions) {
+        size_t last = elements.size() - 1;
+        if (pos != last) {
+            elements[pos] = elements[last];
+            auto moved = elementPos.equal_range(elements[pos].get());
+            for (auto itr = moved.first; itr != moved.second; ++itr)
+                if (itr->second == last) {
+                    itr->second = pos;
+                    break;
+                }
+        }
+        elements.pop_back();
+    }
+    return true;
+}
+
 void SyncMethod::SendSyncParam(const shared_ptr<Communicant>& commSync, bool oneWay /* = false */) {
  if (!commSync->establishModSend(oneWay)) // establish ZZ_p modulus - must be first
      throw SyncFailureException("Sync parameters do not match between communicants.");
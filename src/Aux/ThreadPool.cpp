@@ -0,0 +1,101 @@
+/* This code is part of the CPISync project developed at Boston University.  Please see the README for use and references. */
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <CPISync/Aux/ThreadPool.h>
+
+ThreadPool::ThreadPool(unsigned numThreads) : stopping(false) {
+    if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned ii = 1; ii < numThreads; ii++)
+        workers.emplace_back(&ThreadPool::_work, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    ready.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+}
+
+void ThreadPool::_work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty())
+                return; // stopping, and nothing left to do
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+bool ThreadPool::_runOne() {
+    std::function<void()> task;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (tasks.empty())
+            return false;
+        task = std::move(tasks.front());
+        tasks.pop_front();
+    }
+    task();
+    return true;
+}
+
+void ThreadPool::parallelFor(long num, const std::function<void(long begin, long end)>& body, long minChunk) {
+    if (num <= 0)
+        return;
+    long chunks = std::min((long) size(), std::max(1L, num / std::max(1L, minChunk)));
+    if (chunks == 1) {
+        body(0, num);
+        return;
+    }
+
+    // bookkeeping shared by the ranges of this loop
+    std::atomic<long> pending(chunks);
+    std::mutex errorMtx;
+    std::exception_ptr error;
+    auto runRange = [&](long chunk) {
+        try {
+            body(num * chunk / chunks, num * (chunk + 1) / chunks);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMtx);
+            if (!error)
+                error = std::current_exception();
+        }
+        pending--;
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (long chunk = 1; chunk < chunks; chunk++)
+            tasks.emplace_back([&runRange, chunk] { runRange(chunk); });
+    }
+    ready.notify_all();
+
+    // do the first range here, then help with whatever is queued (possibly other loops' ranges) until all are done
+    runRange(0);
+    while (pending > 0)
+        if (!_runOne())
+            std::this_thread::yield();
+
+    if (error)
+        std::rethrow_exception(error);
+}
+
+void ThreadPool::parallelForEach(long num, const std::function<void(long index)>& body) {
+    // one range per thread, each of which claims indices until none are left
+    std::atomic<long> next(0);
+    parallelFor(std::min((long) size(), num), [&](long, long) {
+        for (long index = next++; index < num; index = next++)
+            body(index);
+    });
+}
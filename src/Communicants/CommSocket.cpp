@@ -4,8 +4,13 @@
 #include <sstream>
 #include <thread>
 #include <CPISync/Aux/Auxiliary.h>
+#include <CPISync/Aux/Exceptions.h>
 #include <CPISync/Communicants/CommSocket.h>
 
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // not available everywhere (e.g. macOS); there, a lost connection may raise SIGPIPE instead
+#endif
+
 CommSocket::CommSocket() = default;
 
 CommSocket::CommSocket(int port, string host) : Communicant() {
@@ -174,13 +179,9 @@ void CommSocket::commSend(const char* toSend, size_t len) {
     bool doAgain;
     do {
         auto startTime = std::chrono::high_resolution_clock::now();
-        if ((numSent = send(my_fd, toSend, numBytes * sizeof (char), 0)) == -1) {
-            string numBytesString;
-            string stateString;
-
-            Logger::error_and_quit(toStr(state) + " encountered error in send"
-                    + " numBytes is: " + toStr(numBytes));
-        }
+        if ((numSent = send(my_fd, toSend, numBytes * sizeof (char), MSG_NOSIGNAL)) == -1)
+            throw SyncFailureException(toStr(state) + " encountered error in send"
+                    + " numBytes is: " + toStr(numBytes)); // e.g. the connection was lost
         if (numSent != numBytes) {
             Logger::gLog(Logger::COMM_DETAILS,
                     "!!! Send packet fragmentation. numSent: " + toStr(numSent) + " of numBytes " + toStr(numBytes));
@@ -206,10 +207,12 @@ string CommSocket::commRecv(unsigned long numBytes) {
     auto tmpBuf = new char[numBytes];  // buffer into which received bytes are placed
 
     // wait until the buffer has been filled
-    if ((numRecv = recv(my_fd, tmpBuf, numBytes * sizeof (char), MSG_WAITALL)) < 0)
-        Logger::error_and_quit("Error receiving data on the socket!");
-    if (numRecv != numBytes)
-        Logger::error_and_quit("Received less or more than the prescribed number of characters in commRecv.");
+    numRecv = recv(my_fd, tmpBuf, numBytes * sizeof (char), MSG_WAITALL);
+    if (numRecv != numBytes) { // an error, or the connection was lost
+        delete[] tmpBuf;
+        throw SyncFailureException(numRecv < 0 ? "Error receiving data on the socket!"
+                : "Received less or more than the prescribed number of characters in commRecv.");
+    }
 
     addRecvBytes(static_cast<unsigned long>(numRecv));  // update the received byte counter
 
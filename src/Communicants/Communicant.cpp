@@ -1,11 +1,135 @@
 /* This code is part of the CPISync project developed at Boston University.  Please see the README for use and references. */
 
+#include <algorithm>
 #include <NTL/RR.h>
 #include <CPISync/Communicants/Communicant.h>
+#include <CPISync/Aux/Exceptions.h>
+
+namespace {
+    // IBLT wire format (see Communicant::commSend(const IBLT&, bool))
+
+    /**
+     * Appends num to out as a varint: 7 bits per byte, least significant first, the high bit set on all but the last.
+     */
+    void putVarint(string &out, uint64_t num) {
+        for (; num >= 0x80; num >>= 7)
+            out.push_back((char) (num | 0x80));
+        out.push_back((char) num);
+    }
+
+    /**
+     * @return num zig-zag encoded (0, -1, 1, -2, ... to 0, 1, 2, 3, ...), so that small counts of either sign are short.
+     */
+    uint64_t zigzag(long num) {
+        return ((uint64_t) num << 1) ^ (uint64_t) (num >> (8 * sizeof(long) - 1));
+    }
+
+    /**
+     * @return The count that zigzag encoded as num.
+     */
+    long unzigzag(uint64_t num) {
+        return (long) (num >> 1) ^ -(long) (num & 1);
+    }
+
+    /**
+     * @return The version, key width, bitmap, counts and hash-checks of an IBLT with numCells cells, of which the
+     * non-empty ones are full, with counts and checks in that order; the key and value sums are to be appended.
+     */
+    string ibltHead(size_t numCells, size_t keyWidth, const vector<size_t> &full, const vector<long> &counts,
+                    const vector<hash_t> &checks) {
+        string out(1, (char) IBLT_WIRE_VERSION);
+        putVarint(out, keyWidth);
+
+        size_t bitmapAt = out.size();
+        out.resize(bitmapAt + (numCells + 7) / 8);
+        for (size_t cell : full)
+            out[bitmapAt + cell / 8] |= (char) (1 << (cell % 8));
+
+        for (long count : counts)
+            putVarint(out, zigzag(count));
+        for (hash_t check : checks)
+            for (size_t ii = 0; ii < sizeof(hash_t); ii++)
+                out.push_back((char) (check >> (8 * ii)));
+        return out;
+    }
+
+    /**
+     * The columns of an IBLT received in the wire format, pointing into the buffer they were parsed from.
+     */
+    struct IBLTColumns {
+        size_t keyWidth; /** The width of the key sums, in bytes. */
+        vector<size_t> full; /** The non-empty cells, in order. */
+        vector<long> counts; /** The count of each non-empty cell. */
+        vector<hash_t> checks; /** The hash-check of each non-empty cell. */
+        const unsigned char *keys; /** The key sums of the non-empty cells, keyWidth bytes each. */
+        const unsigned char *values; /** The value sums of the non-empty cells, eltSize bytes each. */
+    };
+
+    /**
+     * Parses buf, the wire format of an IBLT with numCells cells and values of eltSize bytes.
+     * @throws SyncFailureException if buf is of another version, or malformed (including if it does not end with
+     * the value sums)
+     */
+    IBLTColumns parseIBLT(const string &buf, size_t numCells, size_t eltSize) {
+        auto data = reinterpret_cast<const unsigned char *>(buf.data());
+        size_t pos = 0;
+        auto need = [&](size_t bytes) {
+            if (bytes > buf.size() - pos)
+                throw SyncFailureException("Received IBLT is truncated.");
+        };
+        auto varint = [&]() -> uint64_t {
+            uint64_t num = 0;
+            for (int shift = 0; ; shift += 7) {
+                need(1);
+                if (shift > 63)
+                    throw SyncFailureException("Received IBLT has a malformed varint.");
+                unsigned char bt = data[pos++];
+                num |= (uint64_t) (bt & 0x7f) << shift;
+                if (!(bt & 0x80))
+                    return num;
+            }
+        };
+
+        need(1);
+        if (data[pos] != IBLT_WIRE_VERSION)
+            throw SyncFailureException("Received IBLT has wire format version " + toStr((int) data[pos])
+                                       + ", expected " + toStr((int) IBLT_WIRE_VERSION) + ".");
+        pos++;
+
+        IBLTColumns cols;
+        cols.keyWidth = (size_t) varint();
+        need((numCells + 7) / 8);
+        for (size_t cell = 0; cell < numCells; cell++)
+            if (data[pos + cell / 8] & (1 << (cell % 8)))
+                cols.full.push_back(cell);
+        pos += (numCells + 7) / 8;
+
+        for (size_t ii = 0; ii < cols.full.size(); ii++)
+            cols.counts.push_back(unzigzag(varint()));
+        need(cols.full.size() * sizeof(hash_t));
+        for (size_t ii = 0; ii < cols.full.size(); ii++) {
+            hash_t check = 0;
+            for (size_t jj = 0; jj < sizeof(hash_t); jj++)
+                check |= (hash_t) data[pos++] << (8 * jj);
+            cols.checks.push_back(check);
+        }
+
+        if (cols.keyWidth > buf.size())
+            throw SyncFailureException("Received IBLT has a malformed key width.");
+        need(cols.full.size() * (cols.keyWidth + eltSize));
+        cols.keys = data + pos;
+        cols.values = cols.keys + cols.full.size() * cols.keyWidth;
+        pos += cols.full.size() * (cols.keyWidth + eltSize);
+        if (pos != buf.size())
+            throw SyncFailureException("Received IBLT has " + toStr(buf.size() - pos) + " trailing bytes.");
+        return cols;
+    }
+}
 
 Communicant::Communicant() {
     resetCommCounters();
-    xferBytesTot = xferBytes = recvBytesTot = recvBytes = 0;
+    xferBytesTot = xferBytes = recvBytesTot = recvBytes = roundTripsTot = 0;
+    lastXmit = false;
 }
 
 Communicant::~Communicant() = default;
@@ -15,7 +139,8 @@ void Communicant::resetCommCounters() {
 }
 
 void Communicant::hardResetCommCounters() {
-    xferBytes = recvBytes = xferBytesTot = recvBytesTot = 0;
+    xferBytes = recvBytes = xferBytesTot = recvBytesTot = roundTripsTot = 0;
+    lastXmit = false;
 }
 
 string Communicant::getName() {
@@ -38,15 +163,23 @@ unsigned long Communicant::getRecvBytesTot() {
     return recvBytesTot;
 }
 
+unsigned long Communicant::getRoundTripsTot() const {
+    return roundTripsTot;
+}
+
 
 void Communicant::addXmitBytes(unsigned long numBytes) {
     xferBytes += numBytes;
     xferBytesTot += numBytes;
+    lastXmit = true;
 }
 
 void Communicant::addRecvBytes(unsigned long numBytes) {
     recvBytes += numBytes;
     recvBytesTot += numBytes;
+    if (lastXmit) // the other side answered
+        roundTripsTot++;
+    lastXmit = false;
 }
 
 
@@ -77,6 +210,7 @@ bool Communicant::establishModSend(bool oneWay /* = false */) {
 bool Communicant::establishIBLTSend(const size_t size, const size_t eltSize, bool oneWay /* = false */) {
     commSend((long) size);
     commSend((long) eltSize);
+    commSend(IBLT_HASH_VERSION);
     if (oneWay)
         return true;  // i.e. don't wait for a response
     else
@@ -84,17 +218,19 @@ bool Communicant::establishIBLTSend(const size_t size, const size_t eltSize, boo
 }
 
 bool Communicant::establishIBLTRecv(const size_t size, const size_t eltSize, bool oneWay /* = false */) {
-    // receive other size and eltSize. both must be read, even if the first parameter is wrong
+    // receive other size, eltSize and hash version. all must be read, even if the first parameter is wrong
     long otherSize = commRecv_long();
     long otherEltSize = commRecv_long();
+    byte otherHashVersion = commRecv_byte();
 
-    if(otherSize == size && otherEltSize == eltSize) {
+    if(otherSize == size && otherEltSize == eltSize && otherHashVersion == IBLT_HASH_VERSION) {
         if(!oneWay)
             commSend(SYNC_OK_FLAG);
         return true;
     } else {
         Logger::gLog(Logger::COMM, "IBLT params do not match: mine(size=" + toStr(size) + ", eltSize="
-        + toStr(eltSize) + ") vs other(size=" + toStr(otherSize) + ", eltSize=" + toStr(otherEltSize) + ").");
+        + toStr(eltSize) + ", hash version=" + toStr((int) IBLT_HASH_VERSION) + ") vs other(size=" + toStr(otherSize)
+        + ", eltSize=" + toStr(otherEltSize) + ", hash version=" + toStr((int) otherHashVersion) + ").");
         if(!oneWay)
             commSend(SYNC_FAIL_FLAG);
         return false;
@@ -272,10 +408,36 @@ void Communicant::commSend(const IBLT& iblt, bool sync) {
         commSend((long) iblt.eltSize());
     }
 
-    // Access the hashTable representation of iblt to serialize it
-    for(const IBLT::HashTableEntry& hte : iblt.hashTable) {
-        commSend(hte, iblt.eltSize());
+    // Access the hashTable representation of iblt to serialize it, skipping the empty cells
+    vector<size_t> full;
+    vector<long> counts;
+    vector<hash_t> checks;
+    size_t keyWidth = 0;
+    for (size_t cell = 0; cell < iblt.size(); cell++) {
+        const IBLT::HashTableEntry& hte = iblt.hashTable[cell];
+        if (hte.empty())
+            continue;
+        full.push_back(cell);
+        counts.push_back(hte.count);
+        checks.push_back(hte.keyCheck);
+        keyWidth = std::max(keyWidth, (size_t) NumBytes(hte.keySum));
+    }
+
+    string out = ibltHead(iblt.size(), keyWidth, full, counts, checks);
+    size_t at = out.size(), eltSize = iblt.eltSize();
+    out.resize(at + full.size() * (keyWidth + eltSize));
+    auto sums = reinterpret_cast<unsigned char *>(&out[0]);
+    for (size_t cell : full) {
+        BytesFromZZ(sums + at, iblt.hashTable[cell].keySum, (long) keyWidth);
+        at += keyWidth;
+    }
+    for (size_t cell : full) {
+        BytesFromZZ(sums + at, iblt.hashTable[cell].valueSum, (long) eltSize);
+        at += eltSize;
     }
+
+    commSend((long) out.size());
+    commSend(out.data(), out.size());
 }
 
 void Communicant::commSend(const IBLTMultiset &iblt, bool sync) {
@@ -290,6 +452,42 @@ void Communicant::commSend(const IBLTMultiset &iblt, bool sync) {
     }
 }
 
+void Communicant::commSend(const IBLTFixed &iblt, bool sync) {
+    if (!sync) {
+        commSend((long) iblt.size());
+        commSend((long) iblt.eltSize());
+    }
+
+    // the non-empty cells, whose key sums are sent without the zero bytes that they all end with
+    size_t width = iblt.eltSize();
+    vector<size_t> full;
+    vector<long> counts;
+    vector<hash_t> checks;
+    size_t keyWidth = 0;
+    for (size_t cell = 0; cell < iblt.size(); cell++) {
+        if (iblt._empty(cell))
+            continue;
+        full.push_back(cell);
+        counts.push_back(iblt.counts[cell]);
+        checks.push_back(iblt.keyChecks[cell]);
+        for (size_t len = width; len > keyWidth; len--) {
+            if (iblt.keySums[cell * width + len - 1] != 0) {
+                keyWidth = len;
+                break;
+            }
+        }
+    }
+
+    string out = ibltHead(iblt.size(), keyWidth, full, counts, checks);
+    for (size_t cell : full)
+        out.append(reinterpret_cast<const char *>(&iblt.keySums[cell * width]), keyWidth);
+    for (size_t cell : full)
+        out.append(reinterpret_cast<const char *>(&iblt.valueSums[cell * width]), width);
+
+    commSend((long) out.size());
+    commSend(out.data(), out.size());
+}
+
 void Communicant::commSend(const Cuckoo& cf) {
     commSend((long) cf.getFngprtSize());
     commSend((long) cf.getBucketSize());
@@ -536,9 +734,52 @@ IBLT Communicant::commRecv_IBLT(Nullable<size_t> size, Nullable<size_t> eltSize)
 
     IBLT theirs;
     theirs.valueSize = numEltSize;
+    theirs.hashTable.resize(numSize);
+
+    // the cells not in the bitmap stay empty
+    string buf = commRecv(narrow_cast<unsigned long>(commRecv_long()));
+    IBLTColumns cols = parseIBLT(buf, numSize, numEltSize);
+    for (size_t ii = 0; ii < cols.full.size(); ii++) {
+        IBLT::HashTableEntry& hte = theirs.hashTable[cols.full[ii]];
+        hte.count = cols.counts[ii];
+        hte.keyCheck = cols.checks[ii];
+        ZZFromBytes(hte.keySum, cols.keys + ii * cols.keyWidth, (long) cols.keyWidth);
+        ZZFromBytes(hte.valueSum, cols.values + ii * numEltSize, (long) numEltSize);
+    }
 
-    for(int ii = 0; ii < numSize; ii++) {
-        theirs.hashTable.push_back(commRecv_HashTableEntry(numEltSize));
+    return theirs;
+}
+
+IBLTFixed Communicant::commRecv_IBLTFixed(Nullable<size_t> size, Nullable<size_t> eltSize) {
+    size_t numSize;
+    size_t numEltSize;
+
+    if(size.isNullQ() || eltSize.isNullQ()) {
+        numSize = (size_t) commRecv_long();
+        numEltSize = (size_t) commRecv_long();
+    } else {
+        numSize = *size;
+        numEltSize = *eltSize;
+    }
+
+    IBLTFixed theirs(0, numEltSize);
+    theirs.counts.resize(numSize);
+    theirs.keyChecks.resize(numSize);
+    theirs.keySums.resize(numSize * numEltSize);
+    theirs.valueSums.resize(numSize * numEltSize);
+
+    // the cells not in the bitmap stay empty, and the key sums are widened back with zero bytes
+    string buf = commRecv(narrow_cast<unsigned long>(commRecv_long()));
+    IBLTColumns cols = parseIBLT(buf, numSize, numEltSize);
+    if (cols.keyWidth > numEltSize)
+        throw SyncFailureException("Received IBLT has key sums of " + toStr(cols.keyWidth) + " bytes, expected at most "
+                                   + toStr(numEltSize) + ".");
+    for (size_t ii = 0; ii < cols.full.size(); ii++) {
+        size_t cell = cols.full[ii];
+        theirs.counts[cell] = cols.counts[ii];
+        theirs.keyChecks[cell] = cols.checks[ii];
+        std::copy_n(cols.keys + ii * cols.keyWidth, cols.keyWidth, theirs.keySums.begin() + cell * numEltSize);
+        std::copy_n(cols.values + ii * numEltSize, numEltSize, theirs.valueSums.begin() + cell * numEltSize);
     }
 
     return theirs;
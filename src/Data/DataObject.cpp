@@ -64,6 +64,11 @@ string DataObject::to_string() const {
     return RepIsInt?toStr(myBuffer):unpack(myBuffer);
 }
 
+void DataObject::to_bytes(std::vector<unsigned char>& bytes) const {
+    bytes.resize(narrow_cast<size_t>(NumBytes(myBuffer)));
+    BytesFromZZ(bytes.data(), myBuffer, (long) bytes.size());
+}
+
 const char *DataObject::to_char_array(size_t &len) const {
     len = narrow_cast<size_t>(NumBytes(myBuffer));
     return strndup(to_string().data(), len);
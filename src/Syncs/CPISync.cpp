@@ -6,6 +6,11 @@
 #include <fstream>
 #include <sstream>
 #include <map>
+#include <mutex>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <NTL/RR.h>
 #include <NTL/ZZ_p.h>
 #include <NTL/ZZ_pX.h>
@@ -21,17 +26,40 @@
 
 using namespace NTL;
 
+namespace {
+    // Minimum number of sample locations (or roots) per thread.  A word-sized field operation takes a few nanoseconds,
+    // so it takes a longer range than for ZZ_p to outweigh handing the range to another thread.
+    const long PAR_GRAIN_WORD = 4096;
+    const long PAR_GRAIN_BIG = 256;
+
+    // the Montgomery kernels (CPIKernels.h) work directly on the residues of a vec_zz_p, which are stored as longs
+    static_assert(sizeof(zz_p) == sizeof(long), "zz_p is expected to hold just its residue");
+    inline long *rawResidues(vec_zz_p& vec) { return reinterpret_cast<long *>(vec.elts()); }
+
+    // adds the seconds elapsed since start to total
+    inline void addElapsed(double& total, std::chrono::steady_clock::time_point start) {
+        total += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
 // helper procedures
 void CPISync::initData(long num) {
     Logger::gLog(Logger::METHOD,"Entering CPISync::initData");
-    // set the lengths
-    sampleLoc.SetLength(num);
+    // share sample locations with every other CPISync using the same parameters
+    samplePlan = cpiPlan<BigField>(bitNum, maxDiff, redundant_k);
     CPI_evals.SetLength(num);
-
-    // populate the arrays
-    for (int ii = 0; ii < num; ii++) {
-        sampleLoc[ii] = to_ZZ_p(DATA_MAX) + ii + 1; // i.e. from the region outside where valid data might lie
+    for (int ii = 0; ii < num; ii++)
         CPI_evals[ii] = 1;
+
+    // ... and their word-sized counterparts, if the field is small enough
+    if (wordField) {
+        wordContext.restore();
+        samplePlanWord = cpiPlan<WordField>(bitNum, maxDiff, redundant_k);
+        montWord = samplePlanWord->montgomery();
+        Logger::gLog(Logger::METHOD_DETAILS, string("CPISync word-field kernels: ") + CPIMontgomery::isaName(montWord->isa()));
+        CPI_evalsWord.SetLength(num);
+        for (int ii = 0; ii < num; ii++)
+            CPI_evalsWord[ii] = 1;
     }
 
     probCPI = oneWay = keepAlive = false; // assume not OneWay or Probabilistic synchronization unless otherwise stated, and manage our own communicant connections
@@ -39,7 +67,7 @@ void CPISync::initData(long num) {
 }
 
 CPISync::CPISync(long m_bar, long bits, int epsilon, int redundant, bool hashes /* = false */) :
-maxDiff(m_bar), probEps(epsilon), hashQ(hashes) {
+maxDiff(m_bar), probEps(epsilon), hashQ(hashes), multisetQ(false), interpType(INTERP_TYPE::Gauss), rootType(ROOT_TYPE::Factor) {
 Logger::gLog(Logger::METHOD,"Entering CPISync::CPISync");
 
     // set default parameters
@@ -79,16 +107,31 @@ Logger::gLog(Logger::METHOD,"Entering CPISync::CPISync");
         redundant_k = 1;
 
     DATA_MAX = power(ZZ_TWO, bitNum);
+    elementHash = ElementHash(HASH_TYPE::Modulo, bitNum);
     fieldSize = NextPrime(DATA_MAX + maxDiff + redundant_k);
     ZZ_p::init(fieldSize);
 
+    // use single-precision arithmetic whenever the field fits in a machine word
+    wordField = fitsWordField(fieldSize);
+    if (wordField)
+        wordContext = zz_pContext(conv<long>(fieldSize));
+
     initData(maxDiff + redundant_k); // initialize sample locations and metadata
 }
 
 CPISync::~CPISync() {
-    sampleLoc.kill();
     CPI_hash.clear();
+    CPI_revHash.clear();
+    CPI_copies.clear();
     CPI_evals.kill();
+    CPI_evalsWord.kill();
+}
+
+void CPISync::refreshEvals() {
+    if (wordField) {
+        wordContext.restore();
+        convField(CPI_evals, CPI_evalsWord);
+    }
 }
 
 string CPISync::getName() {
@@ -108,209 +151,105 @@ string CPISync::getName() {
 
 bool CPISync::ratFuncInterp(const vec_ZZ_p& evals, long mA, long mB, vec_ZZ_p& P_vec, vec_ZZ_p& Q_vec) {
     Logger::gLog(Logger::METHOD,"Entering CPISync::ratFuncInterp");
-    /* The coding attempts to follow the notation in
-     ** Y. Minsky, A. Trachtenberg, and R. Zippel,
-     **   Set Reconciliation with Nearly Optimal Communication Complexity,
-     **   IEEE Trans. Inf. Theory 49:9, pp. 2213-2218 (see page 7, for example).
-     */
-
-    // local variables
-    long ii, jj;
-    long mbar = evals.length(), mAbar, mBbar, rank;
-    long delta = mA - mB;
-
-    vec_ZZ_p coefficient_vec;
-
-    // 0. Compute bounds on one-sided set differences
-    mAbar = (mbar + delta) / 2; /** (Upper bound on the degree of the numerator polynomial)+1:
-                               * ((mbar + delta) % 2 == 0) ? (mbar + delta - 1) / 2 : (mbar + delta) / 2; */
-    mBbar = (mbar - delta) / 2; /** (Upper bound on the degree of the denominator polynomial)+1:
-                               * ((mbar - delta) % 2 == 0) ? (mbar - delta - 1) / 2 : (mbar - delta) / 2; */
-
-    // ... sanity checks
-    if ((mAbar < 0) || (mBbar < 0)) {
-        Logger::gLog(Logger::METHOD, "0. function interpolation failed, more sample points needed.\n");
-        return false;
-    }
-
-    // 1. Construct and solve a linear equations that produces the interpolation
-    // van_matrix is, in terms of the article referenced above:
-    //    k_i ^{d1-1} ... 1 | - f_i k_i^{d2-1} ... -f_i || f_i k_i^d2 - k_i^d1
-    //    A || B, where Ax = B yields x = p_{d1-1} ... p_0 | q_{d2-1} ... q0
-    //    The solution x is stored in coefficient_vec below.
-
-    mat_ZZ_p van_matrix; // a concatenation of Vandermonde matrices
-    van_matrix.SetDims(mbar, mAbar + mBbar + 1);
-    for (ii = 0; ii < mbar; ii++) {
-        // might be possible to streamline for large mAbar/mBbar
-        for (jj = 0; jj < mAbar; jj++)
-            van_matrix[ii][jj] = power(sampleLoc[ii], mAbar - jj - 1);
-        for (jj = 0; jj < mBbar; jj++)
-            van_matrix[ii][jj + mAbar] = -evals[ii] * power(sampleLoc[ii], mBbar - jj - 1);
-        van_matrix[ii][mAbar + mBbar] = evals[ii] * power(sampleLoc[ii], mBbar) - power(sampleLoc[ii], mAbar);
-    }
-
-    mat_ZZ_p copyv_matrix(van_matrix); // unadulterated copy of van_matrix
-    rank = gauss(van_matrix, mAbar + mBbar); // the last column just goes along for the ride
-
-    // compare # of independent variables (rank) to total permitted degree of the interpolated function
-    if (rank > mAbar + mBbar) { // case 1.  rank > tot. degree => error
-        Logger::gLog(Logger::METHOD, "1. function interpolation failed, more sample points needed.\n");
-        return false;
-    } else if (rank < mAbar + mBbar) {
-        // case 2. rank is smaller than tot. degree => recreate the matrix with the correct size
-        // ... we do this by taking mAbar - mDiff columns from among the first mAbar
-        // ...                  and mBbar - mDiff columns from index mAbar to mAbar-mBar -1
-        // ...                  and the last column of the matrix
-        long mDiff = mAbar + mBbar - rank; // difference between rank and upper bounds
-        // ... adjust upper bounds mAbar and mBbar accordingly
-        mAbar -= mDiff;
-        mBbar -= mDiff;
-
-        van_matrix.SetDims(mAbar + mBbar, mAbar + mBbar + 1);
-
-        // recreate based on the original matrix computations
-        for (ii = 0; ii < mAbar + mBbar; ii++) {
-            for (jj = 0; jj < mAbar; jj++)
-                van_matrix[ii][jj] = copyv_matrix[ii][jj + mDiff];
-            for (jj = 0; jj < mBbar; jj++)
-                van_matrix[ii][jj + mAbar] = copyv_matrix[ii][jj + mAbar + mDiff + mDiff];
-            van_matrix[ii][mAbar + mBbar] = evals[ii] * power(sampleLoc[ii], mBbar) - power(sampleLoc[ii], mAbar);
-        }
-
-        // row-reduce the resulting matrix
-        rank = gauss(van_matrix, mAbar + mBbar); // the last column just goes along for the ride      
-    }
-
-    // store the solution to the linear system in coefficient_vec
-    coefficient_vec.SetLength(rank);
-    for (ii = rank - 1; ii >= 0; ii--) {
-        coefficient_vec[ii] = van_matrix[ii][mAbar + mBbar] / van_matrix[ii][ii];
-        for (jj = 0; jj < ii; jj++) // subtract out the coefficient from the previous entries
-            van_matrix[jj][mAbar + mBbar] -= coefficient_vec[ii] * van_matrix[jj][ii];
-    }
-
-    // 2. Store the result of the interpolation in P_vec and Q_vec
-    P_vec.SetLength(mAbar + 1); // adding 1 is for p0 and q0
-    Q_vec.SetLength(mBbar + 1);
-
-    // the first mAbar coefficients (in reverse order) are P_vec
-    P_vec[mAbar] = 1;
-    for (ii = 0; ii < mAbar; ii++)
-        P_vec[ii] = coefficient_vec[mAbar - ii - 1];
-
-    // the next mBbar coefficients (in reverse order) are Q_vec
-    Q_vec[mBbar] = 1;
-    for (ii = 0; ii < rank - mAbar; ii++)
-        Q_vec[ii] = coefficient_vec[rank - ii - 1];
-
-    // 3. Free up memory and return
-    coefficient_vec.kill();
-    van_matrix.kill();
-    copyv_matrix.kill();
-
-    return true;
+    const vec_ZZ_p& sampleLoc = samplePlan->samples();
+    if (interpType == INTERP_TYPE::Fast)
+        return cpiRatFuncInterpIncr<BigField>(interpState, sampleLoc, evals, mA, mB, P_vec, Q_vec);
+    return cpiRatFuncInterp<BigField>(sampleLoc, evals, mA, mB, P_vec, Q_vec);
 }
 
 bool CPISync::find_roots(vec_ZZ_p& P_vec, vec_ZZ_p& Q_vec, vec_ZZ_p& numerator, vec_ZZ_p& denominator) {
 Logger::gLog(Logger::METHOD,"Entering CPISync::find_roots");
-    // 0. initialization
-    ZZ_pX P_poly, Q_poly, gcd_poly;
-
-    // ... convert to ZZ_pX polynomials
-    conv(P_poly, P_vec);
-    conv(Q_poly, Q_vec);
-
-    // ... bring to a fraction in lowest terms
-    gcd_poly = GCD(P_poly, Q_poly);
-    if (deg(gcd_poly) > 0) {
-        P_poly = P_poly / gcd_poly;
-        Q_poly = Q_poly / gcd_poly;
-    }
-    gcd_poly.kill(); // free up its memory
-
-    // 1. Check that the polynomials are square free - is gcd(poly, derivative(poly))==1?
-    if (!IsOne(GCD(P_poly, diff(P_poly))) ||
-            !IsOne(GCD(Q_poly, diff(Q_poly)))) {
-        Logger::gLog(Logger::METHOD, "Polynomial is not square free!\n");
-        return false;
-    }
-
-    // 2. Factor the two polynomials
-    // SFBerlekamp function defined in ZZ_pXFactoring module - "Berlekamp" factoring approach [Shoup, J. Symbolic Comp. 20:363-397, 1995].
-    vec_ZZ_pX nn, dd;
-    nn = SFBerlekamp(P_poly);
-    if (nn.length() > 0)
-        for (const ZZ_pX& fact : nn)
-            if (deg(fact) > 1) { // ended with a non-linear factor
-                Logger::gLog(Logger::METHOD, "Cannot reduce P_poly to linear factors..\n");
-                return false;
-            }
-
-    dd = SFBerlekamp(Q_poly);
-    if (dd.length() > 0)
-        for (const ZZ_pX& fact : dd)
-            if (deg(fact) > 1) { // ended with a non-linear factor
-                Logger::gLog(Logger::METHOD, "Cannot reduce Q_poly to linear factors.\n");
-                return false;
-            }
-
-    // 3. Put the results into the numerator and denominator vectors and return
-    numerator.SetLength(deg(P_poly));
-    denominator.SetLength(deg(Q_poly));
-
-    for (int ii = 0; ii < nn.length(); ii++)
-        numerator[ii] = -ConstTerm(nn[ii]);
-    for (int ii = 0; ii < dd.length(); ii++)
-        denominator[ii] = -ConstTerm(dd[ii]);
-
-    // free up memory
-    P_poly.kill();
-    Q_poly.kill();
-
-    nn.kill();
-    dd.kill();
-
-    return true;
+    return cpiFindRoots<BigField>(P_vec, Q_vec, numerator, denominator);
 }
 
 bool CPISync::set_reconcile(const long otherSetSize, const vec_ZZ_p &otherEvals, vec_ZZ_p &delta_self, vec_ZZ_p &delta_other) {
 Logger::gLog(Logger::METHOD,"Entering CPISync::set_reconcile");
     if (otherSetSize < 1) {
         // Jin's optimization:  if the other set has nothing, just send over my evaluations
-        map<ZZ, shared_ptr<DataObject> >::iterator itCPI;
-
-        for (itCPI = CPI_hash.begin(); itCPI != CPI_hash.end(); itCPI++)
-            append(delta_self, to_ZZ_p(itCPI->first));
+        vector<const ZZ *> hashes;
+        hashes.reserve(_setSize());
+        for (const auto& entry : CPI_hash)
+            for (long copy = _multiplicity(entry.first); copy > 0; copy--)
+                hashes.push_back(&entry.first);
+
+        long start = delta_self.length();
+        delta_self.SetLength(start + (long) hashes.size());
+        _parallelFor((long) hashes.size(), [&](long begin, long end) {
+            for (long ii = begin; ii < end; ii++)
+                conv(delta_self[start + ii], *hashes[ii]);
+        }, PAR_GRAIN_BIG);
     } else // otherSetSize >=1 - the other set has something
         if (CPI_hash.empty()) { // I have nothing new
         return true;
     } else { // we both have something new
-        vec_ZZ_p coefficient_P, coefficient_Q;
-
-        // compute rational function evals
-        vec_ZZ_p ratFuncEvals;
         long metalength = min(otherEvals.length(), currDiff);
-        for (long ii = 0; ii < metalength; ii++)
-          append(ratFuncEvals, otherEvals[ii] / CPI_evals[ii]);
 
-        // attempt to interpolate based on these evals
-        if (!ratFuncInterp(ratFuncEvals, otherSetSize, CPI_hash.size(), coefficient_P, coefficient_Q))
-            return false;
+        if (wordField) { // the whole reconciliation fits in machine words
+            wordContext.restore();
+            vec_zz_p numerator, denominator;
+            if (!_reconcileField<WordField>(otherSetSize, otherEvals, metalength, CPI_evalsWord, samplePlanWord->samples(),
+                                            interpStateWord, numerator, denominator))
+                return false;
+
+            vec_ZZ_p numeratorBig, denominatorBig;
+            convField(numeratorBig, numerator);
+            convField(denominatorBig, denominator);
+            append(delta_other, numeratorBig);
+            append(delta_self, denominatorBig);
+            return true;
+        }
 
-        // attempt to find roots of the numerator and denominator of the rational function
         vec_ZZ_p numerator, denominator;
-        if (!find_roots(coefficient_P, coefficient_Q, numerator, denominator))
+        if (!_reconcileField<BigField>(otherSetSize, otherEvals, metalength, CPI_evals, samplePlan->samples(),
+                                       interpState, numerator, denominator))
             return false;
         append(delta_other, numerator);
         append(delta_self, denominator);
-
-        coefficient_P.kill();
-        coefficient_Q.kill();
     }
     return true;
 }
 
+template <class F>
+bool CPISync::_reconcileField(long otherSetSize, const vec_ZZ_p& otherEvals, long metalength, const typename F::Vec& evals,
+                              const typename F::Vec& sampleLoc, CPIInterpState<F>& state,
+                              typename F::Vec& numerator, typename F::Vec& denominator) {
+    typename F::Vec coefficient_P, coefficient_Q;
+
+    // compute rational function evals
+    typename F::Vec ratFuncEvals;
+    ratFuncEvals.SetLength(metalength);
+    for (long ii = 0; ii < metalength; ii++) {
+        conv(ratFuncEvals[ii], rep(otherEvals[ii]));
+        ratFuncEvals[ii] /= evals[ii];
+    }
+
+    // attempt to interpolate based on these evals
+    auto start = std::chrono::steady_clock::now();
+    bool interpolated = (interpType == INTERP_TYPE::Fast)
+            ? cpiRatFuncInterpIncr<F>(state, sampleLoc, ratFuncEvals, otherSetSize, _setSize(), coefficient_P, coefficient_Q)
+            : cpiRatFuncInterp<F>(sampleLoc, ratFuncEvals, otherSetSize, _setSize(), coefficient_P, coefficient_Q);
+    addElapsed(interpTime, start);
+    if (!interpolated)
+        return false;
+
+    // attempt to find roots of the numerator and denominator of the rational function
+    start = std::chrono::steady_clock::now();
+    bool found;
+    if (multisetQ) // roots may be repeated
+        found = cpiFindRootsMultiset<F>(coefficient_P, coefficient_Q, numerator, denominator);
+    else if (rootType == ROOT_TYPE::Evaluate) {
+        typename F::Vec localHashes;
+        localHashes.SetLength(CPI_hash.size());
+        long ii = 0;
+        for (const auto& entry : CPI_hash)
+            conv(localHashes[ii++], entry.first);
+        found = cpiFindRootsEvaluate<F>(coefficient_P, coefficient_Q, localHashes, numerator, denominator);
+    } else
+        found = cpiFindRoots<F>(coefficient_P, coefficient_Q, numerator, denominator);
+    addElapsed(rootTime, start);
+    return found;
+}
+
 void CPISync::_sendSetElem(const shared_ptr<Communicant> &commSync, list<shared_ptr<DataObject>> &selfMinusOther,
 						   const ZZ_p &element) {
     Logger::gLog(Logger::METHOD,"Entering CPISync::sendSetElem");
@@ -362,11 +301,15 @@ void CPISync::SendSyncParam(const shared_ptr<Communicant>& commSync, bool oneWay
     // take care of parent sync method
     SyncMethod::SendSyncParam(commSync, oneWay);
 
-    // ... sync ID, mbar, bits, and epsilon
+    // ... sync ID, parameter version, mbar, bits, epsilon, multiset mode and element hash
     commSync->commSend(enumToByte(SyncID));
+    commSync->commSend(CPISYNC_PARAM_VERSION);
     commSync->commSend(maxDiff);
     commSync->commSend(bitNum);
     commSync->commSend(probEps);
+    commSync->commSend((byte) multisetQ);
+    commSync->commSend(enumToByte(elementHash.type()));
+    commSync->commSend(to_ZZ((unsigned long) elementHash.key()), sizeof(uint64_t));
     if (!oneWay && (commSync->commRecv_byte() == SYNC_FAIL_FLAG))
         throw SyncFailureException("Sync parameters do not match.");
     Logger::gLog(Logger::COMM, "Sync parameters match");
@@ -377,22 +320,41 @@ void CPISync::RecvSyncParam(const shared_ptr<Communicant>& commSync, bool oneWay
     // take care of parent sync method
     SyncMethod::RecvSyncParam(commSync, oneWay);
 
-    // ... sync ID, mbar, bits, and epsilon        
+    // ... sync ID and parameter version; the rest cannot be parsed under another version
     byte theSyncID = commSync->commRecv_byte();
+    byte versionClient = commSync->commRecv_byte();
+    if (versionClient != CPISYNC_PARAM_VERSION) {
+        if (!oneWay)
+            commSync->commSend(SYNC_FAIL_FLAG);
+        Logger::gLog(Logger::COMM, "Sync parameter versions differ: Client has " + toStr((int) versionClient) +
+                ".  Server has " + toStr((int) CPISYNC_PARAM_VERSION) + ".");
+        throw SyncFailureException("Sync parameter versions do not match.");
+    }
+
+    // ... mbar, bits, epsilon, multiset mode and element hash
     long mbarClient = commSync->commRecv_long();
     long bitsClient = commSync->commRecv_long();
     int epsilonClient = commSync->commRecv_int();
+    bool multisetClient = commSync->commRecv_byte() != 0;
+    byte hashTypeClient = commSync->commRecv_byte();
+    ZZ hashKeyClient = commSync->commRecv_ZZ(sizeof(uint64_t));
 
     if (theSyncID != enumToByte(SyncID) ||
             mbarClient != maxDiff ||
             bitsClient != bitNum ||
-            epsilonClient != probEps) {
+            epsilonClient != probEps ||
+            multisetClient != multisetQ ||
+            hashTypeClient != enumToByte(elementHash.type()) ||
+            hashKeyClient != to_ZZ((unsigned long) elementHash.key())) {
         // report a failure to establish sync parameters
         if (!oneWay)
             commSync->commSend(SYNC_FAIL_FLAG);
         Logger::gLog(Logger::COMM, "Sync parameters differ from client to server: Client has (" +
-                toStr(mbarClient) + "," + toStr(bitsClient) + "," + toStr(epsilonClient) +
-                ").  Server has (" + toStr(maxDiff) + "," + toStr(bitNum) + "," + toStr(probEps) + ").");
+                toStr(mbarClient) + "," + toStr(bitsClient) + "," + toStr(epsilonClient) + "," +
+                toStr(multisetClient) + "," + toStr((int) hashTypeClient) + "," + toStr(hashKeyClient) +
+                ").  Server has (" + toStr(maxDiff) + "," + toStr(bitNum) + "," + toStr(probEps) + "," +
+                toStr(multisetQ) + "," + toStr((int) enumToByte(elementHash.type())) + "," +
+                toStr(elementHash.key()) + ").");
         throw SyncFailureException("Sync parameters do not match.");
     }
     if (!oneWay)
@@ -406,6 +368,7 @@ bool CPISync::SyncClient(const shared_ptr<Communicant>& commSync, list<shared_pt
     mySyncStats.timerStart(SyncStats::COMP_TIME);
 	//Reset currDiff to 1 at the start of the sync so that the correct upper bound can be found if the dataset has changed
     if(probCPI) currDiff = 1;
+    refreshEvals();
 
     // local variables
     vec_ZZ_p delta_self, /** items I have that the other does not, based on the last synchronization. */
@@ -430,15 +393,11 @@ bool CPISync::SyncClient(const shared_ptr<Communicant>& commSync, list<shared_pt
 
         // 1. Transmit characteristic polynomial values
         mySyncStats.timerStart(SyncStats::COMM_TIME);
-        commSync->commSend((long) CPI_hash.size()); // ... first outputs how many set elements the client has
+        commSync->commSend(_setSize()); // ... first outputs how many set elements the client has
         mySyncStats.timerEnd(SyncStats::COMM_TIME);
 
         // ... produce the values in a list:  [x1 x2 x3 ... ]
-        vec_ZZ_p valList;
-        for (int ii = 0; ii < currDiff; ii++)
-            append(valList, CPI_evals[ii]);
-        for (int ii = 0; ii < redundant_k; ii++)
-            append(valList, CPI_evals[currDiff + ii]);
+        vec_ZZ_p valList = getSketch();
 
         mySyncStats.timerStart(SyncStats::COMM_TIME);
         commSync->commSend(valList);
@@ -523,12 +482,87 @@ bool CPISync::SyncClient(const shared_ptr<Communicant>& commSync, list<shared_pt
     }
 }
 
+bool CPISync::_checkedReconcile(const long otherSetSize, const vec_ZZ_p& otherEvals, vec_ZZ_p& delta_self, vec_ZZ_p& delta_other) {
+    vec_ZZ_p meta_other, meta_self;
+    for (long ii = 0; ii < redundant_k; ii++) {
+            append(meta_other, otherEvals[currDiff + ii]);
+            append(meta_self, CPI_evals[currDiff + ii]);
+    }
+
+    bool succeed = set_reconcile(otherSetSize, otherEvals, delta_self, delta_other);
+    if (!succeed)
+        return false;
+
+    // PERFORM some added checks
+    const vec_ZZ_p& sampleLoc = samplePlan->samples();
+    // perform a check with the redundant data:  values[jj] *= prod_ii (sampleLoc[currDiff + jj] - roots[ii]),
+    // ... with the roots split across threads
+    auto checkRedundant = [&](vec_ZZ_p& values, const vec_ZZ_p& roots) {
+        vector<long> wordRoots; // the roots as word-sized residues, for the Montgomery kernels
+        if (wordField)
+            for (const auto& root : roots)
+                wordRoots.push_back(conv<long>(rep(root)));
+
+        std::mutex valuesMutex;
+        _parallelFor(roots.length(), [&](long begin, long end) {
+            vec_ZZ_p partial;
+            partial.SetLength(redundant_k);
+            for (long jj = 0; jj < redundant_k; jj++) {
+                if (wordField) {
+                    conv(partial[jj], montWord->prodSub(conv<long>(rep(sampleLoc[currDiff + jj])),
+                                                        wordRoots.data() + begin, end - begin));
+                    continue;
+                }
+                set(partial[jj]);
+                for (long ii = begin; ii < end; ii++)
+                    partial[jj] *= (sampleLoc[currDiff + jj] - roots[ii]);
+            }
+            std::lock_guard<std::mutex> lock(valuesMutex);
+            for (long jj = 0; jj < redundant_k; jj++)
+                values[jj] *= partial[jj];
+        }, PAR_GRAIN_BIG);
+    };
+    checkRedundant(meta_self, delta_other);
+    checkRedundant(meta_other, delta_self);
+
+    return meta_self == meta_other;
+}
+
+vec_ZZ_p CPISync::getSketch() {
+    refreshEvals();
+    vec_ZZ_p sketch;
+    sketch.SetLength(currDiff + redundant_k);
+    for (long ii = 0; ii < currDiff + redundant_k; ii++)
+        sketch[ii] = CPI_evals[ii];
+    return sketch;
+}
+
+bool CPISync::reconcileSketch(const long otherSetSize, const vec_ZZ_p& otherSketch, vec_ZZ_p& delta_self, vec_ZZ_p& delta_other) {
+    Logger::gLog(Logger::METHOD,"Entering CPISync::reconcileSketch");
+    if (otherSketch.length() != currDiff + redundant_k)
+        throw SyncFailureException("Sketch length does not match between the synchronizing parties.");
+    interpState.count = interpStateWord.count = 0; // a new sketch cannot reuse earlier interpolation
+    refreshEvals();
+    delta_self.kill();
+    delta_other.kill();
+    return _checkedReconcile(otherSetSize, otherSketch, delta_self, delta_other);
+}
+
+shared_ptr<DataObject> CPISync::hashToElement(const ZZ_p& hash) const {
+    if (!hashQ)
+        return _invHash(hash);
+    auto it = CPI_hash.find(rep(hash));
+    return it == CPI_hash.end() ? nullptr : it->second;
+}
+
 bool CPISync::SyncServer(const shared_ptr<Communicant>& commSync, list<shared_ptr<DataObject>>& selfMinusOther, list<shared_ptr<DataObject>>& otherMinusSelf) {
     Logger::gLog(Logger::METHOD,"Entering CPISync::SyncServer");
     mySyncStats.timerStart(SyncStats::COMP_TIME); //This is total sync time
 
     //Reset currDiff to 1 at the start of the sync so that the correct upper bound can be found if the dataset has changed
 	if(probCPI) currDiff = 1;
+    interpState.count = interpStateWord.count = 0; // evaluations from an earlier synchronization cannot be reused
+    refreshEvals();
 
 	string mystring;
     vector<long> self_hash;
@@ -570,69 +604,33 @@ bool CPISync::SyncServer(const shared_ptr<Communicant>& commSync, list<shared_pt
         delta_other.kill();
         delta_self.kill();
 
-        vec_ZZ_p meta_other, meta_self;
-        for (long ii = 0; ii < redundant_k; ii++) {
-                append(meta_other, recv_meta[currDiff + ii]);
-                append(meta_self, CPI_evals[currDiff + ii]);
-        }
-        
         // attempt to reconcile with the presumed number of differences
-        bool succeed = set_reconcile(otherSetSize, recv_meta, delta_self, delta_other);
-        if (succeed) { // the node reconciliation might have been successful
-            
-            // PERFORM some added checks
-            vec_ZZ_p value_self = meta_self;
-            vec_ZZ_p value_other = meta_other;
-            // perform a check with the redundant data
-            for (long jj = 0; jj < redundant_k; jj++) {
-                for (const auto &ii : delta_other) {
-                    //value_self[jj] *= (sampleLoc[maxDiff + jj] - delta_other[ii]);
-                     value_self[jj] *= (sampleLoc[currDiff + jj] - ii);
-                }
-            }
-
-            for (long jj = 0; jj < redundant_k; jj++) {
-                for (const auto &ii : delta_self) {
-                    //value_other[jj] *= (sampleLoc[maxDiff + jj] - delta_self[ii]);
-                    value_other[jj] *= (sampleLoc[currDiff + jj] - ii);
-                }
-            }
-
-            for (long jj = 0; jj < redundant_k; jj++) {
-                if (value_self[jj] != value_other[jj]) {
-                    succeed = false;
-                    break; // no need to keep going
-                }
-            }
-            value_other.kill();
-            value_self.kill();
-
-            if (succeed) { // only do this if reconciliation has succeeded
-                Logger::gLog(Logger::METHOD, "CPISync succeeded.\n");
+        bool succeed = _checkedReconcile(otherSetSize, recv_meta, delta_self, delta_other);
+        if (succeed) { // only do this if reconciliation has succeeded
+            Logger::gLog(Logger::METHOD, "CPISync succeeded.\n");
 
-                if (!oneWay) {
-                    mySyncStats.timerStart(SyncStats::COMM_TIME);
-                    commSync->commSend(SYNC_OK_FLAG); // sync succeeded
+            if (!oneWay) {
+                mySyncStats.timerStart(SyncStats::COMM_TIME);
+                commSync->commSend(SYNC_OK_FLAG); // sync succeeded
 					commSync->commSend(delta_self);
-                    commSync->commSend(delta_other);
-                    mySyncStats.timerEnd(SyncStats::COMM_TIME);
-                }
+                commSync->commSend(delta_other);
+                mySyncStats.timerEnd(SyncStats::COMM_TIME);
+            }
 
-                Logger::gLog(Logger::METHOD, string("... results:\n")
-                        + "   self - other =  " + toStr<vec_ZZ_p > (delta_self) + "\n"
-                        + "   other - self =  " + toStr<vec_ZZ_p > (delta_other) + "\n"
-                        + "\n");
+            Logger::gLog(Logger::METHOD, string("... results:\n")
+                    + "   self - other =  " + toStr<vec_ZZ_p > (delta_self) + "\n"
+                    + "   other - self =  " + toStr<vec_ZZ_p > (delta_other) + "\n"
+                    + "\n");
 
-                // create selfMinusOther and otherMinusSelf structures to report the result of reconciliation
-                try {
+            // create selfMinusOther and otherMinusSelf structures to report the result of reconciliation
+            try {
 					_makeStructures(commSync, selfMinusOther, otherMinusSelf, delta_self, delta_other);
-                } catch (SyncFailureException& s) {
-                    Logger::gLog(Logger::METHOD_DETAILS, s.what());
-                    throw (s);
-                }
-
-                break; // break out of the while loop - this has been settled
+            } catch (SyncFailureException& s) {
+                Logger::gLog(Logger::METHOD_DETAILS, s.what());
+                throw (s);
             }
+
+            break; // break out of the while loop - this has been settled
         }
 
         if (!succeed) { // if synchronization has failed for some reason
@@ -655,8 +653,6 @@ bool CPISync::SyncServer(const shared_ptr<Communicant>& commSync, list<shared_pt
                 currDiff = min(currDiff * 2, maxDiff);
             }
         }
-        meta_self.kill();
-        meta_other.kill();
     } while (result); //end of while	
 
 
@@ -679,16 +675,17 @@ bool CPISync::SyncServer(const shared_ptr<Communicant>& commSync, list<shared_pt
 
 void CPISync::sendAllElem(const shared_ptr<Communicant>& commSync, list<shared_ptr<DataObject>> &selfMinusOther) {
     Logger::gLog(Logger::METHOD,"Entering CPISync::sendAllElem");
-    commSync->commSend((long) CPI_hash.size()); // first send the size
+    commSync->commSend(_setSize()); // first send the size
 
     map< ZZ, shared_ptr<DataObject> >::iterator it;
     for (it = CPI_hash.begin();
             it != CPI_hash.end();
-            it++) {
-        commSync->commSend(*(it->second));
-        selfMinusOther.push_back(it->second);
-        Logger::gLog(Logger::COMM_DETAILS, "Sent all node elements.");
-    }
+            it++)
+        for (long copy = _multiplicity(it->first); copy > 0; copy--) {
+            commSync->commSend(*(it->second));
+            selfMinusOther.push_back(it->second);
+        }
+    Logger::gLog(Logger::COMM_DETAILS, "Sent all node elements.");
 }
 
 void CPISync::receiveAllElem(const shared_ptr<Communicant>& commSync, list<shared_ptr<DataObject>> &otherMinusSelf) {
@@ -715,9 +712,12 @@ ZZ_p CPISync::_makeData(const ZZ_p& num) const {
 }
 
 ZZ_p CPISync::_hash(const shared_ptr<DataObject>&datum) const {
+    if (hashQ)
+        return to_ZZ_p(elementHash(*datum)); // already reduced to bit_num bits
+
     ZZ num = datum->to_ZZ(); // convert the datum to a ZZ
 
-    if (!hashQ && (num >= DATA_MAX))
+    if (num >= DATA_MAX)
         Logger::error_and_quit("Cannot add element (" + datum->to_string() + ") "
             + " whose encoding (" + toStr(num) + ") is larger than  (" + toStr(DATA_MAX) + " - max field element) "
             + " when using nohash synchronization.  Please increase modulus to at least " + toStr(ceil(log(DATA_MAX + redundant_k) / log(2))) + " bit elements.");
@@ -729,18 +729,185 @@ ZZ_p CPISync::_hash2(const long num) const {
     return to_ZZ_p(to_ZZ(num)*101 % (DATA_MAX));
 }
 
+void CPISync::_updateEvals(const ZZ& root, bool add) {
+    if (wordField) {
+        wordContext.restore();
+        long *evals = rawResidues(CPI_evalsWord);
+        const long *samples = samplePlanWord->samplesMont().data();
+        long rootMont = montWord->toMont(conv<long>(root)), modulus = zz_p::modulus();
+        _parallelFor(CPI_evalsWord.length(), [&](long begin, long end) {
+            if (add)
+                montWord->mulSub(evals + begin, samples + begin, rootMont, end - begin);
+            else { // divide by the factors' batch inverse
+                vector<long> factors(samples + begin, samples + end);
+                for (auto& factor : factors)
+                    if ((factor -= rootMont) < 0)
+                        factor += modulus;
+                montWord->batchInv(factors.data(), end - begin);
+                montWord->mulSub(evals + begin, factors.data(), 0, end - begin);
+            }
+        }, PAR_GRAIN_WORD);
+    } else {
+        const vec_ZZ_p& sampleLoc = samplePlan->samples();
+        ZZ_p rootBig = to_ZZ_p(root);
+        _parallelFor(sampleLoc.length(), [&](long begin, long end) {
+            if (add)
+                for (long ii = begin; ii < end; ii++)
+                    CPI_evals[ii] *= (sampleLoc[ii] - rootBig);
+            else
+                for (long ii = begin; ii < end; ii++)
+                    CPI_evals[ii] /= (sampleLoc[ii] - rootBig);
+        }, PAR_GRAIN_BIG);
+    }
+}
+
+void CPISync::setThreadPool(shared_ptr<ThreadPool> pool) {
+#ifdef NTL_THREADS
+    threadPool = std::move(pool);
+#else
+    if (pool)
+        Logger::gLog(Logger::METHOD, "NTL was built without NTL_THREADS; CPISync will run on a single thread.");
+    threadPool = nullptr;
+#endif
+}
+
+void CPISync::setMultiset(bool multiset) {
+    if (!CPI_hash.empty()) {
+        Logger::error("The multiset mode can only be changed before elements are added.");
+        return;
+    }
+    multisetQ = multiset;
+}
+
+void CPISync::setHashType(HASH_TYPE type, uint64_t key /* = ElementHash::DFT_KEY */) {
+    if (!CPI_hash.empty()) {
+        Logger::error("The element hash can only be changed before elements are added.");
+        return;
+    }
+    elementHash = ElementHash(type, bitNum, key);
+}
+
+void CPISync::_parallelFor(long num, const function<void(long, long)>& body, long grain) {
+    if (!threadPool) {
+        body(0, num);
+        return;
+    }
+
+    // worker threads start out without the caller's moduli, and the caller may help with other loops' tasks,
+    // which install theirs; the guard puts the caller's back on return
+    FieldContextGuard callerContext;
+    threadPool->parallelFor(num, [&](long begin, long end) {
+        callerContext.restore();
+        if (wordField)
+            wordContext.restore();
+        body(begin, end);
+    }, grain);
+}
+
+template <class F>
+void CPISync::_mulRoots(typename F::Vec& evals, const CPITree<F>& sampleTree, const typename F::Vec& roots, bool divide) {
+    if (!threadPool) {
+        if (divide)
+            cpiDivRoots<F>(evals, sampleTree, roots);
+        else
+            cpiMulRoots<F>(evals, sampleTree, roots);
+        return;
+    }
+
+    // each thread multiplies out the factors of its own range of roots; field products do not depend on the order
+    long numSamples = evals.length();
+    typename F::Vec factors;
+    factors.SetLength(numSamples);
+    for (long ii = 0; ii < numSamples; ii++)
+        set(factors[ii]);
+    std::mutex factorsMutex;
+    _parallelFor(roots.length(), [&](long begin, long end) {
+        typename F::Vec block, partial;
+        block.SetLength(end - begin);
+        for (long ii = begin; ii < end; ii++)
+            block[ii - begin] = roots[ii];
+        partial.SetLength(numSamples);
+        for (long ii = 0; ii < numSamples; ii++)
+            set(partial[ii]);
+        cpiMulRoots<F>(partial, sampleTree, block);
+
+        std::lock_guard<std::mutex> lock(factorsMutex);
+        for (long ii = 0; ii < numSamples; ii++)
+            factors[ii] *= partial[ii];
+    }, numSamples);
+
+    if (divide)
+        cpiBatchInv<F>(factors);
+    for (long ii = 0; ii < numSamples; ii++)
+        evals[ii] *= factors[ii];
+}
+
 // update metadata when add an element
 
 bool CPISync::addElem(shared_ptr<DataObject> datum) {
     Logger::gLog(Logger::METHOD,"Entering CPISync::addElem");
-    int ii;
-    
+
     // call the parent class to take care of bookkeeping
     bool result = SyncMethod::addElem(datum);
 
     // put real data into the hash table
-    ZZ_p hashID;
     ZZ hashNum;
+    if (!_insertHash(datum, hashNum))
+        return false;
+    _updateEvals(hashNum, true);
+
+    Logger::gLog(Logger::METHOD_DETAILS, "... (CPISync) added item " + datum->to_string() + " with hash = " + toStr(hashNum));
+
+    return result;
+}
+
+bool CPISync::addElems(const list<shared_ptr<DataObject>>& data) {
+    Logger::gLog(Logger::METHOD,"Entering CPISync::addElems");
+
+    // 1. hash everything first, as addElem would
+    bool result = true;
+    vector<ZZ> hashNums;
+    hashNums.reserve(data.size());
+    for (const auto& datum : data) {
+        ZZ hashNum;
+        if (!_insertHash(datum, hashNum)) {
+            result = false;
+            continue;
+        }
+        SyncMethod::addElem(datum);
+        hashNums.push_back(hashNum);
+    }
+
+    // 2. multiply all the new roots into the characteristic polynomial evaluations at once
+    if (wordField) {
+        wordContext.restore();
+        vec_zz_p roots;
+        roots.SetLength(hashNums.size());
+        for (size_t ii = 0; ii < hashNums.size(); ii++)
+            conv(roots[ii], hashNums[ii]);
+        _mulRoots<WordField>(CPI_evalsWord, *samplePlanWord->tree(CPI_evalsWord.length()), roots, false);
+    } else {
+        vec_ZZ_p roots;
+        roots.SetLength(hashNums.size());
+        for (size_t ii = 0; ii < hashNums.size(); ii++)
+            conv(roots[ii], hashNums[ii]);
+        _mulRoots<BigField>(CPI_evals, *samplePlan->tree(CPI_evals.length()), roots, false);
+    }
+
+    Logger::gLog(Logger::METHOD_DETAILS, "... (CPISync) added " + toStr(hashNums.size()) + " items");
+    return result;
+}
+
+bool CPISync::_insertHash(const shared_ptr<DataObject>& datum, ZZ& hashNum) {
+    if (multisetQ) { // every copy shares its hash; only the first is kept in CPI_hash
+        hashNum = rep(_hash(datum));
+        CPI_hash.emplace(hashNum, datum);
+        CPI_copies[hashNum].emplace(datum.get(), datum);
+        CPI_revHash.emplace(datum.get(), hashNum);
+        return true;
+    }
+
+    ZZ_p hashID;
     int count = 0;
     do {
         if (hashQ) {
@@ -763,13 +930,27 @@ bool CPISync::addElem(shared_ptr<DataObject> datum) {
     }
 
     CPI_hash[hashNum] = datum;
+    CPI_revHash.emplace(datum.get(), hashNum);
+    return true;
+}
 
-    for (ii = 0; ii < sampleLoc.length(); ii++)
-        CPI_evals[ii] *= (sampleLoc[ii] - hashID);
-
-    Logger::gLog(Logger::METHOD_DETAILS, "... (CPISync) added item " + datum->to_string() + " with hash = " + toStr(hashNum));
-
-    return result;
+void CPISync::_eraseHashes(const shared_ptr<DataObject>& datum, vector<ZZ>& hashNums) {
+    auto range = CPI_revHash.equal_range(datum.get());
+    for (auto itr = range.first; itr != range.second; ++itr) {
+        if (!multisetQ)
+            CPI_hash.erase(itr->second);
+        else {
+            auto copies = CPI_copies.find(itr->second);
+            copies->second.erase(copies->second.find(datum.get()));
+            if (copies->second.empty()) { // the last copy of the hash
+                CPI_hash.erase(itr->second);
+                CPI_copies.erase(copies);
+            } else if (CPI_hash[itr->second].get() == datum.get()) // the copy kept in CPI_hash; keep another instead
+                CPI_hash[itr->second] = copies->second.begin()->second;
+        }
+        hashNums.push_back(itr->second);
+    }
+    CPI_revHash.erase(range.first, range.second);
 }
 
 // update metadata when delete an element by index
@@ -782,32 +963,281 @@ bool CPISync::delElem(shared_ptr<DataObject> newDatum) {
 	return false;
     }
 
-    ZZ_p hashID;
-    // remove data from the hash table. to find the value, a linear search is required
-	auto itr = CPI_hash.begin();
-	while (itr != CPI_hash.end()) {
-		if (itr->second == newDatum) {
-			hashID = to_ZZ_p(itr->first);
-			CPI_hash.erase(itr++);
-		} else {
-			++itr;
-		}
-	}
-
-		// update cpi evals
-    for(int ii = 0; ii < sampleLoc.length(); ii++) {
-        CPI_evals[ii] /= (sampleLoc[ii] - hashID);
-    }
+    // remove data from the hash table, using the reverse index to find its hash(es)
+    vector<ZZ> hashNums;
+    _eraseHashes(newDatum, hashNums);
+
+    // update cpi evals
+    for (const ZZ& hashNum : hashNums)
+        _updateEvals(hashNum, false);
 
     Logger::gLog(Logger::METHOD_DETAILS, "... (CPISync) removed item " + newDatum->print() + ".");
     return true;
 }
 
+bool CPISync::delElems(const list<shared_ptr<DataObject>>& data) {
+    Logger::gLog(Logger::METHOD, "Entering CPISync::delElems");
+
+    // 1. bookkeeping and hash table removal, as delElem does
+    bool result = true;
+    vector<ZZ> hashNums;
+    for (const auto& datum : data) {
+        if (!SyncMethod::delElem(datum)) {
+            Logger::error("Couldn't find " + datum->to_string() + ".");
+            result = false;
+            continue;
+        }
+        _eraseHashes(datum, hashNums);
+    }
+
+    // 2. divide all the removed roots out of the characteristic polynomial evaluations at once
+    if (wordField) {
+        wordContext.restore();
+        vec_zz_p roots;
+        roots.SetLength(hashNums.size());
+        for (size_t ii = 0; ii < hashNums.size(); ii++)
+            conv(roots[ii], hashNums[ii]);
+        _mulRoots<WordField>(CPI_evalsWord, *samplePlanWord->tree(CPI_evalsWord.length()), roots, true);
+    } else {
+        vec_ZZ_p roots;
+        roots.SetLength(hashNums.size());
+        for (size_t ii = 0; ii < hashNums.size(); ii++)
+            conv(roots[ii], hashNums[ii]);
+        _mulRoots<BigField>(CPI_evals, *samplePlan->tree(CPI_evals.length()), roots, true);
+    }
+
+    Logger::gLog(Logger::METHOD_DETAILS, "... (CPISync) removed " + toStr(hashNums.size()) + " items");
+    return result;
+}
+
+// snapshots
+// ... layout (all integers little-endian; field elements are stored in the fixed width of the field modulus):
+//      magic | version | dataChecksum | bitNum | maxDiff | redundant_k | hashQ + 2 multisetQ | hash type | hash key
+//      | width | fieldSize
+//      | #samples | sampleLoc... | CPI_evals... | #elements | hashes (in the order given to saveSnapshot)... | checksum
+namespace {
+    const char SNAPSHOT_MAGIC[8] = {'C', 'P', 'I', 'S', 'N', 'A', 'P', '\0'};
+    const uint64_t SNAPSHOT_VERSION = 2;
+
+    void putU64(string& buf, uint64_t num) {
+        for (int ii = 0; ii < 8; ii++)
+            buf += (char) ((num >> (8 * ii)) & 0xFF);
+    }
+
+    void putZZ(string& buf, const ZZ& num, long width) {
+        size_t start = buf.size();
+        buf.resize(start + width);
+        BytesFromZZ((unsigned char *) &buf[start], num, width);
+    }
+
+    /**
+     * Reads from a memory-mapped snapshot, refusing to read past its end.
+     */
+    class SnapshotReader {
+    public:
+        SnapshotReader(const unsigned char *data, size_t len) : pos(data), end(data + len) {}
+
+        bool getU64(uint64_t& num) {
+            if (end - pos < 8)
+                return false;
+            num = 0;
+            for (int ii = 7; ii >= 0; ii--)
+                num = (num << 8) | pos[ii];
+            pos += 8;
+            return true;
+        }
+
+        bool getZZ(ZZ& num, long width) {
+            if (end - pos < width)
+                return false;
+            ZZFromBytes(num, pos, width);
+            pos += width;
+            return true;
+        }
+
+        bool getBytes(const unsigned char *&bytes, size_t len) {
+            if ((size_t) (end - pos) < len)
+                return false;
+            bytes = pos;
+            pos += len;
+            return true;
+        }
+
+        const unsigned char *position() const { return pos; }
+
+    private:
+        const unsigned char *pos, *end;
+    };
+}
+
+bool CPISync::saveSnapshot(const string& snapFile, const list<shared_ptr<DataObject>>& order, uint64_t dataChecksum) {
+    Logger::gLog(Logger::METHOD, "Entering CPISync::saveSnapshot");
+    if ((long) order.size() != getNumElem() || (long) order.size() != _setSize()) {
+        Logger::error("Cannot snapshot: the supplied elements do not match the stored hash index.");
+        return false;
+    }
+    refreshEvals();
+
+    long width = NumBytes(fieldSize);
+    string buf(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    putU64(buf, SNAPSHOT_VERSION);
+    putU64(buf, dataChecksum);
+    putU64(buf, (uint64_t) bitNum);
+    putU64(buf, (uint64_t) maxDiff);
+    putU64(buf, (uint64_t) redundant_k);
+    putU64(buf, (hashQ ? 1 : 0) | (multisetQ ? 2 : 0));
+    putU64(buf, (uint64_t) elementHash.type());
+    putU64(buf, elementHash.key());
+    putU64(buf, (uint64_t) width);
+    putZZ(buf, fieldSize, width);
+
+    const vec_ZZ_p& sampleLoc = samplePlan->samples();
+    putU64(buf, (uint64_t) sampleLoc.length());
+    for (long ii = 0; ii < sampleLoc.length(); ii++)
+        putZZ(buf, rep(sampleLoc[ii]), width);
+    for (long ii = 0; ii < CPI_evals.length(); ii++)
+        putZZ(buf, rep(CPI_evals[ii]), width);
+
+    // hash index, in the given order; an element stored more than once takes its hashes in turn
+    putU64(buf, (uint64_t) order.size());
+    map<const DataObject *, long> used;
+    for (const auto& datum : order) {
+        auto range = CPI_revHash.equal_range(datum.get());
+        auto itr = range.first;
+        for (long skip = used[datum.get()]++; skip > 0 && itr != range.second; skip--)
+            ++itr;
+        if (itr == range.second) {
+            Logger::error("Cannot snapshot: element " + datum->to_string() + " has no hash.");
+            return false;
+        }
+        putZZ(buf, itr->second, width);
+    }
+    putU64(buf, fnv1a64(buf.data(), buf.size()));
+
+    std::ofstream out(snapFile.c_str(), std::ios::binary | std::ios::trunc);
+    out.write(buf.data(), buf.size());
+    out.close();
+    return out.good();
+}
+
+bool CPISync::loadSnapshot(const string& snapFile, const list<shared_ptr<DataObject>>& order, uint64_t dataChecksum) {
+    Logger::gLog(Logger::METHOD, "Entering CPISync::loadSnapshot");
+    if (!CPI_hash.empty() || getNumElem() != 0)
+        return false; // only an empty object can be restored
+
+    // map the snapshot
+    int fd = open(snapFile.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat fileStat{};
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size < (off_t) (sizeof(SNAPSHOT_MAGIC) + 8)) {
+        close(fd);
+        return false;
+    }
+    auto len = (size_t) fileStat.st_size;
+    void *mapped = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED)
+        return false;
+    auto *data = (const unsigned char *) mapped;
+
+    // validate and decode, without touching this object
+    const vec_ZZ_p& sampleLoc = samplePlan->samples();
+    bool valid = false;
+    vec_ZZ_p snapSamples, snapEvals;
+    vector<ZZ> hashNums;
+    do {
+        SnapshotReader reader(data, len - 8);
+        SnapshotReader trailer(data + len - 8, 8);
+        uint64_t checksum, version, snapDataChecksum, snapBits, snapMaxDiff, snapRedundant, snapHashQ, snapHashType,
+                snapHashKey, width, numSamples, numElems;
+        const unsigned char *magic;
+        ZZ snapField, num;
+
+        if (!trailer.getU64(checksum) || checksum != fnv1a64((const char *) data, len - 8))
+            break;
+        if (!reader.getBytes(magic, sizeof(SNAPSHOT_MAGIC)) || memcmp(magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0)
+            break;
+        if (!reader.getU64(version) || version != SNAPSHOT_VERSION)
+            break;
+        if (!reader.getU64(snapDataChecksum) || snapDataChecksum != dataChecksum) {
+            Logger::gLog(Logger::METHOD, "Snapshot " + snapFile + " does not match its data; ignoring it.");
+            break;
+        }
+        if (!reader.getU64(snapBits) || !reader.getU64(snapMaxDiff) || !reader.getU64(snapRedundant) ||
+            !reader.getU64(snapHashQ) || !reader.getU64(snapHashType) || !reader.getU64(snapHashKey) ||
+            !reader.getU64(width) ||
+            !reader.getZZ(snapField, (long) width) || !reader.getU64(numSamples))
+            break;
+        if ((long) snapBits != bitNum || (long) snapMaxDiff != maxDiff || (int) snapRedundant != redundant_k ||
+            snapHashQ != (uint64_t) ((hashQ ? 1 : 0) | (multisetQ ? 2 : 0)) ||
+            snapHashType != (uint64_t) elementHash.type() || snapHashKey != elementHash.key() || snapField != fieldSize || (long) numSamples != sampleLoc.length()) {
+            Logger::gLog(Logger::METHOD, "Snapshot " + snapFile + " was made with different parameters; ignoring it.");
+            break;
+        }
+
+        bool decoded = true;
+        snapSamples.SetLength(numSamples);
+        snapEvals.SetLength(numSamples);
+        for (long ii = 0; decoded && ii < (long) numSamples; ii++)
+            if ((decoded = reader.getZZ(num, (long) width)))
+                conv(snapSamples[ii], num);
+        for (long ii = 0; decoded && ii < (long) numSamples; ii++)
+            if ((decoded = reader.getZZ(num, (long) width)))
+                conv(snapEvals[ii], num);
+        if (!decoded || snapSamples != sampleLoc || !reader.getU64(numElems) || numElems != order.size())
+            break;
+
+        hashNums.resize(numElems);
+        for (size_t ii = 0; decoded && ii < numElems; ii++)
+            decoded = reader.getZZ(hashNums[ii], (long) width);
+        valid = decoded && reader.position() == data + len - 8;
+    } while (false);
+    munmap(mapped, len);
+    if (!valid)
+        return false;
+
+    // restore the hash index (hashes must be distinct, except for the copies of the multiset mode) ...
+    map<ZZ, shared_ptr<DataObject> > snapHash;
+    map<ZZ, unordered_multimap<const DataObject*, shared_ptr<DataObject> > > snapCopies;
+    auto itHash = hashNums.begin();
+    for (const auto& datum : order) {
+        snapHash.emplace(*itHash, datum);
+        if (multisetQ)
+            snapCopies[*itHash].emplace(datum.get(), datum);
+        ++itHash;
+    }
+    if (!multisetQ && snapHash.size() != hashNums.size())
+        return false;
+
+    CPI_hash.swap(snapHash);
+    CPI_copies.swap(snapCopies);
+    itHash = hashNums.begin();
+    for (const auto& datum : order) {
+        SyncMethod::addElem(datum);
+        CPI_revHash.emplace(datum.get(), *itHash++);
+    }
+
+    // ... and the sketch (sample locations are shared, and were checked above)
+    CPI_evals = snapEvals;
+    if (wordField) {
+        wordContext.restore();
+        convField(CPI_evalsWord, CPI_evals);
+    }
+
+    Logger::gLog(Logger::METHOD_DETAILS, "... (CPISync) restored " + toStr(order.size()) + " items from " + snapFile);
+    return true;
+}
+
 string CPISync::printElem() {
     stringstream result("");
 
     map< ZZ, shared_ptr<DataObject> >::iterator it;
-    for (it = CPI_hash.begin(); it != CPI_hash.end(); it++)
-        result << (it->second)->to_string() << " [hash=" << (it->first) << "], ";
+    for (it = CPI_hash.begin(); it != CPI_hash.end(); it++) {
+        result << (it->second)->to_string() << " [hash=" << (it->first);
+        if (multisetQ)
+            result << " x" << _multiplicity(it->first);
+        result << "], ";
+    }
     return result.str();
 }
\ No newline at end of file
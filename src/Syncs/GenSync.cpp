@@ -1,7 +1,9 @@
 /* This code is part of the CPISync project developed at Boston University.  Please see the README for use and references. */
 
+#include <cstdio>
 #include <iostream>
 #include <fstream>
+#include <unordered_set>
 
 #include <CPISync/Syncs/GenSync.h>
 #include <CPISync/Aux/Exceptions.h>
@@ -20,6 +22,28 @@
 
 using namespace std::chrono;
 
+namespace {
+    /**
+     * @return str as a JSON string literal.
+     */
+    string jsonString(const string& str) {
+        string result = "\"";
+        for (char ch : str) {
+            if (ch == '"' || ch == '\\')
+                result += string("\\") + ch;
+            else if (ch == '\n')
+                result += "\\n";
+            else if ((unsigned char) ch < 0x20) {
+                char escaped[8];
+                snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char) ch);
+                result += escaped;
+            } else
+                result += ch;
+        }
+        return result + "\"";
+    }
+}
+
 /**
  * Construct a default GenSync object - communicants and objects will have to be added later
  */
@@ -39,26 +63,42 @@ GenSync::GenSync(
     outFile = nullptr; // no output file is being used
     _PostProcessing = postProcessing;
 
-    // add each datum one by one
-    auto itData = data.begin();
-    for (; itData != data.end(); itData++)
-        addElem(*itData);
+    // add the data as one batch
+    addElems(data);
 }
 
 GenSync::GenSync(const vector<shared_ptr<Communicant>> &cVec, const vector<shared_ptr<SyncMethod>> &mVec, const string& fileName) {
     myCommVec = cVec;
     mySyncVec = mVec;
     outFile = nullptr; // add elements without writing to the file at first
+    dataFileName = fileName;
     Logger::gLog(Logger::METHOD, "Entering GenSync::GenSync");
     // read data from a file
     Logger::gLog(Logger::METHOD, "Utilizing file: " + fileName);
-    ifstream inFile(fileName.c_str());
+    ifstream inFile(fileName.c_str(), ios::binary);
+    stringstream contents;
+    contents << inFile.rdbuf();
+    inFile.close();
+    const string fileBytes = contents.str();
+    uint64_t checksum = fnv1a64(fileBytes.data(), fileBytes.size());
+
+    istringstream lines(fileBytes);
     string str;
-    for (getline(inFile, str); inFile.good(); getline(inFile, str)) {
-        addElem(make_shared<DataObject>(str)); // add this datum to our list
-        Logger::gLog(Logger::METHOD_DETAILS, "... added set element " + str);
+    list<shared_ptr<DataObject>> fileData;
+    for (getline(lines, str); lines.good(); getline(lines, str)) {
+        fileData.push_back(make_shared<DataObject>(str)); // add this datum to our list
+        Logger::gLog(Logger::METHOD_DETAILS, "... read set element " + str);
+    }
+    myData = fileData;
+
+    // populate each sync method, from its snapshot if it has a valid one
+    for (size_t ii = 0; ii < mySyncVec.size(); ii++) {
+        auto cpi = dynamic_pointer_cast<CPISync>(mySyncVec[ii]);
+        if (cpi && cpi->loadSnapshot(_snapshotName(fileName, ii), fileData, checksum))
+            continue;
+        if (!mySyncVec[ii]->addElems(fileData))
+            Logger::error_and_quit("Could not add all items from " + fileName + ".  Please considering increasing the number of bits per set element.");
     }
-    inFile.close();
 
     // register the file to which new data should be appended
     outFile = std::make_shared<ofstream>(fileName.c_str(), ios::app);
@@ -111,6 +151,53 @@ void GenSync::addElem(shared_ptr<DataObject> newDatum) {
 		(*outFile) << newDatum->to_string() << endl;
 }
 
+// add a batch of elements
+void GenSync::addElems(const list<shared_ptr<DataObject>>& newData) {
+	Logger::gLog(Logger::METHOD, "Entering GenSync::addElems");
+	// store locally
+	myData.insert(myData.end(), newData.begin(), newData.end());
+
+	// update sync methods' metadata
+	for (const auto& itAgt : mySyncVec) {
+		if (!itAgt->addElems(newData))
+			Logger::error_and_quit("Could not add all " + toStr(newData.size()) + " items.  Please considering increasing the number of bits per set element.");
+	}
+
+	// update file
+	if (outFile != nullptr)
+		for (const auto& datum : newData)
+			(*outFile) << datum->to_string() << endl;
+}
+
+// snapshot the data and sketches
+bool GenSync::saveSnapshot() {
+	Logger::gLog(Logger::METHOD, "Entering GenSync::saveSnapshot");
+	if (dataFileName.empty()) {
+		Logger::error("Only a GenSync constructed from a data file can be snapshot.");
+		return false;
+	}
+
+	// rewrite the data file with exactly the current data
+	outFile->close();
+	string fileBytes;
+	for (const auto& datum : myData)
+		fileBytes += datum->to_string() + "\n";
+	ofstream rewrite(dataFileName.c_str(), ios::binary | ios::trunc);
+	rewrite.write(fileBytes.data(), fileBytes.size());
+	rewrite.close();
+	outFile = std::make_shared<ofstream>(dataFileName.c_str(), ios::app);
+	bool success = rewrite.good();
+
+	// snapshot each CPISync-based method against the new contents
+	uint64_t checksum = fnv1a64(fileBytes.data(), fileBytes.size());
+	for (size_t ii = 0; ii < mySyncVec.size(); ii++) {
+		auto cpi = dynamic_pointer_cast<CPISync>(mySyncVec[ii]);
+		if (cpi && !cpi->saveSnapshot(_snapshotName(dataFileName, ii), myData, checksum))
+			success = false;
+	}
+	return success;
+}
+
 // delete element
 bool GenSync::delElem(shared_ptr<DataObject> delPtr) {
 	Logger::gLog(Logger::METHOD, "Entering GenSync::delElem");
@@ -134,16 +221,53 @@ bool GenSync::delElem(shared_ptr<DataObject> delPtr) {
 	}
 }
 
-//Call delete elements on all data
-bool GenSync::clearData(){
-	bool success = true;
+// delete a batch of elements
+bool GenSync::delElems(const list<shared_ptr<DataObject>>& delData) {
+	Logger::gLog(Logger::METHOD, "Entering GenSync::delElems");
+	if (myData.empty()) {
+		Logger::error("genSync is empty");
+		return false;
+	}
 
-	auto itr = myData.begin();
-	while (itr != myData.end()) {
-		success &= delElem(*itr++);
+	//Check that every element is present before changing anything, since a sync's delElems removes what it can find
+	unordered_multiset<const DataObject*> present;
+	for (const auto& datum : myData)
+		present.insert(datum.get());
+	for (const auto& datum : delData) {
+		auto found = present.find(datum.get());
+		if (found == present.end()) {
+			Logger::error("Error deleting items. " + datum->to_string() + " is not present");
+			return false;
+		}
+		present.erase(found);
+	}
+
+	//Iterate through mySyncVec and call that sync's delElems method
+	bool success = true;
+	for (const auto& itAgt : mySyncVec) {
+		if (!itAgt->delElems(delData)) {
+			Logger::error("Error deleting items. SyncVec delete failed ");
+			success = false;
+		}
 	}
 
-	return success && myData.empty();
+	//Remove data from GenSync object meta-data in one pass, even if a sync failed, so that it still matches the
+	//syncs, and report success of delete
+	unordered_set<const DataObject*> toRemove;
+	for (const auto& datum : delData)
+		toRemove.insert(datum.get());
+	unsigned long before = myData.size();
+	myData.remove_if([&toRemove](const shared_ptr<DataObject>& datum) { return toRemove.count(datum.get()) > 0; });
+	return success && myData.size() < before;
+}
+
+//Call delete elements on all data
+bool GenSync::clearData(){
+	if (myData.empty())
+		return true;
+
+	list<shared_ptr<DataObject>> allData(myData);
+	return delElems(allData) && myData.empty();
 }
 
 const list<string> GenSync::dumpElements() {
@@ -198,10 +322,8 @@ int GenSync::numComm() {
 void GenSync::addSyncAgt(const shared_ptr<SyncMethod>& newAgt, int index) {
 	Logger::gLog(Logger::METHOD, "Entering GenSync::addSyncAgt");
 	// create and populate the new agent
-	list<shared_ptr<DataObject>>::iterator itData;
-	for (itData = myData.begin(); itData != myData.end(); itData++)
-		if (!newAgt->addElem(*itData))
-			Logger::error_and_quit("Was not able to add an item to the next syncagent.");
+	if (!newAgt->addElems(myData))
+		Logger::error_and_quit("Was not able to add an item to the next syncagent.");
 
 	// add the agent to the sync agents vector
 	auto idxIter = mySyncVec.begin();
@@ -329,9 +451,46 @@ string GenSync::printStats(int syncIndex) const{
     returnStream << "Idle Time(s): " << getIdleTime(syncIndex) << endl;
     returnStream << "Computation Time(s): " <<  getCompTime(syncIndex) << endl;
 
+    // ... InterCPISync also breaks its sync down by depth of its tree
+    if (auto interCpi = dynamic_pointer_cast<InterCPISync>(mySyncVec[syncIndex])) {
+        returnStream << "Round Trips: " << interCpi->getRoundTrips() << endl;
+        const vector<InterCPISync::DepthStats>& depths = interCpi->getDepthStats();
+        for (size_t depth = 0; depth < depths.size(); depth++)
+            returnStream << "Depth " << depth << ": " << depths[depth].visited << " nodes visited, "
+                         << depths[depth].failed << " failed, " << depths[depth].xmitBytes << " bytes transmitted, "
+                         << depths[depth].recvBytes << " bytes received, interpolation time(s) " << depths[depth].interpTime
+                         << ", root finding time(s) " << depths[depth].rootTime << endl;
+    }
+
 	return returnStream.str();
 }
 
+string GenSync::getStatsJSON(int syncIndex) const {
+    stringstream json;
+    json << "{\"protocol\": " << jsonString(mySyncVec[syncIndex]->getName())
+         << ", \"xmitBytes\": " << getXmitBytes(syncIndex)
+         << ", \"recvBytes\": " << getRecvBytes(syncIndex)
+         << ", \"commTime\": " << getCommTime(syncIndex)
+         << ", \"idleTime\": " << getIdleTime(syncIndex)
+         << ", \"compTime\": " << getCompTime(syncIndex);
+
+    if (auto interCpi = dynamic_pointer_cast<InterCPISync>(mySyncVec[syncIndex])) {
+        json << ", \"roundTrips\": " << interCpi->getRoundTrips() << ", \"depths\": [";
+        const vector<InterCPISync::DepthStats>& depths = interCpi->getDepthStats();
+        for (size_t depth = 0; depth < depths.size(); depth++)
+            json << (depth == 0 ? "" : ", ") << "{\"depth\": " << depth
+                 << ", \"visited\": " << depths[depth].visited
+                 << ", \"failed\": " << depths[depth].failed
+                 << ", \"xmitBytes\": " << depths[depth].xmitBytes
+                 << ", \"recvBytes\": " << depths[depth].recvBytes
+                 << ", \"interpTime\": " << depths[depth].interpTime
+                 << ", \"rootTime\": " << depths[depth].rootTime << "}";
+        json << "]";
+    }
+    json << "}";
+    return json.str();
+}
+
 int GenSync::getPort(int commIndex) {
     // null iff comm isn't a CommSocket
     if (auto cs = dynamic_cast<CommSocket*>(myCommVec[commIndex].get())) {
@@ -419,6 +578,29 @@ GenSync GenSync::Builder::build() {
         default:
             throw invalid_argument("I don't know how to synchronize with this protocol.");
     }
+
+    // CPISync-based protocols share the choice of interpolation engine, root finder, threads and element hash;
+    // IBLT-based ones use the threads to build their IBLTs
+    shared_ptr<ThreadPool> pool = numThreads == 1 ? nullptr : make_shared<ThreadPool>(numThreads);
+    if (auto cpi = dynamic_pointer_cast<CPISync>(myMeth)) {
+        cpi->setInterpType(interpType);
+        cpi->setRootType(rootType);
+        cpi->setThreadPool(pool);
+        cpi->setMultiset(multiset);
+        cpi->setHashType(hashType);
+    } else if (auto interCpi = dynamic_pointer_cast<InterCPISync>(myMeth)) {
+        interCpi->setInterpType(interpType);
+        interCpi->setRootType(rootType);
+        interCpi->setThreadPool(pool);
+        interCpi->setCompactTree(compactTree);
+        interCpi->setBatchedLevels(batchedLevels);
+        interCpi->setAdaptiveFanout(adaptiveFanout);
+        interCpi->setHashType(hashType);
+    } else if (auto iblt = dynamic_pointer_cast<IBLTSync>(myMeth)) {
+        iblt->setThreadPool(pool);
+    } else if (auto ibltMultiset = dynamic_pointer_cast<IBLTSync_Multiset>(myMeth)) {
+        ibltMultiset->setThreadPool(pool);
+    }
     theMeths.push_back(myMeth);
 
     if (fileName.isNullQ()) // is data to be drawn from a file?
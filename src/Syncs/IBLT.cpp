@@ -7,7 +7,10 @@
 // * Eppstein, David, et al. "What's the difference?: efficient set reconciliation without prior context." ACM SIGCOMM Computer Communication Review 41.4 (2011): 218-229.
 //
 
+#include <algorithm>
+#include <mutex>
 #include <CPISync/Syncs/IBLT.h>
+#include <CPISync/Aux/ElementHash.h>
 
 IBLT::IBLT() = default;
 IBLT::~IBLT() = default;
@@ -23,14 +26,33 @@ IBLT::IBLT(size_t expectedNumEntries, size_t _valueSize)
 }
 
 hash_t IBLT::_hash(const hash_t& initial, long kk) {
-    if(kk == -1) return initial;
-    std::hash<std::string> shash;
-    return _hash(shash(toStr(initial)), kk-1);
+    unsigned char bytes[sizeof(hash_t)];
+    for (size_t ii = 0; ii < sizeof(hash_t); ii++)
+        bytes[ii] = (unsigned char) (initial >> (8 * ii));
+    return ElementHash::hash64(bytes, sizeof(hash_t), IBLT_HASH_SEED + kk);
 }
 
 hash_t IBLT::_hashK(const ZZ &item, long kk) {
-    std::hash<std::string> shash; // stl uses MurmurHashUnaligned2 for calculating the hash of a string
-    return _hash(shash(toStr(item)), kk-1);
+    // keys are mostly short, so their bytes are put on the stack unless they do not fit
+    const long STACK_BYTES = 64;
+    unsigned char stackBytes[STACK_BYTES];
+    vector<unsigned char> heapBytes;
+    long len = NumBytes(item);
+    unsigned char *bytes = stackBytes;
+    if (len > STACK_BYTES) {
+        heapBytes.resize(len);
+        bytes = heapBytes.data();
+    }
+    BytesFromZZ(bytes, item, len);
+
+    // BytesFromZZ drops the sign, so that goes into the seed
+    if (sign(item) < 0)
+        return ElementHash::hash64(bytes, len, ~(IBLT_HASH_SEED + kk));
+    return _hashBytes(bytes, len, kk);
+}
+
+hash_t IBLT::_hashBytes(const unsigned char *bytes, size_t len, long kk) {
+    return ElementHash::hash64(bytes, len, IBLT_HASH_SEED + kk);
 }
 
 hash_t IBLT::_setHash(multiset<shared_ptr<DataObject>> &tarSet)
@@ -43,7 +65,7 @@ hash_t IBLT::_setHash(multiset<shared_ptr<DataObject>> &tarSet)
     return outHash;
 }
 
-void IBLT::_insert(long plusOrMinus, ZZ key, ZZ value) {
+void IBLT::_insert(long plusOrMinus, ZZ key, ZZ value, size_t *cells) {
     long bucketsPerHash = hashTable.size() / N_HASH;
 
     if(sizeof(value) != valueSize) {
@@ -51,14 +73,18 @@ void IBLT::_insert(long plusOrMinus, ZZ key, ZZ value) {
                                + toStr(sizeof(value)) + ". IBLT value size: " + toStr(valueSize));
     }
 
+    // the hash-check is the same in every cell of key
+    hash_t check = _hashK(key, N_HASHCHECK);
     for(int ii=0; ii < N_HASH; ii++){
         hash_t hk = _hashK(key, ii);
         long startEntry = ii * bucketsPerHash;
         IBLT::HashTableEntry& entry = hashTable.at(startEntry + (hk%bucketsPerHash));
+        if (cells != nullptr)
+            cells[ii] = startEntry + (hk%bucketsPerHash);
 
         entry.count += plusOrMinus;
         entry.keySum ^= key;
-        entry.keyCheck ^= _hashK(key, N_HASHCHECK);
+        entry.keyCheck ^= check;
         if (entry.empty()) {
             entry.valueSum.kill();
         }
@@ -68,6 +94,52 @@ void IBLT::_insert(long plusOrMinus, ZZ key, ZZ value) {
     }
 }
 
+long IBLT::_peel(vector<pair<ZZ, ZZ>> &positive, vector<pair<ZZ, ZZ>> &negative, const ZZ *found,
+                 vector<pair<size_t, HashTableEntry>> *undo) {
+    // the pure cells to start from; a cell may be queued more than once, or stop being pure before its turn
+    vector<size_t> pure;
+    for (size_t cell = 0; cell < hashTable.size(); cell++) {
+        if (hashTable[cell].isPure())
+            pure.push_back(cell);
+    }
+
+    size_t cells[N_HASH];
+    while (!pure.empty()) {
+        size_t cell = pure.back();
+        pure.pop_back();
+        IBLT::HashTableEntry& entry = hashTable[cell];
+        if (!entry.isPure())
+            continue;
+        if (found != nullptr && entry.keySum == *found)
+            return (long) cell;
+
+        // the entry changes with its own removal
+        long count = entry.count;
+        ZZ key = entry.keySum, value = entry.valueSum;
+        if (count == 1)
+            positive.emplace_back(key, value);
+        else
+            negative.emplace_back(key, value);
+
+        if (undo != nullptr) {
+            // the cells of key, before they change
+            long bucketsPerHash = hashTable.size() / N_HASH;
+            for (long ii = 0; ii < N_HASH; ii++) {
+                size_t keyCell = ii * bucketsPerHash + _hashK(key, ii) % bucketsPerHash;
+                undo->emplace_back(keyCell, hashTable[keyCell]);
+            }
+        }
+        _insert(-count, key, value, cells);
+
+        // only the cells just changed can have become pure
+        for (size_t changed : cells) {
+            if (hashTable[changed].isPure())
+                pure.push_back(changed);
+        }
+    }
+    return -1;
+}
+
 void IBLT::insert(ZZ key, ZZ value)
 {
     _insert(1, key, value);
@@ -78,6 +150,38 @@ void IBLT::erase(ZZ key, ZZ value)
     _insert(-1, key, value);
 }
 
+void IBLT::insert(const vector<pair<ZZ, ZZ>> &pairs, ThreadPool *pool)
+{
+#ifndef NTL_THREADS
+    pool = nullptr; // ZZs may only be used from several threads if NTL was built with NTL_THREADS
+#endif
+    if (pool == nullptr) {
+        for (const auto& item : pairs)
+            _insert(1, item.first, item.second);
+        return;
+    }
+
+    // a private IBLT per range of pairs, each range at least as long as the table, so that building a private IBLT
+    // is worth more than adding it in
+    vector<IBLT> shards;
+    std::mutex shardsMtx;
+    pool->parallelFor((long) pairs.size(), [&](long begin, long end) {
+        IBLT shard;
+        shard.valueSize = valueSize;
+        shard.hashTable.resize(hashTable.size());
+        for (long ii = begin; ii < end; ii++)
+            shard._insert(1, pairs[ii].first, pairs[ii].second);
+
+        std::lock_guard<std::mutex> lock(shardsMtx);
+        shards.push_back(std::move(shard));
+    }, std::max(1L, (long) hashTable.size()));
+
+    pool->parallelFor((long) hashTable.size(), [&](long begin, long end) {
+        for (const IBLT& shard : shards)
+            _combine(1, shard, begin, end);
+    });
+}
+
 bool IBLT::get(ZZ key, ZZ& result){
     long bucketsPerHash = hashTable.size()/N_HASH;
     for (long ii = 0; ii < N_HASH; ii++) {
@@ -105,23 +209,15 @@ bool IBLT::get(ZZ key, ZZ& result){
         }
     }
 
-    // Don't know if k is in table or not; "peel" the IBLT to try to find it:
-    long nErased;
-    do {
-        nErased = 0;
-        for (IBLT::HashTableEntry &entry : this->hashTable) {
-            if (entry.isPure()) {
-                if (entry.keySum == key) {
-                    string s = toStr(entry.valueSum);
-                    result = entry.valueSum;
-                    return true;
-                }
-                nErased++;
-                this->_insert(-entry.count, entry.keySum, entry.valueSum);
-            }
-        }
-    } while (nErased > 0);
-    return false;
+    // Don't know if k is in table or not; "peel" the IBLT to try to find it, and then put back what was peeled
+    vector<pair<ZZ, ZZ>> positive, negative;
+    vector<pair<size_t, HashTableEntry>> undo;
+    long cell = _peel(positive, negative, &key, &undo);
+    if (cell >= 0)
+        result = hashTable[cell].valueSum;
+    for (auto itr = undo.rbegin(); itr != undo.rend(); ++itr)
+        hashTable[itr->first] = itr->second;
+    return cell >= 0;
 }
 
 bool IBLT::HashTableEntry::isPure() const
@@ -139,22 +235,7 @@ bool IBLT::HashTableEntry::empty() const
 }
 
 bool IBLT::listEntries(vector<pair<ZZ, ZZ>> &positive, vector<pair<ZZ, ZZ>> &negative){
-    long nErased;
-    do {
-        nErased = 0;
-        for(IBLT::HashTableEntry& entry : this->hashTable) {
-            if (entry.isPure()) {
-                if (entry.count == 1) {
-                    positive.emplace_back(std::make_pair(entry.keySum, entry.valueSum));
-                }
-                else {
-                    negative.emplace_back(std::make_pair(entry.keySum, entry.valueSum));
-                }
-                this->_insert(-entry.count, entry.keySum, entry.valueSum);
-                ++nErased;
-            }
-        }
-    } while (nErased > 0);
+    _peel(positive, negative, nullptr, nullptr);
 
     // If any buckets for one of the hash functions is not empty,
     // then we didn't peel them all:
@@ -170,12 +251,29 @@ IBLT& IBLT::operator-=(const IBLT& other) {
         + toStr(valueSize) + ". Theirs: " + toStr(other.valueSize));
     if(hashTable.size() != other.hashTable.size())
         Logger::error_and_quit("The IBLT hash table sizes are different! Ours: "
-        + toStr(hashTable.size()) + ". Theirs: " + toStr(other.valueSize));
+        + toStr(hashTable.size()) + ". Theirs: " + toStr(other.hashTable.size()));
+
+    _combine(-1, other, 0, hashTable.size());
+    return *this;
+}
+
+IBLT& IBLT::operator+=(const IBLT& other) {
+    if(valueSize != other.valueSize)
+        Logger::error_and_quit("The value sizes between IBLTs don't match! Ours: "
+        + toStr(valueSize) + ". Theirs: " + toStr(other.valueSize));
+    if(hashTable.size() != other.hashTable.size())
+        Logger::error_and_quit("The IBLT hash table sizes are different! Ours: "
+        + toStr(hashTable.size()) + ". Theirs: " + toStr(other.hashTable.size()));
 
-    for (unsigned long ii = 0; ii < hashTable.size(); ii++) {
-        IBLT::HashTableEntry& e1 = this->hashTable.at(ii);
-        const IBLT::HashTableEntry& e2 = other.hashTable.at(ii);
-        e1.count -= e2.count;
+    _combine(1, other, 0, hashTable.size());
+    return *this;
+}
+
+void IBLT::_combine(long plusOrMinus, const IBLT& other, size_t begin, size_t end) {
+    for (size_t ii = begin; ii < end; ii++) {
+        IBLT::HashTableEntry& e1 = this->hashTable[ii];
+        const IBLT::HashTableEntry& e2 = other.hashTable[ii];
+        e1.count += plusOrMinus * e2.count;
         e1.keySum ^= e2.keySum;
         e1.keyCheck ^= e2.keyCheck;
         if (e1.empty()) {
@@ -185,7 +283,6 @@ IBLT& IBLT::operator-=(const IBLT& other) {
             e1.valueSum ^= e2.valueSum;
         }
     }
-    return *this;
 }
 
 IBLT IBLT::operator-(const IBLT& other) const {
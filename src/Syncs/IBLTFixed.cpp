@@ -0,0 +1,259 @@
+/* This code is part of the CPISync project developed at Boston University.  Please see the README for use and references. */
+
+#include <algorithm>
+#include <mutex>
+#include <CPISync/Syncs/IBLTFixed.h>
+
+namespace {
+    /**
+     * dst[ii] ^= src[ii], for ii < len.  The blocks do not overlap, which lets the compiler vectorize the loop.
+     */
+    inline void xorBlock(unsigned char *__restrict dst, const unsigned char *__restrict src, size_t len) {
+        for (size_t ii = 0; ii < len; ii++)
+            dst[ii] ^= src[ii];
+    }
+
+    /**
+     * @return The number of bytes of the little-endian integer at bytes, with len bytes at most (as NumBytes).
+     */
+    inline size_t significantBytes(const unsigned char *bytes, size_t len) {
+        while (len > 0 && bytes[len - 1] == 0)
+            len--;
+        return len;
+    }
+}
+
+IBLTFixed::IBLTFixed(size_t expectedNumEntries, size_t _eltSize)
+: width(_eltSize)
+{
+    // the same number of cells as IBLT(expectedNumEntries, _eltSize)
+    size_t nEntries = expectedNumEntries + expectedNumEntries/2;
+    while (N_HASH * (nEntries/N_HASH) != nEntries) ++nEntries;
+
+    counts.resize(nEntries);
+    keyChecks.resize(nEntries);
+    keySums.resize(nEntries * width);
+    valueSums.resize(nEntries * width);
+    scratch.resize(2 * width);
+}
+
+IBLTFixed::~IBLTFixed() = default;
+
+void IBLTFixed::_toBytes(const ZZ &item, unsigned char *out) const {
+    if (!fits(item))
+        Logger::error_and_quit("The item being inserted does not fit the IBLT! item size: "
+                               + toStr(NumBytes(item)) + ". IBLT item size: " + toStr(width));
+    BytesFromZZ(out, item, (long) width);
+}
+
+void IBLTFixed::_insert(long plusOrMinus, const unsigned char *key, const unsigned char *value, size_t *cells) {
+    size_t bucketsPerHash = counts.size() / N_HASH;
+    size_t keyLen = significantBytes(key, width);
+    hash_t check = IBLT::_hashBytes(key, keyLen, N_HASHCHECK);
+
+    for (long ii = 0; ii < N_HASH; ii++) {
+        size_t cell = ii * bucketsPerHash + IBLT::_hashBytes(key, keyLen, ii) % bucketsPerHash;
+        if (cells != nullptr)
+            cells[ii] = cell;
+
+        counts[cell] += plusOrMinus;
+        xorBlock(&keySums[cell * width], key, width);
+        keyChecks[cell] ^= check;
+        if (_empty(cell))
+            std::fill_n(valueSums.begin() + cell * width, width, 0);
+        else
+            xorBlock(&valueSums[cell * width], value, width);
+    }
+}
+
+void IBLTFixed::insert(const ZZ &key, const ZZ &value) {
+    _toBytes(key, scratch.data());
+    _toBytes(value, scratch.data() + width);
+    _insert(1, scratch.data(), scratch.data() + width);
+}
+
+void IBLTFixed::erase(const ZZ &key, const ZZ &value) {
+    _toBytes(key, scratch.data());
+    _toBytes(value, scratch.data() + width);
+    _insert(-1, scratch.data(), scratch.data() + width);
+}
+
+void IBLTFixed::insert(const vector<pair<ZZ, ZZ>> &pairs, ThreadPool *pool) {
+#ifndef NTL_THREADS
+    pool = nullptr; // ZZs may only be used from several threads if NTL was built with NTL_THREADS
+#endif
+    if (pool == nullptr) {
+        for (const auto& item : pairs)
+            insert(item.first, item.second);
+        return;
+    }
+
+    // private IBLTs added in, as in IBLT::insert(pairs, pool)
+    vector<IBLTFixed> shards;
+    std::mutex shardsMtx;
+    pool->parallelFor((long) pairs.size(), [&](long begin, long end) {
+        IBLTFixed shard(0, width);
+        shard.counts.resize(counts.size());
+        shard.keyChecks.resize(keyChecks.size());
+        shard.keySums.resize(keySums.size());
+        shard.valueSums.resize(valueSums.size());
+        for (long ii = begin; ii < end; ii++)
+            shard.insert(pairs[ii].first, pairs[ii].second);
+
+        std::lock_guard<std::mutex> lock(shardsMtx);
+        shards.push_back(std::move(shard));
+    }, std::max(1L, (long) counts.size()));
+
+    pool->parallelFor((long) counts.size(), [&](long begin, long end) {
+        for (const IBLTFixed& shard : shards)
+            _combine(1, shard, begin, end);
+    });
+}
+
+bool IBLTFixed::_isPure(size_t cell) const {
+    if (counts[cell] == 1 || counts[cell] == -1) {
+        const unsigned char *key = &keySums[cell * width];
+        return keyChecks[cell] == IBLT::_hashBytes(key, significantBytes(key, width), N_HASHCHECK);
+    }
+    return false;
+}
+
+bool IBLTFixed::_empty(size_t cell) const {
+    if (counts[cell] != 0 || keyChecks[cell] != 0)
+        return false;
+    const unsigned char *key = &keySums[cell * width];
+    return std::all_of(key, key + width, [](unsigned char bt) { return bt == 0; });
+}
+
+bool IBLTFixed::listEntries(vector<pair<ZZ, ZZ>> &positive, vector<pair<ZZ, ZZ>> &negative) {
+    // a worklist of pure cells, as in IBLT::_peel
+    vector<size_t> pure;
+    for (size_t cell = 0; cell < counts.size(); cell++) {
+        if (_isPure(cell))
+            pure.push_back(cell);
+    }
+
+    // the pure cell is changed by its own removal, so its key and value are copied out first
+    unsigned char *removed = scratch.data();
+    size_t cells[N_HASH];
+    ZZ key, value;
+    while (!pure.empty()) {
+        size_t cell = pure.back();
+        pure.pop_back();
+        if (!_isPure(cell))
+            continue;
+
+        long count = counts[cell];
+        std::copy_n(keySums.begin() + cell * width, width, removed);
+        std::copy_n(valueSums.begin() + cell * width, width, removed + width);
+        ZZFromBytes(key, removed, (long) width);
+        ZZFromBytes(value, removed + width, (long) width);
+        if (count == 1)
+            positive.emplace_back(key, value);
+        else
+            negative.emplace_back(key, value);
+        _insert(-count, removed, removed + width, cells);
+
+        for (size_t changed : cells) {
+            if (_isPure(changed))
+                pure.push_back(changed);
+        }
+    }
+
+    // If any cell is not empty, then we didn't peel them all:
+    for (size_t cell = 0; cell < counts.size(); cell++) {
+        if (!_empty(cell)) return false;
+    }
+    return true;
+}
+
+IBLTFixed& IBLTFixed::operator-=(const IBLTFixed& other) {
+    if (width != other.width)
+        Logger::error_and_quit("The value sizes between IBLTs don't match! Ours: "
+        + toStr(width) + ". Theirs: " + toStr(other.width));
+    if (counts.size() != other.counts.size())
+        Logger::error_and_quit("The IBLT hash table sizes are different! Ours: "
+        + toStr(counts.size()) + ". Theirs: " + toStr(other.counts.size()));
+
+    _combine(-1, other, 0, counts.size());
+    return *this;
+}
+
+IBLTFixed& IBLTFixed::operator+=(const IBLTFixed& other) {
+    if (width != other.width)
+        Logger::error_and_quit("The value sizes between IBLTs don't match! Ours: "
+        + toStr(width) + ". Theirs: " + toStr(other.width));
+    if (counts.size() != other.counts.size())
+        Logger::error_and_quit("The IBLT hash table sizes are different! Ours: "
+        + toStr(counts.size()) + ". Theirs: " + toStr(other.counts.size()));
+
+    _combine(1, other, 0, counts.size());
+    return *this;
+}
+
+void IBLTFixed::_combine(long plusOrMinus, const IBLTFixed& other, size_t begin, size_t end) {
+    // whole columns at once, and then, as IBLT does, the values of the cells left empty are cleared
+    for (size_t cell = begin; cell < end; cell++) {
+        counts[cell] += plusOrMinus * other.counts[cell];
+        keyChecks[cell] ^= other.keyChecks[cell];
+    }
+    xorBlock(keySums.data() + begin * width, other.keySums.data() + begin * width, (end - begin) * width);
+    xorBlock(valueSums.data() + begin * width, other.valueSums.data() + begin * width, (end - begin) * width);
+    for (size_t cell = begin; cell < end; cell++) {
+        if (_empty(cell))
+            std::fill_n(valueSums.begin() + cell * width, width, 0);
+    }
+}
+
+IBLTFixed IBLTFixed::operator-(const IBLTFixed& other) const {
+    IBLTFixed result(*this);
+    result -= other;
+    return result;
+}
+
+bool IBLTFixed::fits(const ZZ &item) const {
+    return sign(item) >= 0 && (size_t) NumBytes(item) <= width;
+}
+
+IBLT IBLTFixed::toIBLT() const {
+    IBLT result;
+    result.valueSize = width;
+    result.hashTable.resize(counts.size());
+    for (size_t cell = 0; cell < counts.size(); cell++) {
+        IBLT::HashTableEntry &entry = result.hashTable[cell];
+        entry.count = counts[cell];
+        entry.keyCheck = keyChecks[cell];
+        ZZFromBytes(entry.keySum, &keySums[cell * width], (long) width);
+        ZZFromBytes(entry.valueSum, &valueSums[cell * width], (long) width);
+    }
+    return result;
+}
+
+bool IBLTFixed::assign(const IBLT &iblt) {
+    for (const IBLT::HashTableEntry &entry : iblt.hashTable) {
+        if (!fits(entry.keySum) || !fits(entry.valueSum))
+            return false;
+    }
+
+    size_t nEntries = iblt.hashTable.size();
+    counts.resize(nEntries);
+    keyChecks.resize(nEntries);
+    keySums.resize(nEntries * width);
+    valueSums.resize(nEntries * width);
+    for (size_t cell = 0; cell < nEntries; cell++) {
+        const IBLT::HashTableEntry &entry = iblt.hashTable[cell];
+        counts[cell] = entry.count;
+        keyChecks[cell] = entry.keyCheck;
+        BytesFromZZ(&keySums[cell * width], entry.keySum, (long) width);
+        BytesFromZZ(&valueSums[cell * width], entry.valueSum, (long) width);
+    }
+    return true;
+}
+
+size_t IBLTFixed::size() const {
+    return counts.size();
+}
+
+size_t IBLTFixed::eltSize() const {
+    return width;
+}
@@ -2,6 +2,8 @@
 // Created by Shubham Arora on 7/20/20.
 //
 
+#include <algorithm>
+#include <mutex>
 #include <CPISync/Syncs/IBLTMultiset.h>
 
 
@@ -47,12 +49,13 @@ void IBLTMultiset::_insertModular(long plusOrMinus, ZZ key, ZZ value) {
         Logger::error_and_quit("The value being inserted is different than the IBLT value size! value size: "
                                + toStr(sizeof(value)) + ". IBLT value size: " + toStr(valueSize));
 
+    // the hash-check is the same in every cell of key
+    hash_t modHashCheck = _hashK(key, N_HASHCHECK) % LARGE_PRIME;
     for(int ii=0; ii < N_HASH; ii++){
         hash_t hk = _hashK(key, ii);
         long startEntry = ii * bucketsPerHash;
         long pos = startEntry + (hk%bucketsPerHash);
         IBLTMultiset::HashTableEntry& entry = hashTable.at(startEntry + (hk%bucketsPerHash));
-        hash_t modHashCheck = _hashK(key, N_HASHCHECK) % LARGE_PRIME;
 
         entry.count += plusOrMinus;
         entry.keySum += plusOrMinus*key;
@@ -79,6 +82,36 @@ void IBLTMultiset::erase(ZZ key, ZZ value) {
     _insertModular(-1, key, value);
 }
 
+void IBLTMultiset::insert(const vector<pair<ZZ, ZZ>> &pairs, ThreadPool *pool) {
+#ifndef NTL_THREADS
+    pool = nullptr; // ZZs may only be used from several threads if NTL was built with NTL_THREADS
+#endif
+    if (pool == nullptr) {
+        for (const auto& item : pairs)
+            _insertModular(1, item.first, item.second);
+        return;
+    }
+
+    // private IBLTs added in, as in IBLT::insert(pairs, pool)
+    vector<IBLTMultiset> shards;
+    std::mutex shardsMtx;
+    pool->parallelFor((long) pairs.size(), [&](long begin, long end) {
+        IBLTMultiset shard;
+        shard.valueSize = valueSize;
+        shard.hashTable.resize(hashTable.size());
+        for (long ii = begin; ii < end; ii++)
+            shard._insertModular(1, pairs[ii].first, pairs[ii].second);
+
+        std::lock_guard<std::mutex> lock(shardsMtx);
+        shards.push_back(std::move(shard));
+    }, std::max(1L, (long) hashTable.size()));
+
+    pool->parallelFor((long) hashTable.size(), [&](long begin, long end) {
+        for (const IBLTMultiset& shard : shards)
+            _combine(1, shard, begin, end);
+    });
+}
+
 
 bool IBLTMultiset::get(ZZ key, ZZ& result){
     long bucketsPerHash = hashTable.size()/N_HASH;
@@ -222,23 +255,41 @@ IBLTMultiset &IBLTMultiset::operator-=(const IBLTMultiset &other) {
                                + toStr(valueSize) + ". Theirs: " + toStr(other.valueSize));
     if (hashTable.size() != other.hashTable.size())
         Logger::error_and_quit("The IBLT hash table sizes are different! Ours: "
-                               + toStr(hashTable.size()) + ". Theirs: " + toStr(other.valueSize));
+                               + toStr(hashTable.size()) + ". Theirs: " + toStr(other.hashTable.size()));
+
+    _combine(-1, other, 0, hashTable.size());
+    return *this;
+}
+
+IBLTMultiset &IBLTMultiset::operator+=(const IBLTMultiset &other) {
+    if (valueSize != other.valueSize)
+        Logger::error_and_quit("The value sizes between IBLTs don't match! Ours: "
+                               + toStr(valueSize) + ". Theirs: " + toStr(other.valueSize));
+    if (hashTable.size() != other.hashTable.size())
+        Logger::error_and_quit("The IBLT hash table sizes are different! Ours: "
+                               + toStr(hashTable.size()) + ". Theirs: " + toStr(other.hashTable.size()));
+
+    _combine(1, other, 0, hashTable.size());
+    return *this;
+}
 
-    for (unsigned long ii = 0; ii < hashTable.size(); ii++) {
-        IBLTMultiset::HashTableEntry &e1 = this->hashTable.at(ii);
-        const IBLTMultiset::HashTableEntry &e2 = other.hashTable.at(ii);
+void IBLTMultiset::_combine(long plusOrMinus, const IBLTMultiset &other, size_t begin, size_t end) {
+    for (size_t ii = begin; ii < end; ii++) {
+        IBLTMultiset::HashTableEntry &e1 = this->hashTable[ii];
+        const IBLTMultiset::HashTableEntry &e2 = other.hashTable[ii];
 
-        e1.count -= e2.count;
-        e1.keySum -= e2.keySum;
-        e1.keyCheck = _subModHash(e1.keyCheck, e2.keyCheck);
+        e1.count += plusOrMinus * e2.count;
+        e1.keySum += plusOrMinus * e2.keySum;
+        if (plusOrMinus == 1)
+            e1.keyCheck = _addModHash(e1.keyCheck, e2.keyCheck);
+        else
+            e1.keyCheck = _subModHash(e1.keyCheck, e2.keyCheck);
 
         if (e1.empty())
             e1.valueSum.kill();
         else
-            e1.valueSum -= e2.valueSum;
-
+            e1.valueSum += plusOrMinus * e2.valueSum;
     }
-    return *this;
 }
 
 IBLTMultiset IBLTMultiset::operator-(const IBLTMultiset& other) const {
@@ -97,7 +97,7 @@ bool IBLTSync::SyncServer(const shared_ptr<Communicant>& commSync, list<shared_p
         }
 
         // verified that our size and eltSize == theirs
-        IBLT theirs = commSync->commRecv_IBLT(myIBLT.size(), myIBLT.eltSize());
+        IBLTFixed theirs = commSync->commRecv_IBLTFixed(myIBLT.size(), myIBLT.eltSize());
         mySyncStats.timerEnd(SyncStats::COMM_TIME);
 
 
@@ -145,15 +145,39 @@ bool IBLTSync::SyncServer(const shared_ptr<Communicant>& commSync, list<shared_p
     } // might not need the try-catch
 }
 bool IBLTSync::addElem(shared_ptr<DataObject> datum){
+    if (!myIBLT.fits(datum->to_ZZ())) {
+        Logger::error("The element " + datum->print() + " does not fit in " + toStr(myIBLT.eltSize()) + " bytes.");
+        return false;
+    }
+
     // call parent add
     SyncMethod::addElem(datum);
     myIBLT.insert(datum->to_ZZ(), datum->to_ZZ());
     return true;
 }
 bool IBLTSync::delElem(shared_ptr<DataObject> datum){
+    if (!myIBLT.fits(datum->to_ZZ())) // so it was never added
+        return false;
+
     // call parent delete
     SyncMethod::delElem(datum);
     myIBLT.erase(datum->to_ZZ(), datum->to_ZZ());
     return true;
 }
+bool IBLTSync::addElems(const list<shared_ptr<DataObject>>& data){
+    vector<pair<ZZ, ZZ>> pairs;
+    pairs.reserve(data.size());
+    for (const auto& datum : data) {
+        if (!myIBLT.fits(datum->to_ZZ())) {
+            Logger::error("The element " + datum->print() + " does not fit in " + toStr(myIBLT.eltSize()) + " bytes.");
+            return false;
+        }
+        pairs.emplace_back(datum->to_ZZ(), datum->to_ZZ());
+    }
+
+    for (const auto& datum : data)
+        SyncMethod::addElem(datum);
+    myIBLT.insert(pairs, threadPool.get());
+    return true;
+}
 string IBLTSync::getName(){ return "IBLTSync\n   * expected number of elements = " + toStr(expNumElems) + "\n   * size of values =  " + toStr(myIBLT.eltSize()) + '\n';}
\ No newline at end of file
@@ -148,6 +148,16 @@ bool IBLTSync_Multiset::addElem(shared_ptr<DataObject> datum){
     myIBLT.insert(datum->to_ZZ(), datum->to_ZZ());
     return true;
 }
+bool IBLTSync_Multiset::addElems(const list<shared_ptr<DataObject>>& data){
+    vector<pair<ZZ, ZZ>> pairs;
+    pairs.reserve(data.size());
+    for (const auto& datum : data) {
+        SyncMethod::addElem(datum);
+        pairs.emplace_back(datum->to_ZZ(), datum->to_ZZ());
+    }
+    myIBLT.insert(pairs, threadPool.get());
+    return true;
+}
 bool IBLTSync_Multiset::delElem(shared_ptr<DataObject> datum){
     // call parent delete
     SyncMethod::delElem(datum);
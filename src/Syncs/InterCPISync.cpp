@@ -7,14 +7,34 @@
  * Created on November 30, 2011, 10:46 PM
  */
 
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+#include <random>
 #include <CPISync/Aux/Auxiliary.h>
 #include <CPISync/Communicants/Communicant.h>
 #include <CPISync/Aux/Exceptions.h>
 #include <CPISync/Syncs/CPISync.h>
 #include <CPISync/Syncs/InterCPISync.h>
 
+namespace {
+    typedef pair<ZZ, shared_ptr<DataObject>> IndexEntry; /** An entry of InterCPISync::hashIndex. */
+
+    /** Orders entries of InterCPISync::hashIndex, and hashes, by hash. */
+    struct ByHash {
+        bool operator()(const IndexEntry& first, const IndexEntry& second) const { return first.first < second.first; }
+        bool operator()(const IndexEntry& entry, const ZZ& hash) const { return entry.first < hash; }
+        bool operator()(const ZZ& hash, const IndexEntry& entry) const { return hash < entry.first; }
+    };
+
+    const long ADAPTIVE_BINS = 16; /** The number of sub-ranges of a node over which elements are counted, and the
+                                     *  largest fan-out, with the adaptive fan-out. */
+
+    const size_t MAX_CHECKPOINTS = 16; /** The number of interrupted sessions whose checkpoints are kept. */
+}
+
 InterCPISync::InterCPISync(long m_bar, long bits, int epsilon, int partition,bool Hashes /* = false*/)
-: maxDiff(m_bar), bitNum(bits), pFactor(partition), hashes(Hashes),
+: tree(partition), maxDiff(m_bar), bitNum(bits), pFactor(partition), hashes(Hashes), interpType(INTERP_TYPE::Gauss), rootType(ROOT_TYPE::Factor),
 	probEps(conv<int>(ceil(-log10((RR_ONE - pow(RR_ONE - pow(RR_TWO,(RR) -epsilon),RR_ONE/ (RR_ONE+ pow(RR_TWO,(RR) bits) *
 	(RR) partition / (RR) m_bar * (RR) ceil(bits*log(2)/log(partition))))))/log10(RR_TWO)))){
 
@@ -34,18 +54,25 @@ InterCPISync::InterCPISync(long m_bar, long bits, int epsilon, int partition,boo
 	if (redundant_k <= 0) redundant_k = 1; //k at least 1
 
 	DATA_MAX = power(ZZ_TWO, bitNum); // maximum data element for the multiset
+	elementHash = ElementHash(HASH_TYPE::Modulo, bitNum);
 	ZZ fieldSize = NextPrime(DATA_MAX + maxDiff + redundant_k);
 	ZZ_p::init(fieldSize);
 
-	treeNode = nullptr;
+	compactTree = false;
+	hashIndexSorted = 0;
+	batchedLevels = false;
+	adaptiveFanout = false;
+	checkpointClock = 0;
+	modifications = 0;
+	session = clientSession = 0;
+	resumeLevel = -1;
+	chargedXmit = chargedRecv = 0;
+	roundTrips = 0;
 	useExisting=false;
 	SyncID = SYNC_TYPE::Interactive_CPISync; // the synchronization type
 }
 
-InterCPISync::~InterCPISync() {
-	// clean out the CPISync tree
-	_deleteTree(treeNode);
-}
+InterCPISync::~InterCPISync() = default; // the CPISync tree releases its own nodes
 
 
 bool InterCPISync::delElem(shared_ptr<DataObject> datum) {
@@ -54,17 +81,30 @@ bool InterCPISync::delElem(shared_ptr<DataObject> datum) {
 
     Logger::gLog(Logger::METHOD_DETAILS, ". (InterCPISync) removing item " + datum->print());
 
+    // the entry is found by its hash in the sorted part of the index, or else among the entries appended since
+    auto isDatum = [&datum](const IndexEntry& entry) { return entry.second == datum; };
+    auto sortedEnd = hashIndex.begin() + hashIndexSorted;
+    auto range = equal_range(hashIndex.begin(), sortedEnd, rep(_hash(datum)), ByHash());
+    auto found = find_if(range.first, range.second, isDatum);
+    if (found != range.second)
+        hashIndexSorted--;
+    else
+        found = find_if(sortedEnd, hashIndex.end(), isDatum);
+    if (found != hashIndex.end())
+        hashIndex.erase(found);
+    modifications++;
+
     //If empty do nothing
-    if(treeNode == nullptr){
+    if(tree.empty()){
         Logger::error("No elements are present in this sync object");
         return false;
     }
     //If not empty delete the element from each relevant branch in the tree
     else {
-		bool success = _delElem(datum,treeNode,ZZ_ZERO,DATA_MAX);
+		bool success = _delElem(datum,0,ZZ_ZERO,DATA_MAX);
 		//If the parent node contains an empty set then clear
-		if(treeNode->getDatum()->getNumElem() == 0) {
-			treeNode = nullptr;
+		if(tree.getDatum(0).getNumElem() == 0) {
+			tree.clear();
 		}
 		return success;
 	}
@@ -85,12 +125,16 @@ bool InterCPISync::addElem(shared_ptr<DataObject> newDatum) {
 
 	Logger::gLog(Logger::METHOD_DETAILS, ". (InterCPISync) adding item " + newDatum->print() + " with representation = " + toStr(addElemHashID)); // log the action
 
-	if(treeNode == nullptr)
-		treeNode = new pTree(new CPISync_ExistingConnection(maxDiff, bitNum, probEps, redundant_k,hashes), pFactor);
+	if(tree.empty())
+		_addRoot();
+	if (!tree.getDatum(0).addElem(newDatum))
+		return false;
 
-	CPISync *curr = treeNode->getDatum();
-	return curr->addElem(newDatum);
-	//  return addElem(newDatum, treeNode, NULL, ZZ_ZERO, DATA_MAX); // use the recursive helper method
+	if (hashIndexSorted == hashIndex.size() && (hashIndex.empty() || !(addElemHashID < hashIndex.back().first)))
+		hashIndexSorted++; // still in order
+	hashIndex.emplace_back(addElemHashID, newDatum);
+	modifications++;
+	return true;
 }
 
 bool InterCPISync::SyncClient(const shared_ptr<Communicant>& commSync, list<shared_ptr<DataObject>>& selfMinusOther, list<shared_ptr<DataObject>>& otherMinusSelf) {
@@ -108,10 +152,17 @@ bool InterCPISync::SyncClient(const shared_ptr<Communicant>& commSync, list<shar
     mySyncStats.timerEnd(SyncStats::COMM_TIME);
 
     // 1. Do the sync
-    pTree *parentNode = treeNode;//Create a copy of the root node - Just to make sure that it is not deleted
+    tree.truncate(1); // only the root is kept up to date between synchronizations
     commSync->hardResetCommCounters(); //Because each CPISync will reset the communicant stats need to reset and use the "total" fields
+    depthStats.clear();
+    chargedXmit = chargedRecv = 0;
+    const NodeRange root = {ZZ_ZERO, DATA_MAX, ZZ_ZERO, DATA_MAX, 0};
     bool result = SyncMethod::SyncClient(commSync, selfMinusOther, otherMinusSelf) // also call the parent to establish bookkeeping variables
-                  && _SyncClient(commSync, selfMinusOther, otherMinusSelf, parentNode, ZZ_ZERO, DATA_MAX);//Call the modified Sync with data Ranges
+                  && (batchedLevels || adaptiveFanout ? _SyncClientBatched(commSync, selfMinusOther, otherMinusSelf)
+                      : compactTree ? _SyncClientCompact(commSync, selfMinusOther, otherMinusSelf, root)
+                                    : _SyncClient(commSync, selfMinusOther, otherMinusSelf, tree.empty() ? pTree::NONE : 0, root));//Call the modified Sync with data Ranges
+    tree.truncate(1); // release the nodes created by the synchronization
+    _recordTotals(commSync);
 
     if (result) { // Sync succeeded
         Logger::gLog(Logger::METHOD, string("Interactive sync succeeded.\n")
@@ -125,9 +176,6 @@ bool InterCPISync::SyncClient(const shared_ptr<Communicant>& commSync, list<shar
     // Close communicants
     if(!useExisting) commSync->commClose();
 
-    //Record Stats
-
-
     return result;
 }
 
@@ -137,13 +185,40 @@ void InterCPISync::SendSyncParam(const shared_ptr<Communicant>& commSync, bool o
     SyncMethod::SendSyncParam(commSync);
 
     commSync->commSend(enumToByte(SyncID));
+    commSync->commSend(CPISYNC_PARAM_VERSION);
     commSync->commSend(maxDiff);
     commSync->commSend(bitNum);
     commSync->commSend(probEps);
     commSync->commSend(pFactor);
+    commSync->commSend((byte) batchedLevels);
+    commSync->commSend((byte) adaptiveFanout);
+    commSync->commSend(enumToByte(elementHash.type()));
+    commSync->commSend(to_ZZ((unsigned long) elementHash.key()), sizeof(uint64_t));
+
+    // ... the session, and the level at which I could resume it
+    long offered = -1;
+    if (batchedLevels || adaptiveFanout) {
+        auto checkpoint = checkpoints.find(clientSession);
+        if (checkpoint != checkpoints.end() && _unchanged(checkpoint->second))
+            offered = checkpoint->second.latest.number;
+        else { // a new session
+            checkpoints.erase(clientSession);
+            static std::random_device source;
+            clientSession = std::uniform_int_distribution<long>(1, LONG_MAX)(source);
+        }
+    }
+    session = (batchedLevels || adaptiveFanout) ? clientSession : 0;
+    commSync->commSend(session);
+    commSync->commSend(offered);
 
     if (commSync->commRecv_byte() == SYNC_FAIL_FLAG) throw SyncFailureException("Sync parameters do not match.");
 
+    resumeLevel = commSync->commRecv_long();
+    if (resumeLevel != -1 && (offered == -1 || (resumeLevel != offered && resumeLevel != checkpoints[session].previous.number))) {
+        checkpoints.erase(session);
+        throw SyncFailureException("Cannot resume the session at the level chosen by the server.");
+    }
+
     Logger::gLog(Logger::COMM, "Sync parameters match");
 }
 
@@ -154,21 +229,57 @@ void InterCPISync::RecvSyncParam(const shared_ptr<Communicant>& commSync, bool o
     SyncMethod::RecvSyncParam(commSync);
 
     byte theSyncID = commSync->commRecv_byte();
+    byte versionClient = commSync->commRecv_byte();
+    if (versionClient != CPISYNC_PARAM_VERSION) { // the rest cannot be parsed under another version
+        commSync->commSend(SYNC_FAIL_FLAG);
+        Logger::gLog(Logger::COMM, "Sync parameter versions differ: Client has " + toStr((int) versionClient) +
+                                   ".  Server has " + toStr((int) CPISYNC_PARAM_VERSION) + ".");
+        throw SyncFailureException("Sync parameter versions do not match.");
+    }
     long mbarClient = commSync->commRecv_long();
     long bitsClient = commSync->commRecv_long();
     int epsilonClient = commSync->commRecv_int();
     long pFactorClient = commSync->commRecv_long();
-
-    if (theSyncID != enumToByte(SyncID) || mbarClient != maxDiff || bitsClient != bitNum || epsilonClient != probEps || pFactor != pFactorClient) {
+    bool batchedClient = commSync->commRecv_byte() != 0;
+    bool adaptiveClient = commSync->commRecv_byte() != 0;
+    byte hashTypeClient = commSync->commRecv_byte();
+    ZZ hashKeyClient = commSync->commRecv_ZZ(sizeof(uint64_t));
+    long sessionClient = commSync->commRecv_long();
+    long levelClient = commSync->commRecv_long();
+
+    if (theSyncID != enumToByte(SyncID) || mbarClient != maxDiff || bitsClient != bitNum || epsilonClient != probEps || pFactor != pFactorClient
+        || batchedLevels != batchedClient || adaptiveFanout != adaptiveClient
+        || hashTypeClient != enumToByte(elementHash.type()) || hashKeyClient != to_ZZ((unsigned long) elementHash.key())) {
         // report a failure to establish sync parameters
         commSync->commSend(SYNC_FAIL_FLAG);
         Logger::gLog(Logger::COMM, "Sync parameters differ from client to server: Client has (" +
                                    toStr(mbarClient) + "," + toStr(bitsClient) + "," + toStr(epsilonClient) + "," + toStr(pFactorClient) +
-                                   ").  Server has (" + toStr(maxDiff) + "," + toStr(bitNum) + "," + toStr(probEps) + "," + toStr(pFactor) + ").");
+                                   "," + toStr(batchedClient) + "," + toStr(adaptiveClient) + "," + toStr((int) hashTypeClient) + "," + toStr(hashKeyClient) +
+                                   ").  Server has (" + toStr(maxDiff) + "," + toStr(bitNum) + "," + toStr(probEps) + "," + toStr(pFactor) +
+                                   "," + toStr(batchedLevels) + "," + toStr(adaptiveFanout) + "," + toStr((int) enumToByte(elementHash.type())) +
+                                   "," + toStr(elementHash.key()) + ").");
         throw SyncFailureException("Sync parameters do not match.");
     }
     commSync->commSend(SYNC_OK_FLAG);
     Logger::gLog(Logger::COMM, "Sync parameters match");
+
+    // resume the client's session at the first level that we both started, if I still can
+    session = sessionClient;
+    resumeLevel = -1;
+    auto checkpoint = checkpoints.find(session);
+    if (session != 0 && checkpoint != checkpoints.end()) {
+        long latest = checkpoint->second.latest.number;
+        long previous = checkpoint->second.previous.number;
+        if (levelClient >= 0 && (latest == levelClient || latest == levelClient - 1) && _unchanged(checkpoint->second))
+            resumeLevel = latest;
+        else if (levelClient >= 0 && previous == levelClient && _unchanged(checkpoint->second))
+            resumeLevel = previous; // I started one more level than the client, and roll it back
+        else
+            checkpoints.erase(checkpoint);
+    }
+    commSync->commSend(resumeLevel);
+    if (resumeLevel >= 0)
+        Logger::gLog(Logger::COMM, "Resuming session " + toStr(session) + " at level " + toStr(resumeLevel));
 }
 
 bool InterCPISync::SyncServer(const shared_ptr<Communicant>& commSync, list<shared_ptr<DataObject>>& selfMinusOther, list<shared_ptr<DataObject>>& otherMinusSelf) {
@@ -188,9 +299,16 @@ bool InterCPISync::SyncServer(const shared_ptr<Communicant>& commSync, list<shar
     mySyncStats.timerEnd(SyncStats::COMM_TIME);
 
     // 1. Do the sync
-    pTree * parentNode = treeNode;
+    tree.truncate(1); // only the root is kept up to date between synchronizations
     commSync->hardResetCommCounters(); //Because each CPISync will reset the communicant stats need to reset and use the "total" fields
-    result &= _SyncServer(commSync, selfMinusOther, otherMinusSelf, parentNode, ZZ_ZERO, DATA_MAX);
+    depthStats.clear();
+    chargedXmit = chargedRecv = 0;
+    const NodeRange root = {ZZ_ZERO, DATA_MAX, ZZ_ZERO, DATA_MAX, 0};
+    result &= batchedLevels || adaptiveFanout ? _SyncServerBatched(commSync, selfMinusOther, otherMinusSelf)
+              : compactTree ? _SyncServerCompact(commSync, selfMinusOther, otherMinusSelf, root)
+                            : _SyncServer(commSync, selfMinusOther, otherMinusSelf, tree.empty() ? pTree::NONE : 0, root);
+    tree.truncate(1); // release the nodes created by the synchronization
+    _recordTotals(commSync);
     if (result) { // Sync succeeded
         Logger::gLog(Logger::METHOD, string("Interactive sync succeeded.\n")
                                      + "   self - other =  " + printListOfSharedPtrs(selfMinusOther) + "\n"
@@ -208,106 +326,137 @@ bool InterCPISync::SyncServer(const shared_ptr<Communicant>& commSync, list<shar
 }
 
 //Private
-void InterCPISync::_deleteTree(pTree *treeNode){
-    Logger::gLog(Logger::METHOD,"Entering InterCPISync::deleteTree");
-    if (treeNode == nullptr)
-        return; // i.e. nothing to do
-    else {
-        for (int ii = 0; ii < pFactor; ii++) {
-            _deleteTree(treeNode->child[ii]);
-        }
-        delete treeNode;
-    }
+void InterCPISync::_configureNode(CPISync_ExistingConnection &node) const {
+    node.setInterpType(interpType);
+    node.setRootType(rootType);
+    node.setHashType(elementHash.type(), elementHash.key());
+    node.setThreadPool(threadPool);
 }
 
-ZZ_p InterCPISync::_hash(shared_ptr<DataObject>datum) const {
-    ZZ num = datum->to_ZZ(); // convert the datum to a ZZ
-    return to_ZZ_p(num % DATA_MAX); // reduce to bit_num bits and make into a ZZ_p
+void InterCPISync::_addRoot() {
+    _configureNode(tree.getDatum(tree.addRoot(maxDiff, bitNum, probEps, redundant_k, hashes)));
 }
 
-bool InterCPISync::_createTreeNode(pTree *&treeNode, pTree *parent, const ZZ &begRange, const ZZ &endRange) {
-    Logger::gLog(Logger::METHOD,"Entering InterCPISync::createTreeNode");
-    treeNode = new pTree(new CPISync_ExistingConnection(maxDiff, bitNum, probEps, redundant_k, hashes),pFactor);
+CPISync_ExistingConnection *InterCPISync::_makeNode() const {
+    auto *node = new CPISync_ExistingConnection(maxDiff, bitNum, probEps, redundant_k, hashes);
+    _configureNode(*node);
+    return node;
+}
 
-    CPISync *curr = treeNode->getDatum(); // the current node
+void InterCPISync::setHashType(HASH_TYPE type, uint64_t key /* = ElementHash::DFT_KEY */) {
+    if (!hashIndex.empty()) {
+        Logger::error("The element hash can only be changed before elements are added.");
+        return;
+    }
+    elementHash = ElementHash(type, bitNum, key);
+    if (!tree.empty()) // a root left empty by deletions
+        _configureNode(tree.getDatum(0));
+}
 
-    if (parent != nullptr) {
-        // add all appropriate parent info
-        CPISync *par = parent->getDatum(); // the parent node
+void InterCPISync::setCompactTree(bool compact) {
+    compactTree = compact; // the root is kept up to date in either mode
+}
 
-        for (auto elem = par->beginElements(); elem != par->endElements(); elem++) {
-            const ZZ elemZZ = rep(_hash(*elem));
-            if ((elemZZ >= begRange) && (elemZZ < endRange) && (!curr->addElem(*elem))) //if element is in range and add fails
-                return false;
-        }
+void InterCPISync::_sortIndex() {
+    if (hashIndexSorted < hashIndex.size()) {
+        auto sortedEnd = hashIndex.begin() + hashIndexSorted;
+        stable_sort(sortedEnd, hashIndex.end(), ByHash());
+        inplace_merge(hashIndex.begin(), sortedEnd, hashIndex.end(), ByHash());
+        hashIndexSorted = hashIndex.size();
     }
-    return true;
 }
 
-bool InterCPISync::_addElem(shared_ptr<DataObject>newDatum, pTree *&treeNode, pTree *parent, const ZZ &begRange,
-                            const ZZ &endRange) {
-    Logger::gLog(Logger::METHOD,"Entering InterCPISync::addElem");
-    Logger::gLog(Logger::METHOD_DETAILS, ".  (InterCPISync) adding in range " + toStr(begRange) + " - " + toStr(endRange));
-    CPISync *curr;
+list<shared_ptr<DataObject>> InterCPISync::_sliceElems(const ZZ &begHash, const ZZ &endHash) {
+    _sortIndex();
+    auto first = lower_bound(hashIndex.begin(), hashIndex.end(), begHash, ByHash());
+    auto last = lower_bound(first, hashIndex.end(), endHash, ByHash()); // an empty slice if endHash <= begHash
 
-    // if the current node is empty, create it
-    if (treeNode == nullptr) {
-        _createTreeNode(treeNode, parent, begRange, endRange); // create a new tree node here
-        curr = treeNode->getDatum();
+    list<shared_ptr<DataObject>> data;
+    for (auto itr = first; itr != last; itr++)
+        data.push_back(itr->second);
+    return data;
+}
 
-        if (parent == nullptr) // I'm at the root of the tree ... nothing was propagated, so add the new datum
-            if (!curr->addElem(newDatum))
-                return false;
-    }
-    else { // treeNode was not null ... just add the newDatum
-        curr = treeNode->getDatum();
-        if (!curr->addElem(newDatum)) return false; //Add to current node
-    }
+CPISync_ExistingConnection *InterCPISync::_compactNode(const NodeRange &range,
+                                                        unique_ptr<CPISync_ExistingConnection> &built) {
+    if (range.depth == 0)
+        return (tree.empty() || tree.getDatum(0).getNumElem() == 0) ? nullptr : &tree.getDatum(0);
+    built.reset(_materializeNode(range.sliceBeg, range.sliceEnd));
+    return built.get();
+}
 
-    // do we need to add to its children as well?
-    if (curr->getNumElem() > 0 && endRange - begRange > 1) { // keep dividing until we have no elements or we reach a cell with only one value in its range
-        // find the correct child
-        ZZ step = (endRange - begRange) / pFactor;
+CPISync_ExistingConnection *InterCPISync::_materializeNode(const ZZ &begHash, const ZZ &endHash) {
+    list<shared_ptr<DataObject>> data = _sliceElems(begHash, endHash);
+    if (data.empty())
+        return nullptr;
 
-        if (step == 0) { // minimum step size is 1 - this will leave some partitions unused
-            step=1;
-        }
+    CPISync_ExistingConnection *node = _makeNode();
+    node->addElems(data);
+    return node;
+}
 
-        long childPos = to_long((addElemHashID - begRange) / step);
-        if (childPos >= pFactor) childPos = pFactor - 1; // lump all final elements into the last child
+void InterCPISync::_addNodeStats(CPISync *node) {
+    mySyncStats.increment(SyncStats::COMM_TIME, node->mySyncStats.getStat(SyncStats::COMM_TIME));
+    mySyncStats.increment(SyncStats::IDLE_TIME, node->mySyncStats.getStat(SyncStats::IDLE_TIME));
+    mySyncStats.increment(SyncStats::COMP_TIME, node->mySyncStats.getStat(SyncStats::COMP_TIME));
+}
 
-        ZZ newBegin = begRange + childPos * step; // beginning point of the range of the appropriate child
-        ZZ newEnd = (childPos == pFactor - 1) ?
-                    endRange : // last elements lumped into the last child
-                    min(newBegin + step, endRange); // don't overrun the end range of the parent node
+InterCPISync::DepthStats &InterCPISync::_depthStats(long depth) {
+    if ((long) depthStats.size() <= depth)
+        depthStats.resize(depth + 1, DepthStats());
+    return depthStats[depth];
+}
 
-        // recursively add newDatum to the appropriate child
-        if (!_addElem(newDatum, treeNode->child[childPos], treeNode, newBegin, newEnd)) return false;
+void InterCPISync::_countNode(long depth, CPISync *node, bool failed) {
+    DepthStats &stats = _depthStats(depth);
+    stats.visited++;
+    if (failed)
+        stats.failed++;
+    if (node != nullptr) {
+        stats.interpTime += node->getInterpTime();
+        stats.rootTime += node->getRootTime();
+        node->resetReconcileTimes();
+    }
+}
+
+void InterCPISync::_chargeBytes(const shared_ptr<Communicant> &commSync, long depth) {
+    DepthStats &stats = _depthStats(depth);
+    stats.xmitBytes += commSync->getXmitBytesTot() - chargedXmit;
+    stats.recvBytes += commSync->getRecvBytesTot() - chargedRecv;
+    chargedXmit = commSync->getXmitBytesTot();
+    chargedRecv = commSync->getRecvBytesTot();
+}
 
-        // create nodes for all NULL children
-        for (long ii = 0; ii < pFactor - 1; ii++)
-            if (treeNode->child[ii] == nullptr)
-                _createTreeNode(treeNode->child[ii], treeNode, begRange + ii * step, begRange + (ii + 1) * step);
+void InterCPISync::_recordTotals(const shared_ptr<Communicant> &commSync) {
+    // every byte since the sync parameters, including those exchanged by the nodes themselves
+    mySyncStats.reset(SyncStats::XMIT);
+    mySyncStats.reset(SyncStats::RECV);
+    mySyncStats.increment(SyncStats::XMIT, commSync->getXmitBytesTot());
+    mySyncStats.increment(SyncStats::RECV, commSync->getRecvBytesTot());
+    roundTrips = (long) commSync->getRoundTripsTot();
+}
 
-        if (treeNode->child[pFactor - 1] == nullptr) // last case is special
-            _createTreeNode(treeNode->child[pFactor - 1], treeNode, begRange + (pFactor - 1) * step, endRange);
-    }
-    return true;
+ZZ_p InterCPISync::_hash(shared_ptr<DataObject>datum) const {
+    if (hashes)
+        return to_ZZ_p(elementHash(*datum));
+
+    ZZ num = datum->to_ZZ(); // convert the datum to a ZZ
+    return to_ZZ_p(num % DATA_MAX); // reduce to bit_num bits and make into a ZZ_p
 }
 
-bool InterCPISync::_delElem(shared_ptr<DataObject> datum, pTree * &node, const ZZ &begRange, const ZZ &endRange) {
+bool InterCPISync::_delElem(shared_ptr<DataObject> datum, long node, const ZZ &begRange, const ZZ &endRange) {
 	// Compute the hash of the element to find out which children to search if it is present in the parent
 	addElemHashID = rep(_hash(datum));
 
 	//If you are in the parent node and delete fails the element is not in your tree
-	if(node == treeNode){
-		//Only print logger details when you first enter (When node == parentNode)
+	if(node == 0){
+		//Only print logger details when you first enter (When node is the root)
 		Logger::gLog(Logger::METHOD,"Entering recursive InterCPISync::delElem");
 		Logger::gLog(Logger::METHOD_DETAILS, ". (InterCPISync) removing item recursively" + datum->print());
-		if(!node->getDatum()->delElem(datum)) return false;
+		if(!tree.getDatum(node).delElem(datum)) return false;
 	}
 	//If you've deleted the last element from the branch and you are not in the parent node you have succeeded
-	if (node->getDatum()->getNumElem() == 0) {
+	if (tree.getDatum(node).getNumElem() == 0) {
 		return true;
 	}
 
@@ -325,134 +474,31 @@ bool InterCPISync::_delElem(shared_ptr<DataObject> datum, pTree * &node, const Z
 				endRange : // last elements lumped into the last child
 				min(newBegin + step, endRange); // don't overrun the end range of the parent node
 
-	//Recurse if the child pointer has elements in it
-	if (node->child[childPos] != nullptr && node->child[childPos]->getDatum()->getNumElem() != 0) {
-		return _delElem(datum, node->child[childPos], newBegin, newEnd);
+	//Recurse if the child has elements in it
+	long child = tree.child(node, childPos);
+	if (child != pTree::NONE && tree.getDatum(child).getNumElem() != 0) {
+		return _delElem(datum, child, newBegin, newEnd);
 	}
 	else return true;
 }
 
-
-
-
-
-// Recursive helper function for SyncClient
-
-bool InterCPISync::_SyncClient(const shared_ptr<Communicant> &commSync, list<shared_ptr<DataObject>> &selfMinusOther,
-							   list<shared_ptr<DataObject>> &otherMinusSelf, pTree *&treeNode) {
-	Logger::gLog(Logger::METHOD,"Entering InterCPISync::SyncClient");
-		try {
-			// Declare whether we have an empty node or not
-			int response; // the other's declaration
-			if (treeNode == nullptr) {// Case 0:  I've got nothing; the other must have something
-				Logger::gLog(Logger::METHOD_DETAILS, "My node is empty");
-				commSync->commSend(SYNC_NO_INFO);
-				response = commSync->commRecv_byte(); // get the other Communicant's initial declaration
-
-				if (response != SYNC_NO_INFO) // it is not the case that both nodes are empty
-					CPISync::receiveAllElem(commSync, otherMinusSelf);
-					return true;
-			} else
-				commSync->commSend(SYNC_SOME_INFO); // I have some elements
-
-			// Otherwise, I have something in this node
-			CPISync *node = treeNode->getDatum(); // the current node
-			response = commSync->commRecv_byte(); // get the other Communicants initial declaration
-
-			Logger::gLog(Logger::METHOD_DETAILS, "My node has " + toStr(node->getNumElem()) + " elements.");
-			Logger::gLog(Logger::COMM, " ... data is " + node->printElem());
-			if (response == SYNC_NO_INFO) {// Case 1:  I have something; the other has nothing
-				node->sendAllElem(commSync, selfMinusOther); // send all I've got
-				return true;
-			} else { // Case 2: We both have something
-				// synchronize the current node
-				node->SyncClient(commSync, selfMinusOther, otherMinusSelf); // attempt synchroniztion
-				if (commSync->commRecv_byte() == SYNC_FAIL_FLAG) { // i.e. the sync is reported by the Server to have failed; recurse
-					Logger::gLog(Logger::METHOD_DETAILS, " > dividing into children");
-					// synchronize the children, in order
-					for (int ii = 0; ii < pFactor; ii++) {
-						Logger::gLog(Logger::METHOD_DETAILS, "  CHILD: " + toStr(ii));
-						_SyncClient(commSync, selfMinusOther, otherMinusSelf, treeNode->child[ii]);
-					}
-					Logger::gLog(Logger::METHOD_DETAILS, "< returning from division");
-				}
-			return true;
-			}
-		} catch (const SyncFailureException& s) {
-			Logger::gLog(Logger::METHOD_DETAILS, s.what());
-			commSync->commClose();
-			throw (s);
-		}
-}
-
-
 // Recursive helper function for SyncServer
 bool InterCPISync::_SyncServer(const shared_ptr<Communicant> &commSync, list<shared_ptr<DataObject>> &selfMinusOther,
-							   list<shared_ptr<DataObject>> &otherMinusSelf, pTree *&treeNode) {
-
-	Logger::gLog(Logger::METHOD,"Entering InterCPISync::SyncServer");
-	// Declare whether we have an empty node or not
-	int response; // the other's declaration
-
-	if (treeNode == nullptr || treeNode->getDatum()->getNumElem() == 0) {// Case 0:  I've got nothing; the other must have something
-		Logger::gLog(Logger::METHOD_DETAILS, "My node is empty");
-		commSync->commSend(SYNC_NO_INFO);
-		response = commSync->commRecv_byte(); // get the other Communicants initial declaration
-
-		if (response != SYNC_NO_INFO) // it is not the case that both nodes are empty
-			CPISync::receiveAllElem(commSync, otherMinusSelf);
-			return true;
-	} else
-		commSync->commSend(SYNC_SOME_INFO); // I have some elements
-
-	// Otherwise, I have something in this node
-	CPISync *node = treeNode->getDatum(); // the current node
-
-	response = commSync->commRecv_byte(); // get the other Communicants initial declaration
-
-	Logger::gLog(Logger::METHOD_DETAILS, "My node has " + toStr(node->getNumElem()) + " elements.");
-	Logger::gLog(Logger::COMM, " ... data is " + node->printElem());
-	if (response == SYNC_NO_INFO) {// Case 1:  I have something; the other has nothing
-		node->sendAllElem(commSync, selfMinusOther); // send all I've got
-		return true;
-	} else { // Case 2: We both have something
-		// synchronize the current node
-		if (!node->SyncServer(commSync, selfMinusOther, otherMinusSelf)) { // sync failure - go on with children
-			commSync->commSend(SYNC_FAIL_FLAG); // notify the client to try the children
-
-		Logger::gLog(Logger::METHOD_DETAILS, " > dividing into children");
-		// synchronize the children, in order
-		for (int ii = 0; ii < pFactor; ii++) {
-			Logger::gLog(Logger::METHOD_DETAILS, "  CHILD: " + toStr(ii));
-			_SyncServer(commSync, selfMinusOther, otherMinusSelf, treeNode->child[ii]);
-		}
-		Logger::gLog(Logger::METHOD_DETAILS, "< returning from division");
-
-		} else
-			commSync->commSend(SYNC_OK_FLAG); // notify the client that sync succeeded ... do not recurse
-
-		return true; // should always return true
-	}
-}
-
-bool InterCPISync::_SyncServer(const shared_ptr<Communicant> &commSync, list<shared_ptr<DataObject>> &selfMinusOther,
-							   list<shared_ptr<DataObject>> &otherMinusSelf, pTree *treeNode, const ZZ &begRange,
-							   const ZZ &endRange) {
+							   list<shared_ptr<DataObject>> &otherMinusSelf, long node, const NodeRange &range) {
 
 	//Establish initial Handshakes - Check If I have nothing or If Client has nothing
 	int response;
 
-	if(treeNode == nullptr || treeNode->getDatum()->getNumElem() == 0){
+	if(node == pTree::NONE || tree.getDatum(node).getNumElem() == 0){
         mySyncStats.timerStart(SyncStats::COMM_TIME);
         commSync->commSend(SYNC_NO_INFO);
 		response = commSync->commRecv_byte();
 		if(response!=SYNC_NO_INFO)
 			CPISync::receiveAllElem(commSync, otherMinusSelf);
-
-        mySyncStats.increment(SyncStats::RECV,commSync->getRecvBytes());
-        mySyncStats.increment(SyncStats::XMIT,commSync->getXmitBytes());
-
         mySyncStats.timerEnd(SyncStats::COMM_TIME);
+
+        _countNode(range.depth, nullptr, false);
+        _chargeBytes(commSync, range.depth);
         return true;
 	}
 	else {
@@ -464,91 +510,69 @@ bool InterCPISync::_SyncServer(const shared_ptr<Communicant> &commSync, list<sha
         response = commSync->commRecv_byte();
         mySyncStats.timerEnd(SyncStats::IDLE_TIME);
 
-        CPISync *node = treeNode->getDatum();
+        CPISync *curr = &tree.getDatum(node);
 
         mySyncStats.timerStart(SyncStats::COMM_TIME);
         if (response == SYNC_NO_INFO) {
-            node->sendAllElem(commSync, selfMinusOther); // send all I've got
+            curr->sendAllElem(commSync, selfMinusOther); // send all I've got
             mySyncStats.timerEnd(SyncStats::COMM_TIME);
+            _countNode(range.depth, nullptr, false);
+            _chargeBytes(commSync, range.depth);
             return true;
         } else {
             mySyncStats.timerEnd(SyncStats::COMM_TIME);
             //Attempt Sync on current node
-            if (!node->SyncServer(commSync, selfMinusOther,
+            if (!curr->SyncServer(commSync, selfMinusOther,
                                   otherMinusSelf)) { // sync failure - create Children and go try to sync
 
                 // Accumulate stats from each CPISync in InterCPISyncs mySyncStats object
-                mySyncStats.increment(SyncStats::XMIT, node->mySyncStats.getStat(SyncStats::XMIT));
-                mySyncStats.increment(SyncStats::RECV, node->mySyncStats.getStat(SyncStats::RECV));
-                mySyncStats.increment(SyncStats::COMM_TIME, node->mySyncStats.getStat(SyncStats::COMM_TIME));
-                mySyncStats.increment(SyncStats::IDLE_TIME, node->mySyncStats.getStat(SyncStats::IDLE_TIME));
-                mySyncStats.increment(SyncStats::COMP_TIME, node->mySyncStats.getStat(SyncStats::COMP_TIME));
-
+                _addNodeStats(curr);
+                _countNode(range.depth, curr, true);
 
                 mySyncStats.timerStart(SyncStats::COMM_TIME);
                 commSync->commSend(SYNC_FAIL_FLAG);
                 mySyncStats.timerEnd(SyncStats::COMM_TIME);
+                _chargeBytes(commSync, range.depth);
 
                 mySyncStats.timerStart(SyncStats::COMP_TIME);
-                auto *tempTree = new pTree(
-                        new CPISync_ExistingConnection(maxDiff, bitNum, probEps, redundant_k, hashes), pFactor);
-                createChildren(treeNode, tempTree, begRange, endRange);//Create child Nodes;
-                treeNode = tempTree;                    //Update the current parent node(parent node only used for referencing the child nodes)
-                ZZ step = (endRange - begRange) / pFactor;
+                createChildren(node, range);//Create child Nodes;
+                vector<NodeRange> children = _childRanges(range);
                 mySyncStats.timerEnd(SyncStats::COMP_TIME);
-                //if(step ==0) step = 1;
-                for (int ii = 0; ii < pFactor - 1; ii++) {
-                    _SyncServer(commSync, selfMinusOther, otherMinusSelf, treeNode->child[ii], begRange + (ii * step),
-                                begRange + (ii + 1) * step);
-                }//Last child needs to handle odd pFactors
-                _SyncServer(commSync, selfMinusOther, otherMinusSelf, treeNode->child[pFactor - 1],
-                            begRange + ((pFactor - 1) * step), endRange);
+                for (int ii = 0; ii < pFactor; ii++)
+                    _SyncServer(commSync, selfMinusOther, otherMinusSelf, tree.child(node, ii), children[ii]);
             } else {
+                _addNodeStats(curr);
+                _countNode(range.depth, curr, false);
+
                 mySyncStats.timerStart(SyncStats::COMM_TIME);
                 commSync->commSend(SYNC_OK_FLAG);
                 mySyncStats.timerEnd(SyncStats::COMM_TIME);
+                _chargeBytes(commSync, range.depth);
             }
             return true;
         }
     }
 }
 
-void InterCPISync::createChildren(pTree * parentNode, pTree * tempTree, const ZZ& begRange, const ZZ& endRange){
-
-	ZZ step = (endRange - begRange)/pFactor;//Get the step size of the node to establish bin sizes
-	if(step ==0) step = 1;                  //Set minimum step size to 1 to avoid divide errors
-	long pos;
-	CPISync * nodes[pFactor];
-	if(endRange != begRange){
-		for(int ii=0;ii<pFactor;ii++)
-		{
-			tempTree->child[ii] =  new pTree(new CPISync_ExistingConnection(maxDiff, bitNum, probEps, redundant_k,hashes),pFactor);//Create child nodes for parent
-			nodes[ii] = tempTree->child[ii]->getDatum();//Create references for the child nodes(used for insertion)
-		}	
-		CPISync * parent = parentNode->getDatum();//Get the parent node
-
-		for(auto elem = parent->beginElements();elem!=parent->endElements();elem++){    //Iterate through all parent information
-			ZZ elemZZ = rep(_hash(*elem));
-			pos = pFactor-1;
-			for(int jj=0;jj<pFactor-1;jj++){
-				if((elemZZ >= (begRange +(jj*step))) && (elemZZ < (begRange + (jj+1)*step))){
-					pos = jj;
-					break;
-				}
-			}
-			nodes[pos]->addElem(*elem);//Add to appropriate child
+void InterCPISync::createChildren(long node, const NodeRange &range){
+	if(range.endRange != range.begRange){
+		long first = tree.addChildren(node, maxDiff, bitNum, probEps, redundant_k, hashes);//Create child nodes for parent
+		vector<NodeRange> children = _childRanges(range);
+		for(int ii=0;ii<pFactor;ii++) {
+			CPISync_ExistingConnection &child = tree.getDatum(first + ii);
+			_configureNode(child);
+			child.addElems(_sliceElems(children[ii].sliceBeg, children[ii].sliceEnd)); // the elements in the child's bin
 		}
 	}
 }
 
 bool InterCPISync::_SyncClient(const shared_ptr<Communicant> &commSync, list<shared_ptr<DataObject>> &selfMinusOther,
-							   list<shared_ptr<DataObject>> &otherMinusSelf, pTree *treeNode, const ZZ &begRange,
-							   const ZZ &endRange)
+							   list<shared_ptr<DataObject>> &otherMinusSelf, long node, const NodeRange &range)
 {
 	try{
 	    //Initial Handshakes - Check if I have nothing or server has nothing
 		int response;
-		if(treeNode == nullptr)
+		if(node == pTree::NONE)
 		{
             mySyncStats.timerStart(SyncStats::COMM_TIME);
             commSync->commSend(SYNC_NO_INFO);
@@ -556,49 +580,44 @@ bool InterCPISync::_SyncClient(const shared_ptr<Communicant> &commSync, list<sha
             if (response != SYNC_NO_INFO) // it is not the case that both nodes are empty
 				CPISync::receiveAllElem(commSync, otherMinusSelf);
             mySyncStats.timerEnd(SyncStats::COMM_TIME);
+            _countNode(range.depth, nullptr, false);
+            _chargeBytes(commSync, range.depth);
             return true;
 		} else
             mySyncStats.timerStart(SyncStats::COMM_TIME);
             commSync->commSend(SYNC_SOME_INFO); // I have some elements
             response = commSync->commRecv_byte(); // get the other Communicants initial declaration
 
-            CPISync *node = treeNode->getDatum(); // the current node
+            CPISync *curr = &tree.getDatum(node); // the current node
 
-            Logger::gLog(Logger::METHOD_DETAILS, "My node has " + toStr(node->getNumElem()) + " elements.");
-            Logger::gLog(Logger::COMM, " ... data is " + node->printElem());
+            Logger::gLog(Logger::METHOD_DETAILS, "My node has " + toStr(curr->getNumElem()) + " elements.");
+            Logger::gLog(Logger::COMM, " ... data is " + curr->printElem());
             if (response == SYNC_NO_INFO) {// Case 1:  I have something; the other has nothing
-                node->sendAllElem(commSync, selfMinusOther); // send all I've got
+                curr->sendAllElem(commSync, selfMinusOther); // send all I've got
                 mySyncStats.timerEnd(SyncStats::COMM_TIME);
+                _countNode(range.depth, nullptr, false);
+                _chargeBytes(commSync, range.depth);
                 return true;
             } else { // Case 2: We both have something
                 // synchronize the current node
                 mySyncStats.timerEnd(SyncStats::COMM_TIME);
-                node->SyncClient(commSync, selfMinusOther, otherMinusSelf); // attempt synchroniztion
+                curr->SyncClient(commSync, selfMinusOther, otherMinusSelf); // attempt synchroniztion
 
                 // Accumulate stats from each CPISync in InterCPISyncs mySyncStats object
-                mySyncStats.increment(SyncStats::XMIT,node->mySyncStats.getStat(SyncStats::XMIT));
-                mySyncStats.increment(SyncStats::RECV,node->mySyncStats.getStat(SyncStats::RECV));
-                mySyncStats.increment(SyncStats::COMM_TIME,node->mySyncStats.getStat(SyncStats::COMM_TIME));
-                mySyncStats.increment(SyncStats::IDLE_TIME,node->mySyncStats.getStat(SyncStats::IDLE_TIME));
-                mySyncStats.increment(SyncStats::COMP_TIME,node->mySyncStats.getStat(SyncStats::COMP_TIME));
+                _addNodeStats(curr);
 
-                if (commSync->commRecv_byte() == SYNC_FAIL_FLAG)
+                bool failed = commSync->commRecv_byte() == SYNC_FAIL_FLAG;
+                _countNode(range.depth, curr, failed);
+                _chargeBytes(commSync, range.depth);
+                if (failed)
                 { // i.e. the sync is reported by the Server to have failed; recurse
                     mySyncStats.timerStart(SyncStats::COMP_TIME);
-                    auto *tempTree = new pTree(new CPISync_ExistingConnection(maxDiff, bitNum, probEps, redundant_k,hashes),pFactor);
-                    createChildren(treeNode, tempTree, begRange, endRange);//Create child Nodes;
-                    treeNode = tempTree;				    //Update the current parent node(temp parent only children are used)
-                    ZZ step = (endRange - begRange)/pFactor;
+                    createChildren(node, range);//Create child Nodes;
+                    vector<NodeRange> children = _childRanges(range);
                     mySyncStats.timerEnd(SyncStats::COMP_TIME);
 
-                    //if(step ==0) step = 1;
-                    for(int ii=0;ii<pFactor-1;ii++)
-                    {
-                        _SyncClient(commSync, selfMinusOther, otherMinusSelf, treeNode->child[ii], begRange + (ii * step),
-                                    begRange + (ii + 1) * step);
-                    }//Last Child needs to handle odd pFactors
-                    _SyncClient(commSync, selfMinusOther, otherMinusSelf, treeNode->child[pFactor - 1],
-                                begRange + ((pFactor - 1) * step), endRange);
+                    for(int ii=0;ii<pFactor;ii++)
+                        _SyncClient(commSync, selfMinusOther, otherMinusSelf, tree.child(node, ii), children[ii]);
                 }
                 return true;
             }
@@ -607,4 +626,535 @@ bool InterCPISync::_SyncClient(const shared_ptr<Communicant> &commSync, list<sha
 		commSync->commClose();
 		throw (s);
 	}
-}
\ No newline at end of file
+}
+
+vector<InterCPISync::NodeRange> InterCPISync::_childRanges(const NodeRange &node) const {
+	ZZ step = (node.endRange - node.begRange) / pFactor; // the children's ranges, as passed on by _SyncServer
+	ZZ bin = (step == 0) ? ZZ_ONE : step;                // the bins into which createChildren divides the elements
+
+	vector<NodeRange> children(pFactor);
+	for (long ii = 0; ii < pFactor; ii++) {
+		NodeRange &child = children[ii];
+		child.depth = node.depth + 1;
+		child.begRange = node.begRange + ii * step;
+		child.endRange = (ii == pFactor - 1) ? node.endRange : node.begRange + (ii + 1) * step;
+
+		if (node.endRange == node.begRange) // createChildren makes no children for an empty range
+			child.sliceBeg = child.sliceEnd = node.sliceBeg;
+		else if (ii == pFactor - 1) { // elements not in any other bin are lumped into the last child
+			child.sliceBeg = max(node.sliceBeg, node.begRange + ii * bin);
+			child.sliceEnd = node.sliceEnd;
+		} else {
+			child.sliceBeg = max(node.sliceBeg, node.begRange + ii * bin);
+			child.sliceEnd = min(node.sliceEnd, node.begRange + (ii + 1) * bin);
+		}
+	}
+	return children;
+}
+
+bool InterCPISync::_SyncClientCompact(const shared_ptr<Communicant> &commSync, list<shared_ptr<DataObject>> &selfMinusOther,
+									  list<shared_ptr<DataObject>> &otherMinusSelf, const NodeRange &range) {
+	try {
+		mySyncStats.timerStart(SyncStats::COMP_TIME);
+		unique_ptr<CPISync_ExistingConnection> built;
+		CPISync_ExistingConnection *node = _compactNode(range, built);
+		mySyncStats.timerEnd(SyncStats::COMP_TIME);
+
+		//Initial Handshakes - Check if I have nothing or server has nothing
+		int response;
+		mySyncStats.timerStart(SyncStats::COMM_TIME);
+		if (node == nullptr) {
+			commSync->commSend(SYNC_NO_INFO);
+			response = commSync->commRecv_byte();
+			if (response != SYNC_NO_INFO) // it is not the case that both nodes are empty
+				CPISync::receiveAllElem(commSync, otherMinusSelf);
+			mySyncStats.timerEnd(SyncStats::COMM_TIME);
+			_countNode(range.depth, nullptr, false);
+			_chargeBytes(commSync, range.depth);
+			return true;
+		}
+		commSync->commSend(SYNC_SOME_INFO); // I have some elements
+		response = commSync->commRecv_byte(); // get the other Communicants initial declaration
+
+		Logger::gLog(Logger::METHOD_DETAILS, "My node has " + toStr(node->getNumElem()) + " elements.");
+		if (response == SYNC_NO_INFO) {// Case 1:  I have something; the other has nothing
+			node->sendAllElem(commSync, selfMinusOther); // send all I've got
+			mySyncStats.timerEnd(SyncStats::COMM_TIME);
+			_countNode(range.depth, nullptr, false);
+			_chargeBytes(commSync, range.depth);
+			return true;
+		}
+
+		// Case 2: We both have something
+		mySyncStats.timerEnd(SyncStats::COMM_TIME);
+		node->SyncClient(commSync, selfMinusOther, otherMinusSelf); // attempt synchroniztion
+		_addNodeStats(node);
+
+		bool failed = commSync->commRecv_byte() == SYNC_FAIL_FLAG;
+		_countNode(range.depth, node, failed);
+		_chargeBytes(commSync, range.depth);
+		if (failed) { // i.e. the sync is reported by the Server to have failed; recurse
+			built.reset(); // the children hold all of this node's elements
+			for (const NodeRange &child : _childRanges(range))
+				_SyncClientCompact(commSync, selfMinusOther, otherMinusSelf, child);
+		}
+		return true;
+	} catch (const SyncFailureException& s) {
+		Logger::gLog(Logger::METHOD_DETAILS, s.what());
+		commSync->commClose();
+		throw (s);
+	}
+}
+
+bool InterCPISync::_SyncServerCompact(const shared_ptr<Communicant> &commSync, list<shared_ptr<DataObject>> &selfMinusOther,
+									  list<shared_ptr<DataObject>> &otherMinusSelf, const NodeRange &range) {
+	mySyncStats.timerStart(SyncStats::COMP_TIME);
+	unique_ptr<CPISync_ExistingConnection> built;
+	CPISync_ExistingConnection *node = _compactNode(range, built);
+	mySyncStats.timerEnd(SyncStats::COMP_TIME);
+
+	//Establish initial Handshakes - Check If I have nothing or If Client has nothing
+	int response;
+	if (node == nullptr) {
+		mySyncStats.timerStart(SyncStats::COMM_TIME);
+		commSync->commSend(SYNC_NO_INFO);
+		response = commSync->commRecv_byte();
+		if (response != SYNC_NO_INFO)
+			CPISync::receiveAllElem(commSync, otherMinusSelf);
+		mySyncStats.timerEnd(SyncStats::COMM_TIME);
+
+		_countNode(range.depth, nullptr, false);
+		_chargeBytes(commSync, range.depth);
+		return true;
+	}
+
+	mySyncStats.timerStart(SyncStats::COMM_TIME);
+	commSync->commSend(SYNC_SOME_INFO);
+	mySyncStats.timerEnd(SyncStats::COMM_TIME);
+
+	mySyncStats.timerStart(SyncStats::IDLE_TIME);
+	response = commSync->commRecv_byte();
+	mySyncStats.timerEnd(SyncStats::IDLE_TIME);
+
+	if (response == SYNC_NO_INFO) {
+		mySyncStats.timerStart(SyncStats::COMM_TIME);
+		node->sendAllElem(commSync, selfMinusOther); // send all I've got
+		mySyncStats.timerEnd(SyncStats::COMM_TIME);
+		_countNode(range.depth, nullptr, false);
+		_chargeBytes(commSync, range.depth);
+		return true;
+	}
+
+	//Attempt Sync on current node
+	if (!node->SyncServer(commSync, selfMinusOther, otherMinusSelf)) { // sync failure - go try to sync the children
+		_addNodeStats(node);
+		_countNode(range.depth, node, true);
+		built.reset(); // the children hold all of this node's elements
+
+		mySyncStats.timerStart(SyncStats::COMM_TIME);
+		commSync->commSend(SYNC_FAIL_FLAG);
+		mySyncStats.timerEnd(SyncStats::COMM_TIME);
+		_chargeBytes(commSync, range.depth);
+
+		for (const NodeRange &child : _childRanges(range))
+			_SyncServerCompact(commSync, selfMinusOther, otherMinusSelf, child);
+	} else {
+		_addNodeStats(node);
+		_countNode(range.depth, node, false);
+
+		mySyncStats.timerStart(SyncStats::COMM_TIME);
+		commSync->commSend(SYNC_OK_FLAG);
+		mySyncStats.timerEnd(SyncStats::COMM_TIME);
+		_chargeBytes(commSync, range.depth);
+	}
+	return true;
+}
+
+CPISync *InterCPISync::_levelSync(const LevelNode &node) {
+	CPISync *sync = node.owned ? node.owned.get()
+	                           : (node.index == pTree::NONE ? nullptr : &tree.getDatum(node.index));
+	return (sync == nullptr || sync->getNumElem() == 0) ? nullptr : sync;
+}
+
+InterCPISync::Level InterCPISync::_rootLevel() {
+	Level level(1);
+	LevelNode &root = level[0];
+	root.range.sliceBeg = root.range.begRange = ZZ_ZERO;
+	root.range.sliceEnd = root.range.endRange = DATA_MAX;
+	root.range.depth = 0;
+	root.index = tree.empty() ? pTree::NONE : 0;
+	root.diff = maxDiff;
+	return level;
+}
+
+InterCPISync::Level InterCPISync::_beginSession(list<shared_ptr<DataObject>> &selfMinusOther,
+												list<shared_ptr<DataObject>> &otherMinusSelf) {
+	if (resumeLevel < 0) { // a new checkpoint, replacing that of the oldest session if there are too many
+		Checkpoint &checkpoint = checkpoints[session];
+		checkpoint = Checkpoint();
+		checkpoint.modifications = modifications;
+		checkpoint.stamp = checkpointClock++;
+		if (checkpoints.size() > MAX_CHECKPOINTS)
+			checkpoints.erase(min_element(checkpoints.begin(), checkpoints.end(),
+			                              [](const pair<const long, Checkpoint> &first, const pair<const long, Checkpoint> &second) {
+			                                  return first.second.stamp < second.second.stamp;
+			                              }));
+		return _rootLevel();
+	}
+
+	// resume from the checkpointed level, each of whose nodes is built from its slice of the index
+	Checkpoint &checkpoint = checkpoints[session];
+	if (checkpoint.latest.number != resumeLevel)
+		checkpoint.latest = std::move(checkpoint.previous);
+	checkpoint.previous = LevelCheckpoint();
+	const LevelCheckpoint &start = checkpoint.latest;
+	selfMinusOther.insert(selfMinusOther.end(), start.selfMinusOther.begin(), start.selfMinusOther.end());
+	otherMinusSelf.insert(otherMinusSelf.end(), start.otherMinusSelf.begin(), start.otherMinusSelf.end());
+
+	Level level(start.ranges.size());
+	for (size_t ii = 0; ii < level.size(); ii++) {
+		level[ii].range = start.ranges[ii];
+		level[ii].index = pTree::NONE;
+		level[ii].diff = start.diffs[ii];
+		level[ii].owned.reset(_materializeNode(level[ii].range.sliceBeg, level[ii].range.sliceEnd));
+		if (level[ii].owned)
+			level[ii].owned->setCurrDiff(level[ii].diff);
+	}
+	return level;
+}
+
+void InterCPISync::_checkpoint(long number, const Level &level, const list<shared_ptr<DataObject>> &selfMinusOther,
+							   const list<shared_ptr<DataObject>> &otherMinusSelf, size_t selfStart, size_t otherStart) {
+	Checkpoint &checkpoint = checkpoints[session];
+	if (checkpoint.latest.number == number) // the level from which the session resumed
+		return;
+	checkpoint.previous = std::move(checkpoint.latest);
+
+	LevelCheckpoint &latest = checkpoint.latest;
+	latest = LevelCheckpoint();
+	latest.number = number;
+	for (const LevelNode &node : level) {
+		latest.ranges.push_back(node.range);
+		latest.diffs.push_back(node.diff);
+	}
+	latest.selfMinusOther.assign(std::next(selfMinusOther.begin(), selfStart), selfMinusOther.end());
+	latest.otherMinusSelf.assign(std::next(otherMinusSelf.begin(), otherStart), otherMinusSelf.end());
+}
+
+bool InterCPISync::_unchanged(const Checkpoint &checkpoint) const {
+	return checkpoint.modifications == modifications;
+}
+
+void InterCPISync::_forEachNode(long num, const function<void(long)> &body) {
+#ifdef NTL_THREADS
+	if (threadPool) {
+		// worker threads start out without the caller's moduli, and the caller may help with other loops' tasks,
+		// which install theirs; the guard puts the caller's back on return
+		FieldContextGuard callerContext;
+		threadPool->parallelForEach(num, [&](long index) {
+			callerContext.restore();
+			body(index);
+		});
+		return;
+	}
+#endif
+	for (long index = 0; index < num; index++)
+		body(index);
+}
+
+InterCPISync::Level InterCPISync::_nextLevel(Level &level, const string &status) {
+	Level next;
+	for (size_t ii = 0; ii < level.size(); ii++) {
+		if (status[ii] != SYNC_FAIL_FLAG)
+			continue;
+		LevelNode &parent = level[ii];
+		if (adaptiveFanout) { // the planned number of children, each built from its slice of the index
+			parent.owned.reset();
+			vector<NodeRange> ranges = _splitRange(parent.range, (long) parent.childDiffs.size());
+			for (size_t jj = 0; jj < ranges.size(); jj++) {
+				LevelNode child;
+				child.range = ranges[jj];
+				child.index = pTree::NONE;
+				child.diff = parent.childDiffs[jj];
+				child.owned.reset(_materializeNode(child.range.sliceBeg, child.range.sliceEnd));
+				if (child.owned)
+					child.owned->setCurrDiff(child.diff);
+				next.push_back(std::move(child));
+			}
+			continue;
+		}
+		bool inTree = !compactTree && parent.index != pTree::NONE; // not so below a resumed level
+		if (inTree)
+			createChildren(parent.index, parent.range);
+		parent.owned.reset(); // the children hold all of this node's elements
+
+		vector<NodeRange> ranges = _childRanges(parent.range);
+		for (long jj = 0; jj < pFactor; jj++) {
+			LevelNode child;
+			child.range = ranges[jj];
+			child.index = inTree ? tree.child(parent.index, jj) : pTree::NONE;
+			child.diff = maxDiff;
+			if (!inTree)
+				child.owned.reset(_materializeNode(child.range.sliceBeg, child.range.sliceEnd));
+			next.push_back(std::move(child));
+		}
+	}
+	return next;
+}
+
+bool InterCPISync::_SyncClientBatched(const shared_ptr<Communicant> &commSync, list<shared_ptr<DataObject>> &selfMinusOther,
+									  list<shared_ptr<DataObject>> &otherMinusSelf) {
+	try {
+		mySyncStats.timerStart(SyncStats::COMP_TIME);
+		_sortIndex();
+		const size_t selfStart = selfMinusOther.size(), otherStart = otherMinusSelf.size();
+		Level level = _beginSession(selfMinusOther, otherMinusSelf);
+		mySyncStats.timerEnd(SyncStats::COMP_TIME);
+
+		for (long number = max(resumeLevel, 0L); !level.empty(); number++) {
+			_checkpoint(number, level, selfMinusOther, otherMinusSelf, selfStart, otherStart);
+
+			// 1. One message: whether I have elements in each node of the level, and the sketch of each that does
+			// (with the adaptive fan-out, followed by counts of its elements over sub-ranges)
+			mySyncStats.timerStart(SyncStats::COMM_TIME);
+			string flags;
+			for (const LevelNode &node : level)
+				flags += (char) (_levelSync(node) == nullptr ? SYNC_NO_INFO : SYNC_SOME_INFO);
+			commSync->commSend(flags);
+			for (const LevelNode &node : level) {
+				CPISync *sync = _levelSync(node);
+				if (sync != nullptr) {
+					commSync->commSend(sync->getNumElem());
+					commSync->commSend(sync->getSketch());
+					if (adaptiveFanout)
+						for (long count : _binCounts(node.range))
+							commSync->commSend(count);
+				}
+			}
+			mySyncStats.timerEnd(SyncStats::COMM_TIME);
+
+			// 2. One reply: the status of each node, then the differences of each node that the server settled
+			mySyncStats.timerStart(SyncStats::IDLE_TIME);
+			string status = commSync->commRecv_string();
+			mySyncStats.timerEnd(SyncStats::IDLE_TIME);
+			if (status.size() != level.size())
+				throw SyncFailureException("Batched level does not match between the synchronizing parties.");
+
+			mySyncStats.timerStart(SyncStats::COMM_TIME);
+			vector<vec_ZZ_p> toSend(level.size()); // hashes of the elements that the server awaits, per node
+			for (size_t ii = 0; ii < level.size(); ii++) {
+				CPISync *sync = _levelSync(level[ii]);
+				if (sync == nullptr) {
+					if (status[ii] == SYNC_SOME_INFO) // Case 1:  the other has something; I have nothing
+						CPISync::receiveAllElem(commSync, otherMinusSelf);
+				} else if (status[ii] == SYNC_OK_FLAG) { // Case 2:  the node was reconciled
+					vec_ZZ_p delta_other = commSync->commRecv_vec_ZZ_p();
+					vec_ZZ_p delta_self = commSync->commRecv_vec_ZZ_p();
+					for (const ZZ_p &hash : delta_other)
+						otherMinusSelf.push_back(hashes ? commSync->commRecv_DataObject() : sync->hashToElement(hash));
+					if (hashes)
+						toSend[ii] = delta_self;
+					else
+						for (const ZZ_p &hash : delta_self)
+							selfMinusOther.push_back(sync->hashToElement(hash));
+				} else if (status[ii] == SYNC_FAIL_FLAG && adaptiveFanout) { // Case 3:  the server's plan for the children
+					long fanout = commSync->commRecv_long();
+					if (fanout < 0 || fanout > ADAPTIVE_BINS)
+						throw SyncFailureException("Invalid fan-out received for a failed node.");
+					level[ii].childDiffs.resize(fanout);
+					for (long &childDiff : level[ii].childDiffs)
+						childDiff = commSync->commRecv_long();
+				}
+			}
+			mySyncStats.timerEnd(SyncStats::COMM_TIME);
+
+			mySyncStats.timerStart(SyncStats::COMP_TIME);
+			for (size_t ii = 0; ii < level.size(); ii++)
+				_countNode(number, _levelSync(level[ii]), status[ii] == SYNC_FAIL_FLAG);
+			Level next = _nextLevel(level, status);
+			mySyncStats.timerEnd(SyncStats::COMP_TIME);
+
+			// 3. The elements that the server awaits, sent just ahead of the next level's message
+			mySyncStats.timerStart(SyncStats::COMM_TIME);
+			for (size_t ii = 0; ii < level.size(); ii++) {
+				CPISync *sync = _levelSync(level[ii]);
+				if (sync != nullptr && status[ii] == SYNC_NO_INFO) // Case 4:  I have something; the other has nothing
+					sync->sendAllElem(commSync, selfMinusOther);
+				for (const ZZ_p &hash : toSend[ii]) {
+					shared_ptr<DataObject> elem = sync->hashToElement(hash);
+					if (elem == nullptr)
+						throw SyncFailureException("Element not found - decrease probability of error requirement for sync.");
+					commSync->commSend(*elem);
+					selfMinusOther.push_back(elem);
+				}
+			}
+			mySyncStats.timerEnd(SyncStats::COMM_TIME);
+			_chargeBytes(commSync, number);
+
+			level = std::move(next);
+		}
+		checkpoints.erase(session); // the session is done
+		clientSession = 0;
+		return true;
+	} catch (const SyncFailureException& s) {
+		Logger::gLog(Logger::METHOD_DETAILS, s.what());
+		commSync->commClose();
+		throw (s);
+	}
+}
+
+bool InterCPISync::_SyncServerBatched(const shared_ptr<Communicant> &commSync, list<shared_ptr<DataObject>> &selfMinusOther,
+									  list<shared_ptr<DataObject>> &otherMinusSelf) {
+	mySyncStats.timerStart(SyncStats::COMP_TIME);
+	_sortIndex();
+	const size_t selfStart = selfMinusOther.size(), otherStart = otherMinusSelf.size();
+	Level level = _beginSession(selfMinusOther, otherMinusSelf);
+	mySyncStats.timerEnd(SyncStats::COMP_TIME);
+
+	for (long number = max(resumeLevel, 0L); !level.empty(); number++) {
+		_checkpoint(number, level, selfMinusOther, otherMinusSelf, selfStart, otherStart);
+
+		// 1. The client's message for the level
+		mySyncStats.timerStart(SyncStats::IDLE_TIME);
+		string flags = commSync->commRecv_string();
+		mySyncStats.timerEnd(SyncStats::IDLE_TIME);
+		if (flags.size() != level.size())
+			throw SyncFailureException("Batched level does not match between the synchronizing parties.");
+
+		mySyncStats.timerStart(SyncStats::COMM_TIME);
+		vector<long> otherSizes(level.size());
+		vector<vec_ZZ_p> otherSketches(level.size());
+		vector<vector<long>> otherBins(level.size());
+		for (size_t ii = 0; ii < level.size(); ii++)
+			if (flags[ii] == SYNC_SOME_INFO) {
+				otherSizes[ii] = commSync->commRecv_long();
+				otherSketches[ii] = commSync->commRecv_vec_ZZ_p();
+				if (adaptiveFanout)
+					for (long bin = 0; bin < ADAPTIVE_BINS; bin++)
+						otherBins[ii].push_back(commSync->commRecv_long());
+			}
+		mySyncStats.timerEnd(SyncStats::COMM_TIME);
+
+		// 2. Reconcile each node where both sides have elements; the nodes are independent, so they are spread across
+		// threads, and each one's results are kept in its own slot to be sent in order
+		mySyncStats.timerStart(SyncStats::COMP_TIME);
+		string status(level.size(), (char) SYNC_NO_INFO);
+		vector<vec_ZZ_p> delta_self(level.size()), delta_other(level.size());
+		_forEachNode((long) level.size(), [&](long ii) {
+			CPISync *sync = _levelSync(level[ii]);
+			if (flags[ii] != SYNC_SOME_INFO) // the client has nothing; say whether I have something to send it
+				status[ii] = (char) (sync == nullptr ? SYNC_NO_INFO : SYNC_SOME_INFO);
+			else if (sync != nullptr)
+				status[ii] = (char) (sync->reconcileSketch(otherSizes[ii], otherSketches[ii], delta_self[ii], delta_other[ii])
+				                     ? SYNC_OK_FLAG : SYNC_FAIL_FLAG);
+			if (status[ii] == SYNC_FAIL_FLAG && adaptiveFanout)
+				level[ii].childDiffs = _planChildren(level[ii].range, _binCounts(level[ii].range), otherBins[ii]);
+		});
+		otherSketches.clear();
+		for (size_t ii = 0; ii < level.size(); ii++)
+			_countNode(number, _levelSync(level[ii]), status[ii] == SYNC_FAIL_FLAG);
+		mySyncStats.timerEnd(SyncStats::COMP_TIME);
+
+		// 3. One reply: the status of each node, then the differences of each node that was settled
+		mySyncStats.timerStart(SyncStats::COMM_TIME);
+		commSync->commSend(status);
+		for (size_t ii = 0; ii < level.size(); ii++) {
+			CPISync *sync = _levelSync(level[ii]);
+			if (flags[ii] != SYNC_SOME_INFO && status[ii] == SYNC_SOME_INFO)
+				sync->sendAllElem(commSync, selfMinusOther); // send all I've got
+			else if (status[ii] == SYNC_OK_FLAG) {
+				commSync->commSend(delta_self[ii]);
+				commSync->commSend(delta_other[ii]);
+				for (const ZZ_p &hash : delta_self[ii]) {
+					shared_ptr<DataObject> elem = sync->hashToElement(hash);
+					if (elem == nullptr)
+						throw SyncFailureException("Element not found - decrease probability of error requirement for sync.");
+					if (hashes)
+						commSync->commSend(*elem);
+					selfMinusOther.push_back(elem);
+				}
+				if (!hashes)
+					for (const ZZ_p &hash : delta_other[ii])
+						otherMinusSelf.push_back(sync->hashToElement(hash));
+			} else if (status[ii] == SYNC_FAIL_FLAG && adaptiveFanout) {
+				commSync->commSend((long) level[ii].childDiffs.size());
+				for (long childDiff : level[ii].childDiffs)
+					commSync->commSend(childDiff);
+			}
+		}
+		mySyncStats.timerEnd(SyncStats::COMM_TIME);
+
+		mySyncStats.timerStart(SyncStats::COMP_TIME);
+		Level next = _nextLevel(level, status);
+		mySyncStats.timerEnd(SyncStats::COMP_TIME);
+
+		// 4. The elements that the client sends after the reply
+		mySyncStats.timerStart(SyncStats::COMM_TIME);
+		for (size_t ii = 0; ii < level.size(); ii++) {
+			if (flags[ii] == SYNC_SOME_INFO && status[ii] == SYNC_NO_INFO)
+				CPISync::receiveAllElem(commSync, otherMinusSelf);
+			else if (status[ii] == SYNC_OK_FLAG && hashes)
+				for (long jj = 0; jj < delta_other[ii].length(); jj++)
+					otherMinusSelf.push_back(commSync->commRecv_DataObject());
+		}
+		mySyncStats.timerEnd(SyncStats::COMM_TIME);
+		_chargeBytes(commSync, number);
+
+		level = std::move(next);
+	}
+	checkpoints.erase(session); // the session is done
+	return true;
+}
+
+vector<long> InterCPISync::_binCounts(const NodeRange &range) const {
+	ZZ length = range.endRange - range.begRange;
+	vector<long> counts(ADAPTIVE_BINS);
+	auto first = lower_bound(hashIndex.begin(), hashIndex.end(), range.begRange, ByHash());
+	for (long ii = 0; ii < ADAPTIVE_BINS; ii++) {
+		auto last = lower_bound(first, hashIndex.end(), ZZ(range.begRange + length * (ii + 1) / ADAPTIVE_BINS), ByHash());
+		counts[ii] = last - first;
+		first = last;
+	}
+	return counts;
+}
+
+vector<long> InterCPISync::_planChildren(const NodeRange &range, const vector<long> &selfBins, const vector<long> &otherBins) const {
+	if (range.endRange - range.begRange < 2) // too narrow to divide
+		return vector<long>();
+
+	// the counts bound the differences in each sub-range from below; the node's failure bounds their total
+	vector<long> binDiffs(ADAPTIVE_BINS);
+	long counted = 0;
+	for (long ii = 0; ii < ADAPTIVE_BINS; ii++) {
+		binDiffs[ii] = labs(selfBins[ii] - otherBins[ii]);
+		counted += binDiffs[ii];
+	}
+	long total = max(counted, maxDiff + 1);
+
+	// enough children that each is expected to differ in at most half of maxDiff elements
+	long target = max(1L, maxDiff / 2), fanout = 2;
+	while (fanout < ADAPTIVE_BINS && total > fanout * target)
+		fanout *= 2;
+
+	// each child's bound is twice its counted differences, plus an even share of those that the counts cannot see
+	long binsPerChild = ADAPTIVE_BINS / fanout, unseen = (total - counted + fanout - 1) / fanout;
+	vector<long> childDiffs(fanout);
+	for (long jj = 0; jj < fanout; jj++) {
+		long estimate = unseen;
+		for (long ii = jj * binsPerChild; ii < (jj + 1) * binsPerChild; ii++)
+			estimate += binDiffs[ii];
+		childDiffs[jj] = min(maxDiff, 2 * estimate + 2);
+	}
+	return childDiffs;
+}
+
+vector<InterCPISync::NodeRange> InterCPISync::_splitRange(const NodeRange &range, long num) const {
+	ZZ length = range.endRange - range.begRange;
+	vector<NodeRange> children(num);
+	for (long jj = 0; jj < num; jj++) {
+		children[jj].sliceBeg = children[jj].begRange = range.begRange + length * jj / num;
+		children[jj].sliceEnd = children[jj].endRange = range.begRange + length * (jj + 1) / num;
+		children[jj].depth = range.depth + 1;
+	}
+	return children;
+}
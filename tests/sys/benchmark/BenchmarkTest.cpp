@@ -167,6 +167,94 @@ void BenchmarkTest::BitThresholdTest()
 	cout << syncStatsMax;
 }
 
+void BenchmarkTest::InterpScalingTest()
+{
+	const int MAX_TIME = 10;	  // Stop doubling once a sync takes more than this many seconds
+	const long MAX_MBAR = 100000; // Largest mbar to try with either engine
+	const int SIMILAR = 16;		  // Number of elements in common between the server and client
+
+	for (INTERP_TYPE interp : {INTERP_TYPE::Gauss, INTERP_TYPE::Fast})
+	{
+		string engine = (interp == INTERP_TYPE::Gauss) ? "Gauss" : "Fast";
+		long mbar = 2;
+		while (true)
+		{
+			GenSync GenSyncServer = GenSync::Builder().
+					setProtocol(GenSync::SyncProtocol::CPISync).
+					setComm(GenSync::SyncComm::socket).
+					setBits(eltSize * 8). // Bytes to bits
+					setMbar(mbar).
+					setErr(err).
+					setInterpType(interp).
+					build();
+
+			GenSync GenSyncClient = GenSync::Builder().
+					setProtocol(GenSync::SyncProtocol::CPISync).
+					setComm(GenSync::SyncComm::socket).
+					setBits(eltSize * 8). // Bytes to bits
+					setMbar(mbar).
+					setErr(err).
+					setInterpType(interp).
+					build();
+
+			// mbar/2 differences on each side
+			CPPUNIT_ASSERT(benchmarkSync(GenSyncClient, GenSyncServer, SIMILAR, mbar / 2, mbar / 2, false, false));
+			cout << engine << " interpolation, mbar = " << mbar << ": server computation " << GenSyncServer.getCompTime(0)
+				 << "s, total " << GenSyncServer.getTotalTime(0) << "s" << endl;
+
+			if (GenSyncServer.getTotalTime(0) > MAX_TIME || mbar >= MAX_MBAR)
+				break;
+			mbar = min(2 * mbar, MAX_MBAR);
+		}
+	}
+}
+
+void BenchmarkTest::WordKernelBenchmark()
+{
+	const long NUM_SAMPLES = 100000; // Number of sample locations (i.e., mbar)
+	const int NUM_ROOTS = 200;		 // Number of elements added
+
+	for (long prime : {NextPrime(1L << 30), NextPrime(1L << 40)})
+	{
+		zz_pPush push(prime);
+		vec_zz_p samples, roots, expected;
+		random(samples, NUM_SAMPLES);
+		random(roots, NUM_ROOTS);
+		expected.SetLength(NUM_SAMPLES, zz_p(1));
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (const zz_p &root : roots)
+			for (long ii = 0; ii < NUM_SAMPLES; ii++)
+				expected[ii] *= samples[ii] - root;
+		double baseline = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count()
+						  / (NUM_SAMPLES * NUM_ROOTS);
+		cout << "p ~ 2^" << NumBits(prime) - 1 << ", zz_p: " << baseline << " ns/sample" << endl;
+
+		for (auto limit : {CPIMontgomery::Isa::Scalar, CPIMontgomery::Isa::AVX2, CPIMontgomery::Isa::AVX512F,
+						   CPIMontgomery::Isa::AVX512IFMA})
+		{
+			CPIMontgomery mont(prime, limit);
+			if (mont.isa() != limit)
+				continue; // not available for this modulus or CPU
+
+			vector<long> factors(NUM_SAMPLES), vals(NUM_SAMPLES, 1);
+			for (long ii = 0; ii < NUM_SAMPLES; ii++)
+				factors[ii] = mont.toMont(rep(samples[ii]));
+
+			start = std::chrono::high_resolution_clock::now();
+			for (const zz_p &root : roots)
+				mont.mulSub(vals.data(), factors.data(), mont.toMont(rep(root)), NUM_SAMPLES);
+			double kernel = std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count()
+							/ (NUM_SAMPLES * NUM_ROOTS);
+			cout << "p ~ 2^" << NumBits(prime) - 1 << ", " << CPIMontgomery::isaName(limit) << ": " << kernel
+				 << " ns/sample (" << baseline / kernel << "x)" << endl;
+
+			for (long ii = 0; ii < NUM_SAMPLES; ii++)
+				CPPUNIT_ASSERT_EQUAL(rep(expected[ii]), vals[ii]);
+		}
+	}
+}
+
 void BenchmarkTest::CPISyncLongTerm()
 {
 
@@ -29,6 +29,8 @@ class BenchmarkTest : public CPPUNIT_NS::TestFixture
 	CPPUNIT_TEST(IBLTSyncErrBenchMark);
 	CPPUNIT_TEST(TimedSyncThreshold);
 	CPPUNIT_TEST(BitThresholdTest);
+	CPPUNIT_TEST(InterpScalingTest);
+	CPPUNIT_TEST(WordKernelBenchmark);
 
 	CPPUNIT_TEST_SUITE_END();
 
@@ -58,6 +60,20 @@ class BenchmarkTest : public CPPUNIT_NS::TestFixture
 	 */
 	static void BitThresholdTest();
 
+	/**
+	 * Runs CPISync with each rational function interpolation engine (Gauss and Fast), doubling mbar (and the number
+	 * of differences with it) up to MAX_MBAR or until a sync no longer completes in under MAX_TIME seconds.
+	 * Prints out the server's computation time for each sync.
+	 */
+	static void InterpScalingTest();
+
+	/**
+	 * Times the inner loop of CPISync's add path over a word-sized field (multiplying each evaluation by the sample
+	 * location minus the added element) with NTL's zz_p arithmetic and with each available CPIMontgomery kernel.
+	 * Prints the time per sample location and the speedup over zz_p for each kernel, and checks that all agree.
+	 */
+	static void WordKernelBenchmark();
+
 	/**
 	 * A sync that mimics a client making itterative changes and periodically syncing those changes to a server to simulate
 	 * an actual use case
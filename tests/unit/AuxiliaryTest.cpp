@@ -8,6 +8,7 @@
  */
 
 #include <CPISync/Aux/Auxiliary.h>
+#include <CPISync/Aux/ElementHash.h>
 #include "AuxiliaryTest.h"
 #include <NTL/ZZ_p.h>
 
@@ -211,3 +212,60 @@ void AuxiliaryTest::testMultisetSubset() {
     multiset<int> subset3 = multisetSubset(set1, -3);
     CPPUNIT_ASSERT_EQUAL((size_t) 0, subset3.size());
 }
+
+void AuxiliaryTest::testParyTree() {
+    const long ARITY = 3;
+    paryTree<string> tree(ARITY);
+    CPPUNIT_ASSERT(tree.empty());
+
+    CPPUNIT_ASSERT_EQUAL(0L, tree.addRoot("root"));
+    CPPUNIT_ASSERT(!tree.hasChildren(0));
+    CPPUNIT_ASSERT_EQUAL(paryTree<string>::NONE, tree.child(0, 0));
+
+    // the children of a node are added together, after all existing nodes
+    long first = tree.addChildren(0, "child");
+    CPPUNIT_ASSERT_EQUAL(1L, first);
+    for (long ii = 0; ii < ARITY; ii++) {
+        CPPUNIT_ASSERT_EQUAL(first + ii, tree.child(0, ii));
+        tree.getDatum(first + ii) += toStr(ii);
+    }
+    long grandchild = tree.addChildren(tree.child(0, 2), "grandchild");
+    CPPUNIT_ASSERT_EQUAL(1 + 2 * ARITY, tree.size());
+    CPPUNIT_ASSERT_EQUAL(string("child2"), tree.getDatum(tree.child(0, 2)));
+    CPPUNIT_ASSERT_EQUAL(string("grandchild"), tree.getDatum(grandchild));
+
+    // truncating removes nodes along with the links to them
+    tree.truncate(1 + ARITY);
+    CPPUNIT_ASSERT_EQUAL(1 + ARITY, tree.size());
+    CPPUNIT_ASSERT(tree.hasChildren(0));
+    CPPUNIT_ASSERT(!tree.hasChildren(tree.child(0, 2)));
+
+    tree.clear();
+    CPPUNIT_ASSERT(tree.empty());
+}
+
+void AuxiliaryTest::testElementHash() {
+    const long BITS[] = {20, 64, 150}; // within one lane, exactly one, and over several
+    DataObject longElem(string(1000, 'x')), shortElem(string("x")), pairElem(string("xx"));
+
+    for (long bits : BITS) {
+        ElementHash keyed(HASH_TYPE::Keyed, bits), otherKey(HASH_TYPE::Keyed, bits, 12345);
+        ZZ hash = keyed(longElem);
+        CPPUNIT_ASSERT(hash == keyed(DataObject(string(1000, 'x'))));
+        CPPUNIT_ASSERT(hash < power(ZZ_TWO, bits));
+        CPPUNIT_ASSERT(hash != otherKey(longElem));
+        CPPUNIT_ASSERT(keyed(shortElem) != keyed(pairElem));
+    }
+
+    // the modulo hash keeps the encoding of small elements
+    ElementHash modulo(HASH_TYPE::Modulo, 64);
+    CPPUNIT_ASSERT(modulo(shortElem) == shortElem.to_ZZ());
+
+    // hash64 only depends on the bytes, not on how they are aligned
+    unsigned char bytes[40];
+    for (int ii = 0; ii < 40; ii++)
+        bytes[ii] = (unsigned char) (ii * 7);
+    vector<unsigned char> copy(bytes + 3, bytes + 40);
+    CPPUNIT_ASSERT_EQUAL(ElementHash::hash64(copy.data(), copy.size(), 1), ElementHash::hash64(bytes + 3, 37, 1));
+    CPPUNIT_ASSERT(ElementHash::hash64(bytes, 40, 1) != ElementHash::hash64(bytes, 40, 2));
+}
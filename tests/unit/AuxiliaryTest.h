@@ -25,6 +25,8 @@ class AuxiliaryTest : public CPPUNIT_NS::TestFixture {
     CPPUNIT_TEST(testMultisetUnion);
     CPPUNIT_TEST(testMultisetSubset);
 	CPPUNIT_TEST(testSplit);
+	CPPUNIT_TEST(testParyTree);
+	CPPUNIT_TEST(testElementHash);
 
     CPPUNIT_TEST_SUITE_END();
 
@@ -95,6 +97,16 @@ private:
 	 * Tests that MultisetSubset correctly returns a subset of the correct size from the given multiset
 	 */
 	static void testMultisetSubset();
+
+	/**
+	 * Tests that paryTree links each node to its children, and that truncating it removes both nodes and links
+	 */
+	static void testParyTree();
+
+	/**
+	 * Test that ElementHash's keyed hash is deterministic, within range, and sensitive to its key and to the element.
+	 */
+	static void testElementHash();
 };
 
 CPPUNIT_TEST_SUITE_NAMED_REGISTRATION( AuxiliaryTest, AuxiliaryTest );
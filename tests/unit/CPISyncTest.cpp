@@ -5,10 +5,34 @@
 #include <CPISync/Syncs/CPISync.h>
 #include "CPISyncTest.h"
 #include <CPISync/Syncs/InterCPISync.h>
+#include <CPISync/Communicants/CommSocket.h>
+#include <CPISync/Aux/Exceptions.h>
+#include <sys/wait.h>
 #include "TestAuxiliary.h"
 
 CPPUNIT_TEST_SUITE_REGISTRATION(CPISyncTest);
 
+namespace {
+	/** A socket whose connection is lost once it has sent a given number of bytes. */
+	class DroppingSocket : public CommSocket {
+	public:
+		DroppingSocket(int port, string host, long budget) : CommSocket(port, std::move(host)), budget(budget) {}
+		using CommSocket::commSend;
+
+		void commSend(const char *toSend, size_t numBytes) override {
+			budget -= (long) numBytes;
+			if (budget < 0) {
+				commClose();
+				throw SyncFailureException("Connection lost.");
+			}
+			CommSocket::commSend(toSend, numBytes);
+		}
+
+	private:
+		long budget; /** The number of bytes left to send before the connection is lost. */
+	};
+}
+
 CPISyncTest::CPISyncTest() = default;
 
 CPISyncTest::~CPISyncTest() = default;
@@ -56,6 +80,349 @@ void CPISyncTest::testCPIAddDelElem() {
 	CPPUNIT_ASSERT(cpisync.printElem().empty());
 }
 
+void CPISyncTest::testCPIAddElems() {
+	const int ITEMS = 600; // more items than sample points, so that several product-tree blocks are used
+	const int DIFS = 20; // elements unique to each of the client and the server
+	CPISync bulk(mBar, eltSizeSq, err, 0), single(mBar, eltSizeSq, err, 0);
+
+	list<shared_ptr<DataObject>> items;
+	for (int ii = 0; ii < ITEMS; ii++)
+		items.push_back(make_shared<DataObject>(randZZ()));
+
+	// check that a bulk add stores the same elements, under the same hashes, as single adds
+	CPPUNIT_ASSERT(bulk.addElems(items));
+	for (const auto& item : items)
+		CPPUNIT_ASSERT(single.addElem(item));
+	CPPUNIT_ASSERT(bulk.getNumElem() == ITEMS);
+	CPPUNIT_ASSERT(bulk.printElem() == single.printElem());
+
+	// check that a bulk-loaded server reconciles with an incrementally loaded client
+	list<shared_ptr<DataObject>> serverData(items);
+	for (int ii = 0; ii < DIFS; ii++)
+		serverData.push_back(make_shared<DataObject>(randZZ()));
+
+	GenSync GenSyncServer({make_shared<CommSocket>(8001)}, {make_shared<CPISync>(mBar, eltSizeSq, err)},
+						  SyncMethod::postProcessing_SET, serverData);
+
+	GenSync GenSyncClient = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSizeSq).
+			setMbar(mBar).
+			setErr(err).
+			build();
+	for (const auto& item : items)
+		GenSyncClient.addElem(item);
+	for (int ii = 0; ii < DIFS; ii++)
+		GenSyncClient.addElem(make_shared<DataObject>(randZZ()));
+
+	CPPUNIT_ASSERT(forkHandle(GenSyncClient, GenSyncServer).success);
+	CPPUNIT_ASSERT(GenSyncClient.dumpElements().size() == ITEMS + 2 * DIFS);
+}
+
+void CPISyncTest::testCPIDelElems() {
+	const int ITEMS = 300; // number of elements kept
+	const int DIFS = 20; // elements unique to each of the client and the server
+	CPISync churned(mBar, eltSizeSq, err, 0), fresh(mBar, eltSizeSq, err, 0);
+
+	list<shared_ptr<DataObject>> kept, removed;
+	for (int ii = 0; ii < ITEMS; ii++) {
+		kept.push_back(make_shared<DataObject>(randZZ()));
+		removed.push_back(make_shared<DataObject>(randZZ()));
+	}
+
+	// check that adding and then batch-deleting leaves the same data as only adding the kept elements
+	CPPUNIT_ASSERT(churned.addElems(kept));
+	CPPUNIT_ASSERT(churned.addElems(removed));
+	CPPUNIT_ASSERT(churned.delElems(removed));
+	CPPUNIT_ASSERT(fresh.addElems(kept));
+	CPPUNIT_ASSERT(churned.getNumElem() == ITEMS);
+	CPPUNIT_ASSERT(churned.printElem() == fresh.printElem());
+	CPPUNIT_ASSERT(!churned.delElems(removed)); // these are no longer present
+
+	// check that the characteristic polynomial evaluations were updated by reconciling the churned set
+	GenSync GenSyncServer = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSizeSq).
+			setMbar(mBar).
+			setErr(err).
+			build();
+	GenSyncServer.addElems(kept);
+	GenSyncServer.addElems(removed);
+	CPPUNIT_ASSERT(GenSyncServer.delElems(removed));
+
+	// a batch with an element that is not present is refused as a whole, leaving the data and the sketch alone
+	list<shared_ptr<DataObject>> partial = {kept.front(), make_shared<DataObject>(randZZ())};
+	CPPUNIT_ASSERT(!GenSyncServer.delElems(partial));
+	CPPUNIT_ASSERT(GenSyncServer.dumpElements().size() == ITEMS);
+
+	for (int ii = 0; ii < DIFS; ii++)
+		GenSyncServer.addElem(make_shared<DataObject>(randZZ()));
+
+	GenSync GenSyncClient = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSizeSq).
+			setMbar(mBar).
+			setErr(err).
+			build();
+	GenSyncClient.addElems(kept);
+	for (int ii = 0; ii < DIFS; ii++)
+		GenSyncClient.addElem(make_shared<DataObject>(randZZ()));
+
+	CPPUNIT_ASSERT(forkHandle(GenSyncClient, GenSyncServer).success);
+	CPPUNIT_ASSERT(GenSyncClient.dumpElements().size() == ITEMS + 2 * DIFS);
+}
+
+void CPISyncTest::testCPISnapshot() {
+	const int ITEMS = 300; // number of elements kept
+	const int DELETED = 20; // number of elements deleted before the snapshot
+	const int DIFS = 20; // elements unique to each of the client and the server
+	const string dataFile = temporaryDir() + "/cpisnapshot" + toStr(rand());
+
+	// populate a file-backed GenSync, with some churn, and snapshot it
+	list<shared_ptr<DataObject>> kept, removed;
+	{
+		GenSync original({make_shared<CommSocket>(8001)}, {make_shared<CPISync>(mBar, eltSizeSq, err)}, dataFile);
+		for (int ii = 0; ii < ITEMS; ii++) {
+			kept.push_back(make_shared<DataObject>(randZZ()));
+			original.addElem(kept.back());
+		}
+		for (int ii = 0; ii < DELETED; ii++) {
+			removed.push_back(make_shared<DataObject>(randZZ()));
+			original.addElem(removed.back());
+		}
+		CPPUNIT_ASSERT(original.delElems(removed));
+		CPPUNIT_ASSERT(original.saveSnapshot());
+	}
+
+	// the snapshot is only accepted against the data file it was made with
+	ifstream inFile(dataFile.c_str(), ios::binary);
+	stringstream contents;
+	contents << inFile.rdbuf();
+	inFile.close();
+	const string fileBytes = contents.str();
+	uint64_t checksum = fnv1a64(fileBytes.data(), fileBytes.size());
+
+	list<shared_ptr<DataObject>> fileData;
+	istringstream lines(fileBytes);
+	string str;
+	for (getline(lines, str); lines.good(); getline(lines, str))
+		fileData.push_back(make_shared<DataObject>(str));
+	CPPUNIT_ASSERT(fileData.size() == ITEMS);
+
+	CPISync stale(mBar, eltSizeSq, err), restored(mBar, eltSizeSq, err), reference(mBar, eltSizeSq, err);
+	CPPUNIT_ASSERT(!stale.loadSnapshot(dataFile + ".snapshot0", fileData, checksum + 1));
+	CPPUNIT_ASSERT(stale.getNumElem() == 0);
+	CPPUNIT_ASSERT(restored.loadSnapshot(dataFile + ".snapshot0", fileData, checksum));
+	CPPUNIT_ASSERT(reference.addElems(kept));
+	CPPUNIT_ASSERT(restored.getNumElem() == ITEMS);
+	CPPUNIT_ASSERT(restored.printElem() == reference.printElem());
+
+	// a GenSync restarted from the file reconciles correctly
+	GenSync GenSyncServer({make_shared<CommSocket>(8001)}, {make_shared<CPISync>(mBar, eltSizeSq, err)}, dataFile);
+	CPPUNIT_ASSERT(GenSyncServer.dumpElements().size() == ITEMS);
+	for (int ii = 0; ii < DIFS; ii++)
+		GenSyncServer.addElem(make_shared<DataObject>(randZZ()));
+
+	GenSync GenSyncClient = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSizeSq).
+			setMbar(mBar).
+			setErr(err).
+			build();
+	GenSyncClient.addElems(kept);
+	for (int ii = 0; ii < DIFS; ii++)
+		GenSyncClient.addElem(make_shared<DataObject>(randZZ()));
+
+	CPPUNIT_ASSERT(forkHandle(GenSyncClient, GenSyncServer).success);
+	CPPUNIT_ASSERT(GenSyncClient.dumpElements().size() == ITEMS + 2 * DIFS);
+
+	remove(dataFile.c_str());
+	remove((dataFile + ".snapshot0").c_str());
+}
+
+void CPISyncTest::testCPIPlan() {
+	const long BITS = 20, DIFS = 25;
+	const int REDUNDANT = 5;
+	ZZ_p::init(NextPrime(power(ZZ(2), BITS) + DIFS + REDUNDANT));
+
+	auto plan = cpiPlan<BigField>(BITS, DIFS, REDUNDANT);
+	CPPUNIT_ASSERT(plan == cpiPlan<BigField>(BITS, DIFS, REDUNDANT)); // shared while in use
+	CPPUNIT_ASSERT(plan != cpiPlan<BigField>(BITS, DIFS + 1, REDUNDANT));
+
+	const vec_ZZ_p& samples = plan->samples();
+	CPPUNIT_ASSERT(samples.length() == DIFS + REDUNDANT);
+	for (long ii = 0; ii < samples.length(); ii++)
+		CPPUNIT_ASSERT(rep(samples[ii]) == power(ZZ(2), BITS) + ii + 1);
+
+	// trees are built once, and the root of each is the product of (x - sample) over its samples
+	auto tree = plan->tree(DIFS);
+	CPPUNIT_ASSERT(tree == plan->tree(DIFS));
+	const ZZ_pX& root = tree->back()[0];
+	CPPUNIT_ASSERT(deg(root) == DIFS);
+	for (long ii = 0; ii < samples.length(); ii++)
+		CPPUNIT_ASSERT(IsZero(eval(root, samples[ii])) == (ii < DIFS));
+}
+
+void CPISyncTest::testCPIThreads() {
+	const int ITEMS = 2000; // enough roots to split bulk loading across several threads
+	const int DELETED = 100; // elements deleted again, one at a time and in bulk
+	const int DIFS = 20; // elements unique to each of the client and the server
+	auto pool = make_shared<ThreadPool>(4);
+
+	list<shared_ptr<DataObject>> items, removed;
+	for (int ii = 0; ii < ITEMS; ii++)
+		items.push_back(make_shared<DataObject>(randZZ()));
+	for (int ii = 0; ii < DELETED; ii++)
+		removed.push_back(make_shared<DataObject>(randZZ()));
+
+	// a threaded server, with some churn, ...
+	auto threaded = make_shared<CPISync>(mBar, eltSizeSq, err);
+	threaded->setThreadPool(pool);
+	GenSync GenSyncServer({make_shared<CommSocket>(8001)}, {threaded}, SyncMethod::postProcessing_SET, items);
+	GenSyncServer.addElems(removed);
+	CPPUNIT_ASSERT(GenSyncServer.delElem(removed.front()));
+	removed.pop_front();
+	CPPUNIT_ASSERT(GenSyncServer.delElems(removed));
+	for (int ii = 0; ii < DIFS; ii++)
+		GenSyncServer.addElem(make_shared<DataObject>(randZZ()));
+	CPPUNIT_ASSERT(threaded->getNumElem() == ITEMS + DIFS);
+
+	// ... reconciles with a single-threaded client
+	GenSync GenSyncClient = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSizeSq).
+			setMbar(mBar).
+			setErr(err).
+			build();
+	GenSyncClient.addElems(items);
+	for (int ii = 0; ii < DIFS; ii++)
+		GenSyncClient.addElem(make_shared<DataObject>(randZZ()));
+
+	CPPUNIT_ASSERT(forkHandle(GenSyncClient, GenSyncServer).success);
+	CPPUNIT_ASSERT(GenSyncClient.dumpElements().size() == ITEMS + 2 * DIFS);
+
+	// threads also serve the Builder
+	GenSync GenSyncThreadedServer = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSize * 8). // Bytes to bits
+			setMbar(mBar).
+			setErr(err).
+			setThreads(4).
+			build();
+
+	GenSync GenSyncThreadedClient = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSize * 8). // Bytes to bits
+			setMbar(mBar).
+			setErr(err).
+			build();
+
+	//(oneWay = false, probSync = false, syncParamTest = false, Multiset = false, largeSync = false)
+	CPPUNIT_ASSERT(syncTest(GenSyncThreadedClient, GenSyncThreadedServer, false, false, false, false, false));
+}
+
+void CPISyncTest::testCPIKernels() {
+	const long LEN = 1003; // not a multiple of any vector width, so that the scalar tails are exercised too
+
+	// primes suited to each implementation:  below 2^31, below 2^50, and near the top of the word-sized range
+	for (long prime : {NextPrime(1L << 30), NextPrime(1L << 40), NextPrime(1L << (NTL_SP_NBITS - 1))}) {
+		zz_p::init(prime);
+		vec_zz_p vals, factors;
+		random(vals, LEN);
+		random(factors, LEN);
+		zz_p sub = random_zz_p();
+		for (long ii = 0; ii < LEN; ii++)
+			if (factors[ii] == sub)
+				factors[ii] += 1; // keep the differences invertible
+
+		for (auto limit : {CPIMontgomery::Isa::Scalar, CPIMontgomery::Isa::AVX2, CPIMontgomery::Isa::AVX512F,
+						   CPIMontgomery::Isa::AVX512IFMA}) {
+			CPIMontgomery mont(prime, limit);
+			vector<long> montFactors(LEN), rawVals(LEN), rawRoots(LEN);
+			for (long ii = 0; ii < LEN; ii++) {
+				montFactors[ii] = mont.toMont(rep(factors[ii]));
+				rawVals[ii] = rawRoots[ii] = rep(vals[ii]);
+			}
+			long montSub = mont.toMont(rep(sub));
+
+			// vals[i] * (factors[i] - sub)
+			vector<long> product(rawVals);
+			mont.mulSub(product.data(), montFactors.data(), montSub, LEN);
+			for (long ii = 0; ii < LEN; ii++)
+				CPPUNIT_ASSERT(product[ii] == rep(vals[ii] * (factors[ii] - sub)));
+
+			// vals[i] / (factors[i] - sub), through the batch inverse
+			vector<long> inverses(montFactors), quotient(rawVals);
+			for (auto& inverse : inverses)
+				if ((inverse -= montSub) < 0)
+					inverse += prime;
+			mont.batchInv(inverses.data(), LEN);
+			mont.mulSub(quotient.data(), inverses.data(), 0, LEN);
+			for (long ii = 0; ii < LEN; ii++)
+				CPPUNIT_ASSERT(quotient[ii] == rep(vals[ii] / (factors[ii] - sub)));
+
+			// prod_i (sub - vals[i])
+			zz_p expected;
+			set(expected);
+			for (long ii = 0; ii < LEN; ii++)
+				expected *= sub - vals[ii];
+			CPPUNIT_ASSERT(mont.prodSub(rep(sub), rawRoots.data(), LEN) == rep(expected));
+		}
+	}
+}
+
+void CPISyncTest::testCPIMultiplicity() {
+	const int COPIES = 40;
+
+	// hashed elements over the big field, and raw elements over the word-sized field
+	for (bool hashes : {true, false}) {
+		const long bits = hashes ? eltSizeSq : 20;
+		CPISync self(mBar, bits, err, 0, hashes), other(mBar, bits, err, 0, hashes);
+		self.setMultiset(true);
+		other.setMultiset(true);
+
+		// self holds COPIES copies of an element, the other half as many, and another element
+		const ZZ common = hashes ? randZZ() : ZZ(5), extra = hashes ? randZZ() : ZZ(7);
+		vector<shared_ptr<DataObject>> copies;
+		for (int ii = 0; ii < COPIES; ii++) {
+			copies.push_back(make_shared<DataObject>(common));
+			CPPUNIT_ASSERT(self.addElem(copies.back()));
+			if (ii % 2 == 0)
+				CPPUNIT_ASSERT(other.addElem(make_shared<DataObject>(common)));
+		}
+		CPPUNIT_ASSERT(other.addElem(make_shared<DataObject>(extra)));
+		CPPUNIT_ASSERT_EQUAL((long) COPIES, self.getNumElem());
+
+		vec_ZZ_p delta_self, delta_other;
+		CPPUNIT_ASSERT(self.reconcileSketch(other.getNumElem(), other.getSketch(), delta_self, delta_other));
+		CPPUNIT_ASSERT_EQUAL((long) COPIES / 2, delta_self.length());
+		for (const ZZ_p& hash : delta_self)
+			CPPUNIT_ASSERT(self.hashToElement(hash)->to_ZZ() == common);
+		CPPUNIT_ASSERT_EQUAL(1L, delta_other.length());
+		const ZZ_p commonHash = delta_self[0];
+
+		// removing the surplus copies, the first (kept for the hash) among them, leaves just the other element
+		for (int ii = 0; ii < COPIES / 2; ii++)
+			CPPUNIT_ASSERT(self.delElem(copies[ii]));
+		CPPUNIT_ASSERT(self.reconcileSketch(other.getNumElem(), other.getSketch(), delta_self, delta_other));
+		CPPUNIT_ASSERT_EQUAL(0L, delta_self.length());
+		CPPUNIT_ASSERT_EQUAL(1L, delta_other.length());
+
+		// ... and the hash now stands for a copy that is still stored
+		if (hashes) {
+			shared_ptr<DataObject> kept = self.hashToElement(commonHash);
+			CPPUNIT_ASSERT(std::find(copies.begin() + COPIES / 2, copies.end(), kept) != copies.end());
+		}
+	}
+}
+
 void CPISyncTest::CPISyncSetReconcileTest() {
 		GenSync GenSyncServer = GenSync::Builder().
 				setProtocol(GenSync::SyncProtocol::CPISync).
@@ -101,6 +468,31 @@ void CPISyncTest::CPISyncMultisetReconcileTest() {
 	CPPUNIT_ASSERT(syncTest(GenSyncClient, GenSyncServer,false, false,false,true,false));
 }
 
+void CPISyncTest::CPISyncNativeMultisetReconcileTest() {
+	GenSync GenSyncServer = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSize * 8). // Bytes to bits
+			setMbar(mBar).
+			setErr(err).
+			setHashes(true).
+			setMultiset(true).
+			build();
+
+	GenSync GenSyncClient = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSize * 8). // Bytes to bits
+			setMbar(mBar).
+			setErr(err).
+			setHashes(true).
+			setMultiset(true).
+			build();
+
+	//(oneWay = false, probSync = false, syncParamTest = false, Multiset = true, largeSync = false)
+	CPPUNIT_ASSERT(syncTest(GenSyncClient, GenSyncServer,false, false,false,true,false));
+}
+
 void CPISyncTest::CPISyncLargeSetReconcileTest() {
 	GenSync GenSyncServer = GenSync::Builder().
 			setProtocol(GenSync::SyncProtocol::CPISync).
@@ -122,6 +514,180 @@ void CPISyncTest::CPISyncLargeSetReconcileTest() {
 	CPPUNIT_ASSERT(syncTest(GenSyncClient, GenSyncServer, false, false, false, false, true));
 }
 
+void CPISyncTest::CPISyncWordFieldReconcileTest() {
+	const int wordBits = 16; // hashed elements of this size are stored in a field well below 64 bits
+
+	GenSync GenSyncServer = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(wordBits).
+			setMbar(mBar).
+			setErr(err).
+			setHashes(true).
+			build();
+
+	GenSync GenSyncClient = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(wordBits).
+			setMbar(mBar).
+			setErr(err).
+			setHashes(true).
+			build();
+
+	//(oneWay = false, probSync = false, syncParamTest = false, Multiset = true, largeSync = false)
+	CPPUNIT_ASSERT(syncTest(GenSyncClient, GenSyncServer, false, false, false, true, false));
+}
+
+void CPISyncTest::CPISyncFastInterpReconcileTest() {
+	const int wordBits = 16; // hashed elements of this size are stored in a field well below 64 bits
+
+	GenSync GenSyncServer = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSize * 8). // Bytes to bits
+			setMbar(mBar).
+			setErr(err).
+			setInterpType(INTERP_TYPE::Fast).
+			build();
+
+	GenSync GenSyncClient = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSize * 8). // Bytes to bits
+			setMbar(mBar).
+			setErr(err).
+			setInterpType(INTERP_TYPE::Fast).
+			build();
+
+	//(oneWay = false, probSync = false, syncParamTest = false, Multiset = false, largeSync = false)
+	CPPUNIT_ASSERT(syncTest(GenSyncClient, GenSyncServer, false, false, false, false, false));
+
+	GenSync GenSyncWordServer = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(wordBits).
+			setMbar(mBar).
+			setErr(err).
+			setHashes(true).
+			setInterpType(INTERP_TYPE::Fast).
+			build();
+
+	GenSync GenSyncWordClient = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(wordBits).
+			setMbar(mBar).
+			setErr(err).
+			setHashes(true).
+			setInterpType(INTERP_TYPE::Fast).
+			build();
+
+	//(oneWay = false, probSync = false, syncParamTest = false, Multiset = true, largeSync = false)
+	CPPUNIT_ASSERT(syncTest(GenSyncWordClient, GenSyncWordServer, false, false, false, true, false));
+}
+
+void CPISyncTest::CPISyncEvalRootsReconcileTest() {
+	const int wordBits = 16; // hashed elements of this size are stored in a field well below 64 bits
+
+	GenSync GenSyncServer = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSize * 8). // Bytes to bits
+			setMbar(mBar).
+			setErr(err).
+			setRootType(ROOT_TYPE::Evaluate).
+			build();
+
+	GenSync GenSyncClient = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSize * 8). // Bytes to bits
+			setMbar(mBar).
+			setErr(err).
+			setRootType(ROOT_TYPE::Evaluate).
+			build();
+
+	//(oneWay = false, probSync = false, syncParamTest = false, Multiset = false, largeSync = false)
+	CPPUNIT_ASSERT(syncTest(GenSyncClient, GenSyncServer, false, false, false, false, false));
+
+	GenSync GenSyncWordServer = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(wordBits).
+			setMbar(mBar).
+			setErr(err).
+			setHashes(true).
+			setRootType(ROOT_TYPE::Evaluate).
+			build();
+
+	GenSync GenSyncWordClient = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(wordBits).
+			setMbar(mBar).
+			setErr(err).
+			setHashes(true).
+			setRootType(ROOT_TYPE::Evaluate).
+			build();
+
+	//(oneWay = false, probSync = false, syncParamTest = false, Multiset = true, largeSync = false)
+	CPPUNIT_ASSERT(syncTest(GenSyncWordClient, GenSyncWordServer, false, false, false, true, false));
+}
+
+void CPISyncTest::CPISyncKeyedHashReconcileTest() {
+	//A small mBar so that InterCPISync is forced to recurse
+	const int interCPImBar = 15;
+
+	GenSync GenSyncServer = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSize * 8). // Bytes to bits
+			setMbar(mBar).
+			setErr(err).
+			setHashes(true).
+			setHashType(HASH_TYPE::Keyed).
+			build();
+
+	GenSync GenSyncClient = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::CPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSize * 8). // Bytes to bits
+			setMbar(mBar).
+			setErr(err).
+			setHashes(true).
+			setHashType(HASH_TYPE::Keyed).
+			build();
+
+	//(oneWay = false, probSync = false, syncParamTest = false, Multiset = true, largeSync = false)
+	CPPUNIT_ASSERT(syncTest(GenSyncClient, GenSyncServer, false, false, false, true, false));
+
+	GenSync GenSyncInterServer = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::InteractiveCPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSize * 8). // Bytes to bits
+			setMbar(interCPImBar).
+			setNumPartitions(numParts).
+			setErr(err).
+			setHashes(true).
+			setHashType(HASH_TYPE::Keyed).
+			build();
+
+	GenSync GenSyncInterClient = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::InteractiveCPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSize * 8). // Bytes to bits
+			setMbar(interCPImBar).
+			setNumPartitions(numParts).
+			setErr(err).
+			setHashes(true).
+			setHashType(HASH_TYPE::Keyed).
+			build();
+
+	//(oneWay = false, probSync = false, syncParamTest = false, Multiset = true, largeSync = false)
+	CPPUNIT_ASSERT(syncTest(GenSyncInterClient, GenSyncInterServer, false, false, false, true, false));
+}
+
 void CPISyncTest::ProbCPISyncSetReconcileTest() {
 	GenSync GenSyncServer = GenSync::Builder().
 			setProtocol(GenSync::SyncProtocol::ProbCPISync).
@@ -143,6 +709,53 @@ void CPISyncTest::ProbCPISyncSetReconcileTest() {
 	CPPUNIT_ASSERT(syncTest(GenSyncClient, GenSyncServer, false, false, false, false, false));
 }
 
+void CPISyncTest::ProbCPISyncFastInterpReconcileTest() {
+	const int wordBits = 16; // hashed elements of this size are stored in a field well below 64 bits
+
+	GenSync GenSyncServer = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::ProbCPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSize * 8). // Bytes to bits
+			setMbar(mBar).
+			setErr(err).
+			setInterpType(INTERP_TYPE::Fast).
+			build();
+
+	GenSync GenSyncClient = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::ProbCPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSize * 8). // Bytes to bits
+			setMbar(mBar).
+			setErr(err).
+			setInterpType(INTERP_TYPE::Fast).
+			build();
+
+	//(oneWay = false, probSync = false, syncParamTest = false, Multiset = false, largeSync = false)
+	CPPUNIT_ASSERT(syncTest(GenSyncClient, GenSyncServer, false, false, false, false, false));
+
+	GenSync GenSyncWordServer = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::ProbCPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(wordBits).
+			setMbar(mBar).
+			setErr(err).
+			setHashes(true).
+			setInterpType(INTERP_TYPE::Fast).
+			build();
+
+	GenSync GenSyncWordClient = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::ProbCPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(wordBits).
+			setMbar(mBar).
+			setErr(err).
+			setHashes(true).
+			setInterpType(INTERP_TYPE::Fast).
+			build();
+
+	CPPUNIT_ASSERT(syncTest(GenSyncWordClient, GenSyncWordServer, false, false, false, false, false));
+}
+
 void CPISyncTest::ProbCPISyncMultisetReconcileTest() {
 	GenSync GenSyncServer = GenSync::Builder().
 			setProtocol(GenSync::SyncProtocol::ProbCPISync).
@@ -220,6 +833,60 @@ void CPISyncTest::testInterCPIAddDelElem() {
 
 }
 
+void CPISyncTest::testInterCPIIndexDelElem() {
+	const int ITEMS = 100; // elements kept from each of two batches
+	const int DIFS = 20; // elements unique to each of the client and the server
+	const int interCPImBar = 15; // small enough that the synchronization recurses through the index
+	auto indexed = make_shared<InterCPISync>(interCPImBar, eltSizeSq, err, partitions);
+	indexed->setCompactTree(true); // the index is all there is
+
+	// the first batch lands out of hash order, and half of it is deleted from the unsorted entries
+	list<shared_ptr<DataObject>> kept, removed;
+	for (int ii = 0; ii < 2 * ITEMS; ii++) {
+		kept.push_back(make_shared<DataObject>(randZZ()));
+		removed.push_back(make_shared<DataObject>(randZZ()));
+		CPPUNIT_ASSERT(indexed->addElem(kept.back()));
+		CPPUNIT_ASSERT(indexed->addElem(removed.back()));
+	}
+	for (const auto& datum : removed)
+		CPPUNIT_ASSERT(indexed->delElem(datum));
+
+	// rebuilding the tree sorts the index; half of what is kept is then deleted from the sorted entries, while a
+	// second batch is added and partly deleted again
+	indexed->setCompactTree(false);
+	indexed->setCompactTree(true);
+	for (int ii = 0; ii < ITEMS; ii++) {
+		CPPUNIT_ASSERT(indexed->delElem(kept.front()));
+		kept.pop_front();
+		auto added = make_shared<DataObject>(randZZ()), dropped = make_shared<DataObject>(randZZ());
+		CPPUNIT_ASSERT(indexed->addElem(added));
+		CPPUNIT_ASSERT(indexed->addElem(dropped));
+		CPPUNIT_ASSERT(indexed->delElem(dropped));
+		kept.push_back(added);
+	}
+	CPPUNIT_ASSERT_EQUAL((long) kept.size(), indexed->getNumElem());
+
+	// check the index by reconciling with a client holding the kept elements
+	for (int ii = 0; ii < DIFS; ii++)
+		CPPUNIT_ASSERT(indexed->addElem(make_shared<DataObject>(randZZ())));
+	GenSync GenSyncServer({make_shared<CommSocket>(8001)}, {indexed}, SyncMethod::postProcessing_SET, {});
+
+	GenSync GenSyncClient = GenSync::Builder().
+			setProtocol(GenSync::SyncProtocol::InteractiveCPISync).
+			setComm(GenSync::SyncComm::socket).
+			setBits(eltSizeSq).
+			setMbar(interCPImBar).
+			setNumPartitions(partitions).
+			setErr(err).
+			build();
+	GenSyncClient.addElems(kept);
+	for (int ii = 0; ii < DIFS; ii++)
+		GenSyncClient.addElem(make_shared<DataObject>(randZZ()));
+
+	CPPUNIT_ASSERT(forkHandle(GenSyncClient, GenSyncServer).success);
+	CPPUNIT_ASSERT(GenSyncClient.dumpElements().size() == kept.size() + 2 * DIFS);
+}
+
 void CPISyncTest::InterCPISyncSetReconcileTest() {
 	//A small mBar so that InterCPISync is forced to recurse
 	const int interCPImBar = 15;
@@ -299,4 +966,209 @@ void CPISyncTest::InterCPISyncLargeSetReconcileTest() {
 
 	//(oneWay = false, probSync = false, syncParamTest = false, Multiset = false, largeSync = true)
 	CPPUNIT_ASSERT(syncTest(GenSyncClient, GenSyncServer, false, false, false, false, true));
-}
\ No newline at end of file
+}
+
+void CPISyncTest::InterCPISyncCompactReconcileTest() {
+	//A small mBar so that InterCPISync is forced to recurse
+	const int interCPImBar = 15;
+
+	for (bool compactServer : {true, false}) {
+		GenSync GenSyncServer = GenSync::Builder().
+				setProtocol(GenSync::SyncProtocol::InteractiveCPISync).
+				setComm(GenSync::SyncComm::socket).
+				setBits(eltSize * 8). // Bytes to bits
+				setMbar(interCPImBar).
+				setNumPartitions(numParts).
+				setCompactTree(compactServer).
+				build();
+
+		GenSync GenSyncClient = GenSync::Builder().
+				setProtocol(GenSync::SyncProtocol::InteractiveCPISync).
+				setComm(GenSync::SyncComm::socket).
+				setBits(eltSize * 8). // Bytes to bits
+				setMbar(interCPImBar).
+				setNumPartitions(numParts).
+				setCompactTree(!compactServer).
+				build();
+
+		//(oneWay = false, probSync = false, syncParamTest = false, Multiset = false, largeSync = false)
+		CPPUNIT_ASSERT(syncTest(GenSyncClient, GenSyncServer, false, false, false, false, false));
+	}
+}
+
+void CPISyncTest::InterCPISyncBatchedReconcileTest() {
+	//A small mBar so that InterCPISync is forced to recurse
+	const int interCPImBar = 15;
+
+	for (bool hashes : {false, true}) {
+		for (bool compactServer : {false, true}) {
+			GenSync GenSyncServer = GenSync::Builder().
+					setProtocol(GenSync::SyncProtocol::InteractiveCPISync).
+					setComm(GenSync::SyncComm::socket).
+					setBits(eltSize * 8). // Bytes to bits
+					setMbar(interCPImBar).
+					setNumPartitions(numParts).
+					setHashes(hashes).
+					setCompactTree(compactServer).
+					setBatchedLevels(true).
+					setThreads(4). // the nodes of a level are reconciled concurrently
+					build();
+
+			GenSync GenSyncClient = GenSync::Builder().
+					setProtocol(GenSync::SyncProtocol::InteractiveCPISync).
+					setComm(GenSync::SyncComm::socket).
+					setBits(eltSize * 8). // Bytes to bits
+					setMbar(interCPImBar).
+					setNumPartitions(numParts).
+					setHashes(hashes).
+					setBatchedLevels(true).
+					build();
+
+			//(oneWay = false, probSync = false, syncParamTest = false, Multiset = false, largeSync = false)
+			CPPUNIT_ASSERT(syncTest(GenSyncClient, GenSyncServer, false, false, false, false, false));
+		}
+	}
+}
+
+void CPISyncTest::InterCPISyncAdaptiveReconcileTest() {
+	//A small mBar so that InterCPISync is forced to recurse
+	const int interCPImBar = 15;
+
+	for (bool compactServer : {false, true}) {
+		GenSync GenSyncServer = GenSync::Builder().
+				setProtocol(GenSync::SyncProtocol::InteractiveCPISync).
+				setComm(GenSync::SyncComm::socket).
+				setBits(eltSize * 8). // Bytes to bits
+				setMbar(interCPImBar).
+				setNumPartitions(numParts).
+				setCompactTree(compactServer).
+				setAdaptiveFanout(true).
+				build();
+
+		GenSync GenSyncClient = GenSync::Builder().
+				setProtocol(GenSync::SyncProtocol::InteractiveCPISync).
+				setComm(GenSync::SyncComm::socket).
+				setBits(eltSize * 8). // Bytes to bits
+				setMbar(interCPImBar).
+				setNumPartitions(numParts).
+				setAdaptiveFanout(true).
+				build();
+
+		//(oneWay = false, probSync = false, syncParamTest = false, Multiset = false, largeSync = false)
+		CPPUNIT_ASSERT(syncTest(GenSyncClient, GenSyncServer, false, false, false, false, false));
+	}
+}
+
+void CPISyncTest::InterCPISyncResumeTest() {
+	//A small mBar so that InterCPISync is forced to recurse over several levels
+	const int interCPImBar = 15, SIMILAR = 300, DIFFS = 60;
+	const long BUDGET = 400; // bytes sent by the client before its first connection is lost
+
+	multiset<string> clientOnly, serverOnly;
+	InterCPISync client(interCPImBar, eltSize * 8, err, numParts), server(interCPImBar, eltSize * 8, err, numParts);
+	client.setBatchedLevels(true);
+	server.setBatchedLevels(true);
+	for (int ii = 0; ii < SIMILAR + 2 * DIFFS; ii++) {
+		auto elem = make_shared<DataObject>(randZZ());
+		if (ii < SIMILAR + DIFFS) {
+			client.addElem(elem);
+			if (ii >= SIMILAR) clientOnly.insert(elem->print());
+		}
+		if (ii < SIMILAR || ii >= SIMILAR + DIFFS) {
+			server.addElem(elem);
+			if (ii >= SIMILAR) serverOnly.insert(elem->print());
+		}
+	}
+
+	pid_t pID = fork();
+	if (pID == 0) { // the server: one attempt per port
+		for (int attempt : {0, 1}) {
+			auto comm = make_shared<CommSocket>(port + attempt, host);
+			list<shared_ptr<DataObject>> selfMinusOther, otherMinusSelf;
+			try {
+				server.SyncServer(comm, selfMinusOther, otherMinusSelf);
+			} catch (const SyncFailureException &) {
+				comm->commClose();
+			}
+		}
+		exit(0);
+	}
+	CPPUNIT_ASSERT(pID > 0);
+
+	// the first attempt loses its connection midway
+	list<shared_ptr<DataObject>> selfMinusOther, otherMinusSelf;
+	CPPUNIT_ASSERT_THROW(client.SyncClient(make_shared<DroppingSocket>(port, host, BUDGET), selfMinusOther, otherMinusSelf),
+	                     SyncFailureException);
+
+	// the second resumes, and finds all the differences, once each
+	selfMinusOther.clear();
+	otherMinusSelf.clear();
+	CPPUNIT_ASSERT(client.SyncClient(make_shared<CommSocket>(port + 1, host), selfMinusOther, otherMinusSelf));
+	CPPUNIT_ASSERT(client.resumedLevel() >= 0);
+
+	multiset<string> selfResult, otherResult;
+	for (const auto &elem : selfMinusOther) selfResult.insert(elem->print());
+	for (const auto &elem : otherMinusSelf) otherResult.insert(elem->print());
+	CPPUNIT_ASSERT(selfResult == clientOnly);
+	CPPUNIT_ASSERT(otherResult == serverOnly);
+
+	int status;
+	waitpid(pID, &status, 0);
+}
+
+namespace {
+	/**
+	 * @return true iff the depth statistics of sync, after a sync that divided its root, are consistent with each
+	 *    other and with the totals of the sync.
+	 */
+	bool consistentDepthStats(InterCPISync &sync, long pFactor) {
+		const vector<InterCPISync::DepthStats> &depths = sync.getDepthStats();
+		if (depths.size() < 2 || depths[0].visited != 1 || depths[0].failed != 1 || sync.getRoundTrips() < (long) depths.size())
+			return false;
+
+		unsigned long xmit = 0, recv = 0;
+		for (size_t depth = 0; depth < depths.size(); depth++) {
+			xmit += depths[depth].xmitBytes;
+			recv += depths[depth].recvBytes;
+			if (depth > 0 && depths[depth].visited != pFactor * depths[depth - 1].failed)
+				return false;
+		}
+		return xmit == (unsigned long) sync.mySyncStats.getStat(SyncMethod::SyncStats::XMIT) &&
+		       recv == (unsigned long) sync.mySyncStats.getStat(SyncMethod::SyncStats::RECV);
+	}
+}
+
+void CPISyncTest::InterCPISyncDepthStatsTest() {
+	//A small mBar so that InterCPISync is forced to recurse
+	const int interCPImBar = 15, SIMILAR = 200, DIFFS = 40;
+
+	for (bool batched : {false, true}) {
+		InterCPISync client(interCPImBar, eltSize * 8, err, numParts), server(interCPImBar, eltSize * 8, err, numParts);
+		client.setBatchedLevels(batched);
+		server.setBatchedLevels(batched);
+		for (int ii = 0; ii < SIMILAR + 2 * DIFFS; ii++) {
+			auto elem = make_shared<DataObject>(randZZ());
+			if (ii < SIMILAR + DIFFS)
+				client.addElem(elem);
+			if (ii < SIMILAR || ii >= SIMILAR + DIFFS)
+				server.addElem(elem);
+		}
+
+		pid_t pID = fork();
+		if (pID == 0) { // the server reports its own statistics through its exit status
+			list<shared_ptr<DataObject>> selfMinusOther, otherMinusSelf;
+			bool success = server.SyncServer(make_shared<CommSocket>(port, host), selfMinusOther, otherMinusSelf);
+			exit(success && consistentDepthStats(server, numParts) && server.getDepthStats()[0].interpTime > 0 ? 0 : 1);
+		}
+		CPPUNIT_ASSERT(pID > 0);
+
+		list<shared_ptr<DataObject>> selfMinusOther, otherMinusSelf;
+		CPPUNIT_ASSERT(client.SyncClient(make_shared<CommSocket>(port, host), selfMinusOther, otherMinusSelf));
+		CPPUNIT_ASSERT_EQUAL((size_t) 2 * DIFFS, selfMinusOther.size() + otherMinusSelf.size());
+		CPPUNIT_ASSERT(consistentDepthStats(client, numParts));
+
+		int status;
+		waitpid(pID, &status, 0);
+		CPPUNIT_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+	}
+}
@@ -15,16 +15,35 @@ class CPISyncTest : public CPPUNIT_NS::TestFixture {
 	CPPUNIT_TEST_SUITE(CPISyncTest);
 
 	CPPUNIT_TEST(testCPIAddDelElem);
+	CPPUNIT_TEST(testCPIAddElems);
+	CPPUNIT_TEST(testCPIDelElems);
+	CPPUNIT_TEST(testCPISnapshot);
+	CPPUNIT_TEST(testCPIPlan);
+	CPPUNIT_TEST(testCPIThreads);
+	CPPUNIT_TEST(testCPIKernels);
+	CPPUNIT_TEST(testCPIMultiplicity);
 	CPPUNIT_TEST(CPISyncSetReconcileTest);
 	CPPUNIT_TEST(CPISyncMultisetReconcileTest);
+	CPPUNIT_TEST(CPISyncNativeMultisetReconcileTest);
 	CPPUNIT_TEST(CPISyncLargeSetReconcileTest);
+	CPPUNIT_TEST(CPISyncWordFieldReconcileTest);
+	CPPUNIT_TEST(CPISyncFastInterpReconcileTest);
+	CPPUNIT_TEST(CPISyncEvalRootsReconcileTest);
+	CPPUNIT_TEST(CPISyncKeyedHashReconcileTest);
 	CPPUNIT_TEST(ProbCPISyncSetReconcileTest);
+	CPPUNIT_TEST(ProbCPISyncFastInterpReconcileTest);
 	CPPUNIT_TEST(ProbCPISyncMultisetReconcileTest);
 	CPPUNIT_TEST(ProbCPISyncLargeSetReconcileTest);
 	CPPUNIT_TEST(testInterCPIAddDelElem);
+	CPPUNIT_TEST(testInterCPIIndexDelElem);
 	CPPUNIT_TEST(InterCPISyncSetReconcileTest);
 	CPPUNIT_TEST(InterCPISyncMultisetReconcileTest);
 	CPPUNIT_TEST(InterCPISyncLargeSetReconcileTest);
+	CPPUNIT_TEST(InterCPISyncCompactReconcileTest);
+	CPPUNIT_TEST(InterCPISyncBatchedReconcileTest);
+	CPPUNIT_TEST(InterCPISyncAdaptiveReconcileTest);
+	CPPUNIT_TEST(InterCPISyncResumeTest);
+	CPPUNIT_TEST(InterCPISyncDepthStatsTest);
 
 	CPPUNIT_TEST_SUITE_END();
 
@@ -42,6 +61,47 @@ public:
 	 */
 	static void testCPIAddDelElem();
 
+	/**
+	 * Test that bulk-loading CPISync (addElems, and the GenSync constructors that use it) stores the same data as adding
+	 * elements one at a time, and that a bulk-loaded CPISync reconciles correctly.
+	 */
+	static void testCPIAddElems();
+
+	/**
+	 * Test that batch deletion from CPISync (delElems) leaves the same data as never having added the deleted
+	 * elements, and that the resulting CPISync reconciles correctly.
+	 */
+	static void testCPIDelElems();
+
+	/**
+	 * Test that a file-backed GenSync with CPISync restores its sketch from a snapshot, that stale snapshots are
+	 * rejected, and that a restored CPISync reconciles correctly.
+	 */
+	static void testCPISnapshot();
+
+	/**
+	 * Test that CPISync sample plans are shared between users of the same parameters, and that their cached
+	 * subproduct trees vanish at the sample locations.
+	 */
+	static void testCPIPlan();
+
+	/**
+	 * Test that a CPISync splitting its work across threads, through bulk and single updates, reconciles correctly
+	 * with a single-threaded CPISync.
+	 */
+	static void testCPIThreads();
+
+	/**
+	 * Test that every available implementation of the word-sized Montgomery kernels agrees with NTL's zz_p arithmetic.
+	 */
+	static void testCPIKernels();
+
+	/**
+	 * Test that CPISync's multiset mode stores the copies of an element under one hash, and that reconciliation
+	 * recovers how many more copies one side holds.
+	 */
+	static void testCPIMultiplicity();
+
 	/**
  	* Test a synchronization of sets with CPISync
 	 * CPISync does have a very small probability of failure but is not a probabilistic sync because it doesn't do partial reconcilliation
@@ -58,18 +118,54 @@ public:
  	*/
 	static void CPISyncMultisetReconcileTest();
 
+	/**
+	 * Test a synchronization of multisets with CPISync in its multiset mode, which stores each element once, with its
+	 * number of copies.
+	 */
+	static void CPISyncNativeMultisetReconcileTest();
+
 	/*
 	 * Test a synchronization of large sets using CPISync. This test may be limited by the heap size of a users machine
 	 * TODO: Add a number here once the sie of "Large" is chosen
 	 */
 	static void CPISyncLargeSetReconcileTest();
 
+	/**
+	 * Test a synchronization of multisets with CPISync using few enough bits that the field fits in a machine word,
+	 * so that the word-sized field backend is exercised end to end.
+	 */
+	static void CPISyncWordFieldReconcileTest();
+
+	/**
+	 * Test synchronizations with CPISync using the quasi-linear (INTERP_TYPE::Fast) rational function interpolation,
+	 * over both the multi-precision and the word-sized field backends.
+	 */
+	static void CPISyncFastInterpReconcileTest();
+
+	/**
+	 * Test synchronizations with CPISync finding roots by evaluation against the local hashes (ROOT_TYPE::Evaluate),
+	 * over both the multi-precision and the word-sized field backends.
+	 */
+	static void CPISyncEvalRootsReconcileTest();
+
+	/**
+	 * Test synchronizations of multisets with CPISync and InterCPISync hashing elements with the keyed hash
+	 * (HASH_TYPE::Keyed).
+	 */
+	static void CPISyncKeyedHashReconcileTest();
+
 	/**
 	 * Test the synchronization of sets using ProbCPISync
 	 * Same as CPISync but if more than m_bar differences are present the CPISync divides into smaller subproblems
 	 */
 	static void ProbCPISyncSetReconcileTest();
 
+	/**
+	 * Test a synchronization of sets with ProbCPISync using the fast interpolation engine, which carries its
+	 * interpolation across doubling rounds, both over a large field and over a word-sized field
+	 */
+	static void ProbCPISyncFastInterpReconcileTest();
+
 	/**
 	 * Test the synchronization of multisets using ProbCPISync
  	 * Same as CPISync but if more than m_bar differences are present the CPISync divides into smaller subproblems
@@ -89,6 +185,12 @@ public:
  	*/
 	static void testInterCPIAddDelElem();
 
+	/**
+	 * Test that deleting from InterCPISync's hash index, both from its sorted part and from the entries appended
+	 * since it was last sorted, leaves an index from which a compact tree reconciles correctly.
+	 */
+	static void testInterCPIIndexDelElem();
+
 	/**
  	 * Test a synchronization with InterCPISync
 	 * InterCPISync is tested with prob = false for the same reason as CPISYnc but InterCPISync does not have mBar < m as a
@@ -116,6 +218,35 @@ public:
 	 */
 	static void InterCPISyncLargeSetReconcileTest();
 
+	/**
+	 * Test a synchronization with InterCPISync in which one side stores its tree in the compact mode, and the other in
+	 * the default mode, in both roles.  The recursion must divide the elements in the same way in both modes.
+	 */
+	static void InterCPISyncCompactReconcileTest();
+
+	/**
+	 * Test a synchronization with InterCPISync's level-batched protocol, with and without hashes, and with the server's
+	 * tree in either storage mode and its nodes reconciled on several threads.
+	 */
+	static void InterCPISyncBatchedReconcileTest();
+
+	/**
+	 * Test a synchronization with InterCPISync's adaptive fan-out, with the server's tree in either storage mode.
+	 */
+	static void InterCPISyncAdaptiveReconcileTest();
+
+	/**
+	 * Test that a batched InterCPISync synchronization whose connection is lost midway resumes from its checkpoint on
+	 * the next attempt, and still finds exactly the differences between the sets.
+	 */
+	static void InterCPISyncResumeTest();
+
+	/**
+	 * Test that InterCPISync's statistics cover every node of its tree, recursive and batched: each depth counts the
+	 * children of the failed nodes above it, and the bytes of all depths add up to those of the whole sync.
+	 */
+	static void InterCPISyncDepthStatsTest();
+
 
 };
 
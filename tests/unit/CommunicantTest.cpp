@@ -8,6 +8,7 @@
 
 #include "CommunicantTest.h"
 #include <CPISync/Communicants/CommDummy.h>
+#include <CPISync/Aux/Exceptions.h>
 
 CPPUNIT_TEST_SUITE_REGISTRATION(CommunicantTest);
 
@@ -324,3 +325,52 @@ void CommunicantTest::testCommZZNoArgs(){
         CPPUNIT_ASSERT_EQUAL(exp, cRecv.commRecv_ZZ());
     }
 }
+
+void CommunicantTest::testCommIBLT() {
+    queue<char> qq;
+    CommDummy cSend(&qq);
+    CommDummy cRecv(&qq);
+
+    // mostly empty cells, and negative counts from erasing pairs that were never inserted
+    const size_t ELT_SIZE = sizeof(randZZ());
+    IBLT iblt(100, ELT_SIZE);
+    IBLTFixed fixed(100, ELT_SIZE);
+    for (int ii = 0; ii < 10; ii++) {
+        const ZZ elem = randZZ();
+        if (ii % 3 == 0) {
+            iblt.erase(elem, elem);
+            fixed.erase(elem, elem);
+        } else {
+            iblt.insert(elem, elem);
+            fixed.insert(elem, elem);
+        }
+    }
+
+    cSend.Communicant::commSend(iblt);
+    CPPUNIT_ASSERT_EQUAL(iblt.toString(), cRecv.commRecv_IBLT().toString());
+    cSend.Communicant::commSend(fixed, true);
+    CPPUNIT_ASSERT_EQUAL(iblt.toString(), cRecv.commRecv_IBLT(iblt.size(), ELT_SIZE).toString());
+    cSend.Communicant::commSend(iblt, true);
+    CPPUNIT_ASSERT_EQUAL(iblt.toString(), cRecv.commRecv_IBLTFixed(iblt.size(), ELT_SIZE).toIBLT().toString());
+
+    // an empty IBLT is its length, version, key width and bitmap
+    const IBLT empty(100, ELT_SIZE);
+    cSend.resetCommCounters();
+    cSend.Communicant::commSend(empty, true);
+    CPPUNIT_ASSERT_EQUAL(sizeof(long) + 2 + (empty.size() + 7) / 8, (size_t) cSend.getXmitBytes());
+    CPPUNIT_ASSERT_EQUAL(empty.toString(), cRecv.commRecv_IBLT(empty.size(), ELT_SIZE).toString());
+
+    // another version of the format is refused
+    cSend.Communicant::commSend((long) 1);
+    cSend.Communicant::commSend((byte) (IBLT_WIRE_VERSION + 1));
+    CPPUNIT_ASSERT_THROW(cRecv.commRecv_IBLT(empty.size(), ELT_SIZE), SyncFailureException);
+
+    // ... as is an empty IBLT followed by bytes of anything else
+    const size_t bitmapSize = (empty.size() + 7) / 8;
+    cSend.Communicant::commSend((long) (2 + bitmapSize + 1));
+    cSend.Communicant::commSend(IBLT_WIRE_VERSION);
+    cSend.Communicant::commSend((byte) 0); // key width
+    for (size_t ii = 0; ii < bitmapSize + 1; ii++)
+        cSend.Communicant::commSend((byte) 0);
+    CPPUNIT_ASSERT_THROW(cRecv.commRecv_IBLT(empty.size(), ELT_SIZE), SyncFailureException);
+}
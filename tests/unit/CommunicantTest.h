@@ -30,6 +30,7 @@ class CommunicantTest : public CPPUNIT_NS::TestFixture {
     CPPUNIT_TEST(testCommVec_ZZ_p);
     CPPUNIT_TEST(testCommZZ);
     CPPUNIT_TEST(testCommZZNoArgs);
+    CPPUNIT_TEST(testCommIBLT);
     
     CPPUNIT_TEST_SUITE_END();
 
@@ -127,6 +128,11 @@ private:
  	*/
     void testCommZZNoArgs();
 
+    /**
+     * Tests commSend for IBLT and IBLTFixed, and commRecv_IBLT and commRecv_IBLTFixed, in the columnar wire format
+     */
+    void testCommIBLT();
+
     
 
 };
@@ -106,6 +106,13 @@ void IBLTSyncTest::testAddDelElem() {
     rangeDiff(resultingElts.begin(), resultingElts.end(), elts.begin(), elts.end(), back_inserter(diff));
     CPPUNIT_ASSERT(diff.empty());
 
+    // an element wider than eltSize is refused, alone or in a batch
+    auto wide = make_shared<DataObject>(power2_ZZ(8 * sizeof(randZZ())));
+    CPPUNIT_ASSERT(!ibltSync.addElem(wide));
+    CPPUNIT_ASSERT(!ibltSync.addElems({make_shared<DataObject>(randZZ()), wide}));
+    CPPUNIT_ASSERT(!ibltSync.delElem(wide));
+    CPPUNIT_ASSERT_EQUAL((long) ITEMS, ibltSync.getNumElem());
+
     // check that delete works
     for(auto dop : elts)
         CPPUNIT_ASSERT(ibltSync.delElem(dop));
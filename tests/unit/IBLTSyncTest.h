@@ -45,7 +45,7 @@ public:
 	void IBLTSyncLargeSetReconcileTest();
 
 	/**
-	 * Test adding and deleting elements
+	 * Test adding and deleting elements, and refusing elements that do not fit
 	 */
 	void testAddDelElem();
 
@@ -14,6 +14,15 @@ IBLTTest::IBLTTest() {
 IBLTTest::~IBLTTest() {
 }
 
+namespace {
+    // exposes the hash family of IBLT
+    class HashProbe : public IBLT {
+    public:
+        using IBLT::_hashK;
+        using IBLT::_hash;
+    };
+}
+
 void IBLTTest::setUp() {
     const int SEED = 617;
     srand(SEED);
@@ -217,4 +226,132 @@ void IBLTTest::testIBLTMultisetSubtract() {
 
     CPPUNIT_ASSERT_EQUAL(items.size(), plus.size() + minus.size());
     CPPUNIT_ASSERT(recon == allItems);
-}
\ No newline at end of file
+}
+void IBLTTest::testHashFamily() {
+    const ZZ key = conv<ZZ>("123456789012345678901234567890123456789");
+
+    // deterministic, and distinct for each member of the family and each sign of the key
+    CPPUNIT_ASSERT_EQUAL(HashProbe::_hashK(key, 3), HashProbe::_hashK(ZZ(key), 3));
+    CPPUNIT_ASSERT_EQUAL(HashProbe::_hash(42, 1), HashProbe::_hash(42, 1));
+    std::set<hash_t> members;
+    for (long kk = 0; kk <= N_HASHCHECK; kk++)
+        members.insert(HashProbe::_hashK(key, kk));
+    CPPUNIT_ASSERT_EQUAL((size_t) N_HASHCHECK + 1, members.size());
+    CPPUNIT_ASSERT(HashProbe::_hashK(key, 0) != HashProbe::_hashK(-key, 0));
+    CPPUNIT_ASSERT(HashProbe::_hashK(ZZ(1), 0) != HashProbe::_hashK(ZZ(256), 0));
+
+    // consecutive keys land evenly in the cells of each hash
+    const long CELLS = 64, KEYS = CELLS * 200;
+    for (long kk = 0; kk < N_HASH; kk++) {
+        vector<long> load(CELLS, 0);
+        for (long ii = 0; ii < KEYS; ii++)
+            load[HashProbe::_hashK(ZZ(ii), kk) % CELLS]++;
+        for (long cell : load)
+            CPPUNIT_ASSERT(cell > KEYS / CELLS / 2 && cell < 2 * KEYS / CELLS);
+    }
+}
+
+void IBLTTest::testIBLTFixed() {
+    const int SIZE = 50; // should be even
+    const size_t ITEM_SIZE = sizeof(randZZ());
+
+    vector<ZZ> items;
+    for (int ii = 0; ii < SIZE; ii++)
+        items.push_back(randZZ());
+
+    // the same content in both representations, half of it in a second table to subtract
+    IBLT iblt(SIZE * 2, ITEM_SIZE), iblt2(SIZE * 2, ITEM_SIZE);
+    IBLTFixed fixed(SIZE * 2, ITEM_SIZE), fixed2(SIZE * 2, ITEM_SIZE);
+    CPPUNIT_ASSERT_EQUAL(iblt.size(), fixed.size());
+    for (int ii = 0; ii < SIZE; ii++) {
+        iblt.insert(items[ii], items[ii]);
+        fixed.insert(items[ii], items[ii]);
+    }
+    iblt.erase(items[0], items[0]);
+    fixed.erase(items[0], items[0]);
+    for (int ii = SIZE / 2; ii < SIZE; ii++) {
+        iblt2.insert(items[ii], items[ii]);
+        fixed2.insert(items[ii], items[ii]);
+    }
+    CPPUNIT_ASSERT_EQUAL(iblt.toString(), fixed.toIBLT().toString());
+
+    iblt -= iblt2;
+    fixed -= fixed2;
+    CPPUNIT_ASSERT_EQUAL(iblt.toString(), fixed.toIBLT().toString());
+
+    // conversion from an IBLT, only when every sum fits
+    IBLTFixed converted(0, ITEM_SIZE);
+    CPPUNIT_ASSERT(converted.assign(iblt));
+    CPPUNIT_ASSERT_EQUAL(iblt.toString(), converted.toIBLT().toString());
+    IBLTFixed narrow(0, 1);
+    CPPUNIT_ASSERT(!narrow.fits(ZZ(256)) && !narrow.fits(ZZ(-1)) && narrow.fits(ZZ(255)));
+    CPPUNIT_ASSERT(!narrow.assign(iblt));
+    CPPUNIT_ASSERT_EQUAL((size_t) 0, narrow.size());
+
+    vector<pair<ZZ, ZZ>> plus, minus, fixedPlus, fixedMinus;
+    CPPUNIT_ASSERT(iblt.listEntries(plus, minus));
+    CPPUNIT_ASSERT(fixed.listEntries(fixedPlus, fixedMinus));
+    CPPUNIT_ASSERT((size_t) SIZE / 2 - 1 == fixedPlus.size() && fixedMinus.empty());
+    std::sort(plus.begin(), plus.end());
+    std::sort(fixedPlus.begin(), fixedPlus.end());
+    CPPUNIT_ASSERT(plus == fixedPlus);
+}
+
+void IBLTTest::testGetNonDestructive() {
+    const int SIZE = 40;
+    const size_t ITEM_SIZE = sizeof(randZZ());
+
+    // a table barely large enough to list, so that most keys share every one of their cells with other keys
+    vector<pair<ZZ, ZZ>> items;
+    IBLT iblt(SIZE, ITEM_SIZE);
+    for (int ii = 0; ii < SIZE; ii++) {
+        items.push_back({randZZ(), randZZ()});
+        iblt.insert(items.back().first, items.back().second);
+    }
+    const string before = iblt.toString();
+
+    for (const auto& item : items) {
+        ZZ value;
+        if (iblt.get(item.first, value))
+            CPPUNIT_ASSERT_EQUAL(item.second, value);
+        CPPUNIT_ASSERT_EQUAL(before, iblt.toString());
+    }
+}
+
+void IBLTTest::testParallelInsert() {
+    const int EXPECTED = 20, SIZE = 1000;
+    const size_t ITEM_SIZE = sizeof(randZZ());
+    ThreadPool pool(4);
+
+    vector<pair<ZZ, ZZ>> pairs, firstHalf, secondHalf;
+    for (int ii = 0; ii < SIZE; ii++) {
+        pairs.push_back({randZZ(), randZZ()});
+        (ii < SIZE / 2 ? firstHalf : secondHalf).push_back(pairs.back());
+    }
+
+    IBLT serial(EXPECTED, ITEM_SIZE), parallel(EXPECTED, ITEM_SIZE), halves(EXPECTED, ITEM_SIZE), other(EXPECTED, ITEM_SIZE);
+    for (const auto& item : pairs)
+        serial.insert(item.first, item.second);
+    parallel.insert(pairs, &pool);
+    CPPUNIT_ASSERT_EQUAL(serial.toString(), parallel.toString());
+    halves.insert(firstHalf);
+    other.insert(secondHalf);
+    CPPUNIT_ASSERT_EQUAL(serial.toString(), (halves += other).toString());
+
+    IBLTFixed fixedParallel(EXPECTED, ITEM_SIZE), fixedHalves(EXPECTED, ITEM_SIZE), fixedOther(EXPECTED, ITEM_SIZE);
+    fixedParallel.insert(pairs, &pool);
+    CPPUNIT_ASSERT_EQUAL(serial.toString(), fixedParallel.toIBLT().toString());
+    fixedHalves.insert(firstHalf);
+    fixedOther.insert(secondHalf);
+    CPPUNIT_ASSERT_EQUAL(serial.toString(), (fixedHalves += fixedOther).toIBLT().toString());
+
+    IBLTMultiset multiSerial(EXPECTED, ITEM_SIZE), multiParallel(EXPECTED, ITEM_SIZE);
+    IBLTMultiset multiHalves(EXPECTED, ITEM_SIZE), multiOther(EXPECTED, ITEM_SIZE);
+    for (const auto& item : pairs)
+        multiSerial.insert(item.first, item.second);
+    multiParallel.insert(pairs, &pool);
+    CPPUNIT_ASSERT_EQUAL(multiSerial.toString(), multiParallel.toString());
+    multiHalves.insert(firstHalf);
+    multiOther.insert(secondHalf);
+    CPPUNIT_ASSERT_EQUAL(multiSerial.toString(), (multiHalves += multiOther).toString());
+}
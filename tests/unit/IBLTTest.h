@@ -9,6 +9,7 @@
 #include <cppunit/extensions/HelperMacros.h>
 #include <CPISync/Syncs/IBLT.h>
 #include <CPISync/Syncs/IBLTMultiset.h>
+#include <CPISync/Syncs/IBLTFixed.h>
 #include <CPISync/Aux/Auxiliary.h>
 #include <iostream>
 #include <algorithm>
@@ -20,6 +21,10 @@ class IBLTTest : public CPPUNIT_NS::TestFixture{
     CPPUNIT_TEST(IBLTNestedInsertRetrieveTest);
     CPPUNIT_TEST(testIBLTMultisetInsert);
     CPPUNIT_TEST(testIBLTMultisetSubtract);
+    CPPUNIT_TEST(testHashFamily);
+    CPPUNIT_TEST(testIBLTFixed);
+    CPPUNIT_TEST(testGetNonDestructive);
+    CPPUNIT_TEST(testParallelInsert);
 
     CPPUNIT_TEST_SUITE_END();
 public:
@@ -53,6 +58,29 @@ public:
      */
     static void testIBLTMultisetSubtract();
 
+    /**
+     * Tests that the seeded hash family is deterministic, tells apart its members and keys of either sign, and
+     * spreads keys evenly over the cells
+     */
+    static void testHashFamily();
+
+    /**
+     * Tests that an IBLTFixed has the same cells as an IBLT with the same content, through inserting, erasing,
+     * subtracting and listing, and converts to and from one
+     */
+    static void testIBLTFixed();
+
+    /**
+     * Tests that get finds every key of a table that must be peeled to find them, and leaves the table unchanged
+     */
+    static void testGetNonDestructive();
+
+    /**
+     * Tests that inserting in bulk across threads, and adding IBLTs, give the same IBLTs as inserting one pair at a
+     * time, for IBLT, IBLTFixed and IBLTMultiset
+     */
+    static void testParallelInsert();
+
 
 };
 